@@ -29,10 +29,13 @@
 #include <unistd.h>
 
 #include "host_commands.h"
+#include "htool_async_writer.h"
 #include "htool_authz_command.h"
+#include "htool_broker.h"
 #include "htool_cmd.h"
 #include "htool_console.h"
 #include "htool_i2c.h"
+#include "htool_image.h"
 #include "htool_jtag.h"
 #include "htool_key_rotation.h"
 #include "htool_panic.h"
@@ -57,6 +60,7 @@
 #include "protocol/reboot.h"
 #include "protocol/rot_firmware_version.h"
 #include "protocol/spi_proxy.h"
+#include "transports/libhoth_broker.h"
 #include "transports/libhoth_device.h"
 #include "transports/libhoth_spi.h"
 
@@ -245,22 +249,8 @@ static int command_authz_host_command_send(const struct htool_invocation* inv) {
   return 0;
 }
 
-static int force_write(int fd, const void* buf, size_t size) {
-  const uint8_t* cbuf = (const uint8_t*)buf;
-  while (size > 0) {
-    ssize_t bytes_written = write(fd, cbuf, size);
-    if (bytes_written <= 0) {
-      perror("write failed");
-      return -1;
-    }
-    size -= bytes_written;
-    cbuf += bytes_written;
-  }
-  return 0;
-}
-
-static int get_address_mode(const char* address_mode, bool* is_4_byte,
-                            bool* enter_4byte) {
+int htool_get_address_mode(const char* address_mode, bool* is_4_byte,
+                           bool* enter_4byte) {
   if (!strcmp(address_mode, "3B/4B")) {
     *is_4_byte = true;
     *enter_4byte = true;
@@ -281,11 +271,17 @@ static int command_spi_read(const struct htool_invocation* inv) {
   struct {
     uint32_t start;
     uint32_t length;
+    uint32_t window;
+    const char* cache_file;
+    uint32_t flash_size;
     const char* dest_file;
     const char* address_mode;
   } args;
   if (htool_get_param_u32(inv, "start", &args.start) ||
       htool_get_param_u32(inv, "length", &args.length) ||
+      htool_get_param_u32(inv, "window", &args.window) ||
+      htool_get_param_string(inv, "cache_file", &args.cache_file) ||
+      htool_get_param_u32(inv, "flash_size", &args.flash_size) ||
       htool_get_param_string(inv, "dest-file", &args.dest_file) ||
       htool_get_param_string(inv, "address_mode", &args.address_mode)) {
     return -1;
@@ -298,6 +294,9 @@ static int command_spi_read(const struct htool_invocation* inv) {
 
   int result = -1;
 
+  // Closed at cleanup1, even if it was never opened.
+  struct libhoth_spi_proxy spi = {.cache = NULL};
+
   int fd = open(args.dest_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
   if (fd == -1) {
     fprintf(stderr, "Error opening file %s: %s\n", args.dest_file,
@@ -307,15 +306,29 @@ static int command_spi_read(const struct htool_invocation* inv) {
 
   bool is_4_byte = true;
   bool enter_exit_4b = true;
-  int status = get_address_mode(args.address_mode, &is_4_byte, &enter_exit_4b);
+  int status =
+      htool_get_address_mode(args.address_mode, &is_4_byte, &enter_exit_4b);
   if (status) {
     goto cleanup1;
   }
-  struct libhoth_spi_proxy spi;
   status = libhoth_spi_proxy_init(&spi, dev, is_4_byte, enter_exit_4b);
   if (status) {
     goto cleanup1;
   }
+  spi.window = args.window;
+  if (strlen(args.cache_file) > 0 &&
+      libhoth_spi_proxy_open_image_cache(&spi, args.cache_file,
+                                         args.flash_size)) {
+    goto cleanup1;
+  }
+
+  // The file is written on another thread, so reading the flash never waits
+  // for the disk.
+  const size_t BLOCK_SIZE = 256 * 1024;
+  struct htool_async_writer writer;
+  if (htool_async_writer_start(&writer, fd, BLOCK_SIZE)) {
+    goto cleanup1;
+  }
 
   struct libhoth_progress_stderr progress;
   libhoth_progress_stderr_init(&progress, "Reading");
@@ -323,16 +336,16 @@ static int command_spi_read(const struct htool_invocation* inv) {
   uint32_t addr = args.start;
   size_t len_remaining = args.length;
   while (len_remaining > 0) {
-    uint8_t buf[65536];
-    size_t read_size = MIN(len_remaining, sizeof(buf));
-    status = libhoth_spi_proxy_read(&spi, addr, buf, read_size);
-    if (status) {
-      goto cleanup1;
+    uint8_t* buf = htool_async_writer_buffer(&writer);
+    if (buf == NULL) {
+      goto cleanup2;
     }
-    status = force_write(fd, buf, read_size);
+    size_t read_size = MIN(len_remaining, BLOCK_SIZE);
+    status = libhoth_spi_proxy_read(&spi, addr, buf, read_size);
     if (status) {
-      goto cleanup1;
+      goto cleanup2;
     }
+    htool_async_writer_queue(&writer, read_size);
 
     addr += read_size;
     len_remaining -= read_size;
@@ -343,7 +356,15 @@ static int command_spi_read(const struct htool_invocation* inv) {
 
   result = 0;
 
+cleanup2:
+  if (htool_async_writer_finish(&writer) != 0) {
+    result = -1;
+  }
+
 cleanup1:
+  if (libhoth_spi_proxy_close_cache(&spi) != 0) {
+    result = -1;
+  }
   close(fd);
   return result;
 }
@@ -352,11 +373,17 @@ static int command_spi_update(const struct htool_invocation* inv) {
   struct {
     uint32_t start;
     bool verify;
+    uint32_t window;
+    bool differential;
+    bool dry_run;
     const char* source_file;
     const char* address_mode;
   } args;
   if (htool_get_param_u32(inv, "start", &args.start) ||
       htool_get_param_bool(inv, "verify", &args.verify) ||
+      htool_get_param_u32(inv, "window", &args.window) ||
+      htool_get_param_bool(inv, "differential", &args.differential) ||
+      htool_get_param_bool(inv, "dry_run", &args.dry_run) ||
       htool_get_param_string(inv, "source-file", &args.source_file) ||
       htool_get_param_string(inv, "address_mode", &args.address_mode)) {
     return -1;
@@ -369,14 +396,12 @@ static int command_spi_update(const struct htool_invocation* inv) {
 
   int result = -1;
 
-  int fd = open(args.source_file, O_RDONLY, 0);
-  if (fd == -1) {
-    fprintf(stderr, "Error opening file %s: %s\n", args.source_file,
-            strerror(errno));
+  struct htool_image source;
+  if (htool_image_open(args.source_file, &source)) {
     return -1;
   }
   struct stat statbuf;
-  if (fstat(fd, &statbuf)) {
+  if (fstat(source.fd, &statbuf)) {
     fprintf(stderr, "fstat error: %s\n", strerror(errno));
     goto cleanup1;
   }
@@ -385,45 +410,92 @@ static int command_spi_update(const struct htool_invocation* inv) {
     goto cleanup1;
   }
   size_t file_size = statbuf.st_size;
-  uint8_t* file_data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // Plain image files are mapped; everything else is streamed.
+  uint8_t* file_data = NULL;
+  if (source.mappable) {
+    file_data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, source.fd, 0);
+    if (file_data == MAP_FAILED) {
+      fprintf(stderr, "mmap error: %s\n", strerror(errno));
+      file_data = NULL;
+      goto cleanup1;
+    }
+  }
 
   bool is_4_byte = true;
   bool enter_exit_4b = true;
-  int status = get_address_mode(args.address_mode, &is_4_byte, &enter_exit_4b);
+  int status =
+      htool_get_address_mode(args.address_mode, &is_4_byte, &enter_exit_4b);
   if (status) {
-    goto cleanup1;
+    goto cleanup2;
   }
   struct libhoth_spi_proxy spi;
   status = libhoth_spi_proxy_init(&spi, dev, is_4_byte, enter_exit_4b);
   if (status) {
     goto cleanup2;
   }
+  spi.window = args.window;
 
-  struct libhoth_progress_stderr progress;
-  libhoth_progress_stderr_init(&progress, "Erasing/Programming");
-  status = libhoth_spi_proxy_update(&spi, args.start, file_data, file_size,
-                                    &progress.progress);
-  if (status) {
+  if (file_data == NULL && (args.differential || args.dry_run)) {
+    fprintf(stderr,
+            "--differential and --dry_run need an uncompressed image file\n");
     goto cleanup2;
   }
 
-  if (args.verify) {
+  if (file_data == NULL) {
+    // Each block is verified as soon as it has been written.
     struct libhoth_progress_stderr progress;
-    libhoth_progress_stderr_init(&progress, "Verifying");
-    status = libhoth_spi_proxy_verify(&spi, args.start, file_data, file_size,
-                                      &progress.progress);
+    libhoth_progress_stderr_init(&progress, "Erasing/Programming");
+    status = libhoth_spi_proxy_update_stream(
+        &spi, args.start, &source.sparse.reader,
+        libhoth_sparse_reader_image_size(&source.sparse), args.verify,
+        &progress.progress);
     if (status) {
       goto cleanup2;
     }
+  } else {
+    struct libhoth_spi_proxy_plan plan;
+    status = libhoth_spi_proxy_plan_update(&spi, args.start, file_data,
+                                           file_size, args.differential, &plan);
+    if (status) {
+      goto cleanup2;
+    }
+    if (args.dry_run) {
+      libhoth_spi_proxy_plan_print(stdout, &plan);
+      libhoth_spi_proxy_plan_destroy(&plan);
+      result = 0;
+      goto cleanup2;
+    }
+    struct libhoth_progress_stderr progress;
+    libhoth_progress_stderr_init(&progress, "Erasing/Programming");
+    status = libhoth_spi_proxy_apply_plan(&spi, &plan, file_data,
+                                          &progress.progress);
+    libhoth_spi_proxy_plan_destroy(&plan);
+    if (status) {
+      goto cleanup2;
+    }
+
+    if (args.verify) {
+      struct libhoth_progress_stderr progress;
+      libhoth_progress_stderr_init(&progress, "Verifying");
+      status = libhoth_spi_proxy_verify(&spi, args.start, file_data,
+                                        file_size, &progress.progress);
+      if (status) {
+        goto cleanup2;
+      }
+    }
   }
 
   result = 0;
 
 cleanup2:
-  munmap(file_data, file_size);
+  if (file_data != NULL) {
+    munmap(file_data, file_size);
+  }
 
 cleanup1:
-  close(fd);
+  if (htool_image_close(&source) != 0) {
+    result = -1;
+  }
   return result;
 }
 
@@ -601,6 +673,8 @@ struct libhoth_device* htool_libhoth_device(void) {
     result = htool_libhoth_mtd_device();
   } else if (strcmp(transport_method_str, "dbus") == 0) {
     result = htool_libhoth_dbus_device();
+  } else if (strcmp(transport_method_str, "broker") == 0) {
+    result = htool_libhoth_broker_device();
   } else {
     fprintf(stderr, "Unknown transport protocol %s\n\r\n",
             transport_method_str);
@@ -814,11 +888,21 @@ static const struct htool_cmd CMDS[] = {
                 {HTOOL_FLAG_VALUE, 's', "start", "0", .desc = "start address"},
                 {HTOOL_FLAG_VALUE, 'n', "length",
                  .desc = "the number of bytes to read"},
+                {HTOOL_FLAG_VALUE, 'w', "window", "1",
+                 .desc = "Number of reads to keep in flight (limited by "
+                         "--usb_fifo_pipeline_depth)."},
                 {HTOOL_FLAG_VALUE, 'a', "address_mode", "3B/4B",
                  .desc =
                      "3B: 3 byte mode no enter/exit 4B supported\n"
                      "\t3B/4B: 3 Byte current but enter 4B for SPI operation\n"
                      "\t4B: 4 byte mode only, no enter/exit 4B supported"},
+                {HTOOL_FLAG_VALUE, 'c', "cache_file", "",
+                 .desc = "Keep what is read of the image in the flash in "
+                         "this file, keyed by the image hash, and reuse it "
+                         "on later runs."},
+                {HTOOL_FLAG_VALUE, 'f', "flash_size", "0x4000000",
+                 .desc = "How much of the flash to search for the image "
+                         "descriptor, with --cache_file."},
                 {HTOOL_POSITIONAL, .name = "dest-file"},
                 {}},
         .func = command_spi_read,
@@ -830,6 +914,16 @@ static const struct htool_cmd CMDS[] = {
             (const struct htool_param[]){
                 {HTOOL_FLAG_VALUE, 's', "start", "0", .desc = "start address"},
                 {HTOOL_FLAG_BOOL, 'v', "verify", "true"},
+                {HTOOL_FLAG_VALUE, 'w', "window", "1",
+                 .desc = "Number of reads to keep in flight when reading "
+                         "back the flash (limited by "
+                         "--usb_fifo_pipeline_depth)."},
+                {HTOOL_FLAG_BOOL, 'd', "differential", "false",
+                 .desc = "Read the flash first, and only erase and program "
+                         "what differs from the file."},
+                {HTOOL_FLAG_BOOL, 'n', "dry_run", "false",
+                 .desc = "Print the erases and programs that would be done "
+                         "instead of doing them."},
                 {HTOOL_FLAG_VALUE, 'a', "address_mode", "3B/4B",
                  .desc =
                      "3B: 3 byte mode no enter/exit 4B supported\n"
@@ -839,6 +933,23 @@ static const struct htool_cmd CMDS[] = {
                 {}},
         .func = command_spi_update,
     },
+    {
+        .verbs = (const char*[]){"spi", "payload", "info", NULL},
+        .desc = "Display payload info for the Titan image in SPI flash, "
+                "reading only its image descriptor.",
+        .params =
+            (const struct htool_param[]){
+                {HTOOL_FLAG_VALUE, 'f', "flash_size", "0x4000000",
+                 .desc = "How much of the flash to search for the image "
+                         "descriptor."},
+                {HTOOL_FLAG_VALUE, 'a', "address_mode", "3B/4B",
+                 .desc =
+                     "3B: 3 byte mode no enter/exit 4B supported\n"
+                     "\t3B/4B: 3 Byte current but enter 4B for SPI operation\n"
+                     "\t4B: 4 byte mode only, no enter/exit 4B supported"},
+                {}},
+        .func = htool_spi_payload_info,
+    },
     {
         .verbs = (const char*[]){"spi", "passthrough", "off", NULL},
         .desc = "Disable SPS->SPI passthrough",
@@ -918,9 +1029,34 @@ static const struct htool_cmd CMDS[] = {
         .desc = "Perform payload update protocol for Titan images.",
         .params =
             (const struct htool_param[]){
-                {HTOOL_POSITIONAL, .name = "source-file"}, {}},
+                {HTOOL_FLAG_VALUE, 'w', "window", "1",
+                 .desc = "Number of packets to keep in flight (limited by "
+                         "--usb_fifo_pipeline_depth)."},
+                {HTOOL_FLAG_BOOL, 'd', "differential", "false",
+                 .desc = "Only erase and rewrite the blocks of the staging "
+                         "half that differ from the image."},
+                {HTOOL_FLAG_VALUE, 'j', "journal", "",
+                 .desc = "Record progress in this file, and resume an "
+                         "interrupted update of the same image from it. "
+                         "Needs a plain image file (not stdin, compressed or "
+                         "sparse), and can't be used with --differential."},
+                {HTOOL_POSITIONAL, .name = "source-file",
+                 .desc = "Image file, or - to stream it from stdin."},
+                {}},
         .func = htool_payload_update,
     },
+    {
+        .verbs = (const char*[]){"payload", "sparse", NULL},
+        .desc = "Convert an image to the sparse format, which leaves out "
+                "erased (0xFF) ranges. payload update and spi update accept "
+                "sparse images, as well as zstd, xz and lz4 compressed ones.",
+        .params =
+            (const struct htool_param[]){
+                {HTOOL_POSITIONAL, .name = "source-file"},
+                {HTOOL_POSITIONAL, .name = "dest-file"},
+                {}},
+        .func = htool_image_sparse,
+    },
     {
         .verbs = (const char*[]){"payload", "info", NULL},
         .desc = "Display payload info for a Titan image.",
@@ -929,6 +1065,15 @@ static const struct htool_cmd CMDS[] = {
                 {HTOOL_POSITIONAL, .name = "source-file"}, {}},
         .func = htool_payload_info,
     },
+    {
+        .verbs = (const char*[]){"payload", "verify_hash", NULL},
+        .desc = "Check the hash of a Titan image against its image "
+                "descriptor.",
+        .params =
+            (const struct htool_param[]){
+                {HTOOL_POSITIONAL, .name = "source-file"}, {}},
+        .func = htool_payload_verify_hash,
+    },
     {.verbs = (const char*[]){"flash_spi_info", NULL},
      .desc = "Get SPI NOR flash info.",
      .params = (const struct htool_param[]){{}},
@@ -1068,6 +1213,35 @@ static const struct htool_cmd CMDS[] = {
         .params = (const struct htool_param[]){{}},
         .func = htool_sbs_dual_run,
     },
+    {
+        .verbs = (const char*[]){"sbs_dual", SBS_DUAL_UPDATE_CMD_STR, NULL},
+        .desc = "Write images to both spi flashes of the SBS dual mux in one "
+                "run (erase + program). The RoT reaches the flash the target "
+                "isn't connected to; the mux is switched as needed and put "
+                "back afterwards.",
+        .params =
+            (const struct htool_param[]){
+                {HTOOL_FLAG_VALUE, .name = "flash_0", .default_value = "",
+                 .desc = "Image file for spi flash 0, if any."},
+                {HTOOL_FLAG_VALUE, .name = "flash_1", .default_value = "",
+                 .desc = "Image file for spi flash 1, if any."},
+                {HTOOL_FLAG_VALUE, 's', "start", "0", .desc = "start address"},
+                {HTOOL_FLAG_BOOL, 'v', "verify", "true"},
+                {HTOOL_FLAG_VALUE, 'w', "window", "1",
+                 .desc = "Number of reads to keep in flight when reading "
+                         "back the flash (limited by "
+                         "--usb_fifo_pipeline_depth)."},
+                {HTOOL_FLAG_BOOL, 'd', "differential", "false",
+                 .desc = "Read each flash first, and only erase and program "
+                         "what differs from its image."},
+                {HTOOL_FLAG_VALUE, 'a', "address_mode", "3B/4B",
+                 .desc =
+                     "3B: 3 byte mode no enter/exit 4B supported\n"
+                     "\t3B/4B: 3 Byte current but enter 4B for SPI operation\n"
+                     "\t4B: 4 byte mode only, no enter/exit 4B supported"},
+                {}},
+        .func = htool_sbs_dual_run,
+    },
     {
         .verbs = (const char*[]){"i2c", I2C_DETECT_CMD_STR, NULL},
         .desc = "Detect I2C devices on bus",
@@ -1214,6 +1388,13 @@ static const struct htool_cmd CMDS[] = {
         .params = (const struct htool_param[]){{}},
         .func = command_raw_host_command,
     },
+    {
+        .verbs = (const char*[]){"broker", "serve", NULL},
+        .desc = "Keep the RoT open and serve host commands to "
+                "'--transport=broker' clients on --broker_socket.",
+        .params = (const struct htool_param[]){{}},
+        .func = command_broker_serve,
+    },
     {
         .verbs = (const char*[]){"jtag", JTAG_READ_IDCODE_CMD_STR, NULL},
         .desc = "Read IDCODE for a device over JTAG. Assumes only a single "
@@ -1548,7 +1729,7 @@ static const struct htool_cmd CMDS[] = {
 static const struct htool_param GLOBAL_FLAGS[] = {
     {HTOOL_FLAG_VALUE, .name = "transport", .default_value = "",
      .desc = "The method of connecting to the RoT; for example "
-             "'spidev'/'usb'/'mtd'/'dbus'"},
+             "'spidev'/'usb'/'mtd'/'dbus'/'broker'"},
     {HTOOL_FLAG_VALUE, .name = "usb_loc", .default_value = "",
      .desc = "The full bus-portlist location of the RoT; for example "
              "'1-10.4.4.1'."},
@@ -1565,6 +1746,27 @@ static const struct htool_param GLOBAL_FLAGS[] = {
     {HTOOL_FLAG_VALUE, .name = "spidev_speed_hz", .default_value = "0",
      .desc = "Clock speed (in Hz) to use when using spidev transport. Default "
              "behavior (with input 0) is to not change the clock speed"},
+    {HTOOL_FLAG_VALUE, .name = "spidev_read_mode", .default_value = "slow",
+     .desc = "Opcode used to read responses over spidev: 'slow' (0x03), "
+             "'fast' (0x0B), 'dual' (0x3B) or 'quad' (0x6B). 'dual' and "
+             "'quad' fall back to 'fast' if the controller can't do them."},
+    {HTOOL_FLAG_VALUE, .name = "spidev_speculative_read_size",
+     .default_value = "0",
+     .desc = "Number of payload bytes to read along with the response header "
+             "when using spidev transport, saving a second transaction for "
+             "responses that fit."},
+    {HTOOL_FLAG_VALUE, .name = "spidev_ready_gpio", .default_value = "",
+     .desc = "GPIO the RoT asserts when it is ready for the next SPI "
+             "operation, as '<chip path>:<line>'; for example "
+             "'/dev/gpiochip0:12'. Writes wait on this line instead of "
+             "sleeping between status reads."},
+    {HTOOL_FLAG_BOOL, .name = "spidev_ready_gpio_active_low",
+     .default_value = "false",
+     .desc = "If true, the spidev_ready_gpio line is active-low."},
+    {HTOOL_FLAG_BOOL, .name = "spidev_adaptive_busy_wait",
+     .default_value = "false",
+     .desc = "If true, learn how long the RoT takes to program a page and "
+             "sleep for about that long before checking its status."},
     {HTOOL_FLAG_VALUE, .name = "spidev_device_busy_wait_timeout",
      .default_value = "180000000",
      .desc = "Maximum duration (in microseconds) to wait when SPI device "
@@ -1579,9 +1781,22 @@ static const struct htool_param GLOBAL_FLAGS[] = {
              "the correct device automatically"},
     {HTOOL_FLAG_VALUE, .name = "mtddev_name", .default_value = "hoth-mailbox",
      .desc = "The MTD name of the RoT mailbox; for example 'hoth-mailbox'. "},
+    {HTOOL_FLAG_BOOL, .name = "mtddev_mmap", .default_value = "false",
+     .desc = "If true, map the MTD mailbox into memory and access it "
+             "directly instead of with read/write syscalls."},
+    {HTOOL_FLAG_VALUE, .name = "mtddev_mmap_path", .default_value = "",
+     .desc = "With mtddev_mmap, map the mailbox from this file (for example "
+             "'/dev/uio0' or '/dev/mem') instead of the MTD device."},
+    {HTOOL_FLAG_VALUE, .name = "mtddev_mmap_offset", .default_value = "0",
+     .desc = "Offset of the mailbox within mtddev_mmap_path."},
     {HTOOL_FLAG_VALUE, .name = "mailbox_location", .default_value = "0",
      .desc = "The location of the mailbox on the RoT, for 'spidev' "
              "or 'mtd' transports; for example '0x900000'."},
+    {HTOOL_FLAG_VALUE, .name = "broker_socket",
+     .default_value = LIBHOTH_BROKER_DEFAULT_SOCKET,
+     .desc = "The socket of the 'htool broker serve' process to send host "
+             "commands through, for the 'broker' transport, or to listen on, "
+             "for 'htool broker serve'."},
     {HTOOL_FLAG_VALUE, .name = "dbus_hoth_id", .default_value = "",
      .desc = "The hoth ID associated with the RoT's hothd service."},
     {HTOOL_FLAG_VALUE, .name = "usb_retry_duration", .default_value = "1000ms",
@@ -1589,6 +1804,9 @@ static const struct htool_param GLOBAL_FLAGS[] = {
              "'1s', '1500ms')."},
     {HTOOL_FLAG_VALUE, .name = "usb_retry_delay", .default_value = "50ms",
      .desc = "Delay between USB open retries (e.g., '50ms', '10000us')."},
+    {HTOOL_FLAG_VALUE, .name = "usb_fifo_pipeline_depth", .default_value = "1",
+     .desc = "Number of host commands that may be queued to a USB FIFO RoT "
+             "before the first response is read (1-8)."},
     {HTOOL_FLAG_BOOL, .name = "version", .default_value = "false",
      .desc = "Print htool version."},
     {}};
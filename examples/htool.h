@@ -15,6 +15,7 @@
 #ifndef LIBHOTH_EXAMPLES_HTOOL_H_
 #define LIBHOTH_EXAMPLES_HTOOL_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -26,12 +27,17 @@ extern "C" {
 
 struct libhoth_device;
 
+struct libhoth_device* htool_libhoth_broker_device(void);
 struct libhoth_device* htool_libhoth_dbus_device(void);
 struct libhoth_device* htool_libhoth_mtd_device(void);
 struct libhoth_device* htool_libhoth_spi_device(void);
 struct libhoth_device* htool_libhoth_usb_device(void);
 struct libhoth_device* htool_libhoth_device(void);
 
+// Parses an `address_mode` flag value ("3B", "3B/4B" or "4B").
+int htool_get_address_mode(const char* address_mode, bool* is_4_byte,
+                           bool* enter_4byte);
+
 #ifdef __cplusplus
 }
 #endif
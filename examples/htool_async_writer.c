@@ -0,0 +1,142 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "htool_async_writer.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int write_all(int fd, const uint8_t* buf, size_t size) {
+  while (size > 0) {
+    ssize_t bytes_written = write(fd, buf, size);
+    if (bytes_written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_written <= 0) {
+      perror("write failed");
+      return -1;
+    }
+    size -= bytes_written;
+    buf += bytes_written;
+  }
+  return 0;
+}
+
+static void* writer_thread(void* arg) {
+  struct htool_async_writer* writer = (struct htool_async_writer*)arg;
+  pthread_mutex_lock(&writer->lock);
+  while (true) {
+    while (writer->num_queued == 0 && !writer->finishing) {
+      pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    if (writer->num_queued == 0) {
+      break;
+    }
+    const size_t index = writer->head;
+    const bool skip = writer->failed;
+    pthread_mutex_unlock(&writer->lock);
+
+    // After a failure, buffers are only dropped so that nobody waits on them.
+    const int status =
+        skip ? 0
+             : write_all(writer->fd, writer->buffers[index], writer->lens[index]);
+
+    pthread_mutex_lock(&writer->lock);
+    if (status != 0) {
+      writer->failed = true;
+    }
+    writer->head = (writer->head + 1) % HTOOL_ASYNC_WRITER_NUM_BUFFERS;
+    writer->num_queued--;
+    pthread_cond_broadcast(&writer->changed);
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return NULL;
+}
+
+int htool_async_writer_start(struct htool_async_writer* writer, int fd,
+                             size_t buffer_size) {
+  *writer = (struct htool_async_writer){
+      .fd = fd,
+      .buffer_size = buffer_size,
+  };
+  for (size_t i = 0; i < HTOOL_ASYNC_WRITER_NUM_BUFFERS; i++) {
+    writer->buffers[i] = malloc(buffer_size);
+    if (writer->buffers[i] == NULL) {
+      fprintf(stderr, "Out of memory for write buffers\n");
+      goto err_out;
+    }
+  }
+  pthread_mutex_init(&writer->lock, NULL);
+  pthread_cond_init(&writer->changed, NULL);
+  int rv = pthread_create(&writer->thread, NULL, writer_thread, writer);
+  if (rv != 0) {
+    fprintf(stderr, "pthread_create() failed: %s\n", strerror(rv));
+    pthread_cond_destroy(&writer->changed);
+    pthread_mutex_destroy(&writer->lock);
+    goto err_out;
+  }
+  return 0;
+
+err_out:
+  for (size_t i = 0; i < HTOOL_ASYNC_WRITER_NUM_BUFFERS; i++) {
+    free(writer->buffers[i]);
+  }
+  return -1;
+}
+
+uint8_t* htool_async_writer_buffer(struct htool_async_writer* writer) {
+  pthread_mutex_lock(&writer->lock);
+  while (writer->num_queued == HTOOL_ASYNC_WRITER_NUM_BUFFERS &&
+         !writer->failed) {
+    pthread_cond_wait(&writer->changed, &writer->lock);
+  }
+  uint8_t* buffer = NULL;
+  if (!writer->failed) {
+    buffer = writer->buffers[(writer->head + writer->num_queued) %
+                             HTOOL_ASYNC_WRITER_NUM_BUFFERS];
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return buffer;
+}
+
+void htool_async_writer_queue(struct htool_async_writer* writer, size_t len) {
+  pthread_mutex_lock(&writer->lock);
+  const size_t index = (writer->head + writer->num_queued) %
+                       HTOOL_ASYNC_WRITER_NUM_BUFFERS;
+  writer->lens[index] = len;
+  writer->num_queued++;
+  pthread_cond_broadcast(&writer->changed);
+  pthread_mutex_unlock(&writer->lock);
+}
+
+int htool_async_writer_finish(struct htool_async_writer* writer) {
+  pthread_mutex_lock(&writer->lock);
+  writer->finishing = true;
+  pthread_cond_broadcast(&writer->changed);
+  pthread_mutex_unlock(&writer->lock);
+  pthread_join(writer->thread, NULL);
+
+  pthread_cond_destroy(&writer->changed);
+  pthread_mutex_destroy(&writer->lock);
+  for (size_t i = 0; i < HTOOL_ASYNC_WRITER_NUM_BUFFERS; i++) {
+    free(writer->buffers[i]);
+  }
+  return writer->failed ? -1 : 0;
+}
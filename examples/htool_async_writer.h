@@ -0,0 +1,70 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBHOTH_EXAMPLES_HTOOL_ASYNC_WRITER_H_
+#define LIBHOTH_EXAMPLES_HTOOL_ASYNC_WRITER_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HTOOL_ASYNC_WRITER_NUM_BUFFERS 4
+
+// Writes buffers to a file on a thread of its own, so that whoever fills
+// them (e.g. with host commands) never waits on the disk while there is a
+// free buffer.
+struct htool_async_writer {
+  int fd;
+  size_t buffer_size;
+  uint8_t* buffers[HTOOL_ASYNC_WRITER_NUM_BUFFERS];
+  size_t lens[HTOOL_ASYNC_WRITER_NUM_BUFFERS];
+  // The next buffer to write, and how many are queued from there.
+  size_t head;
+  size_t num_queued;
+  bool finishing;
+  // Set once a write fails.
+  bool failed;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+};
+
+// Starts writing to `fd` (which stays owned by the caller) from buffers of
+// `buffer_size` bytes.
+int htool_async_writer_start(struct htool_async_writer* writer, int fd,
+                             size_t buffer_size);
+
+// Returns the next buffer to fill, waiting for one to be written if they are
+// all queued, or NULL once a write has failed.
+uint8_t* htool_async_writer_buffer(struct htool_async_writer* writer);
+
+// Queues the first `len` bytes of the buffer last returned by
+// htool_async_writer_buffer() to be written.
+void htool_async_writer_queue(struct htool_async_writer* writer, size_t len);
+
+// Waits for the queued buffers to be written and stops the writer. Returns -1
+// if any write failed.
+int htool_async_writer_finish(struct htool_async_writer* writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBHOTH_EXAMPLES_HTOOL_ASYNC_WRITER_H_
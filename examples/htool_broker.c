@@ -0,0 +1,266 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "htool_broker.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "htool.h"
+#include "htool_cmd.h"
+#include "protocol/host_cmd.h"
+#include "transports/libhoth_broker.h"
+#include "transports/libhoth_device.h"
+
+enum {
+  BROKER_MAX_CLIENTS = 64,
+  BROKER_LISTEN_BACKLOG = 16,
+};
+
+static const char* broker_socket_path(void) {
+  const char* socket_path;
+  if (htool_get_param_string(htool_global_flags(), "broker_socket",
+                             &socket_path) != 0 ||
+      strlen(socket_path) == 0) {
+    return LIBHOTH_BROKER_DEFAULT_SOCKET;
+  }
+  return socket_path;
+}
+
+struct libhoth_device* htool_libhoth_broker_device(void) {
+  static struct libhoth_device* result;
+  if (result) {
+    return result;
+  }
+
+  struct libhoth_broker_device_init_options opts = {
+      .socket_path = broker_socket_path(),
+  };
+  int rv = libhoth_broker_open(&opts, &result);
+  if (rv) {
+    fprintf(stderr, "libhoth_broker_open error: %d\n", rv);
+    return NULL;
+  }
+  return result;
+}
+
+// A client's request, as far as it has been received. Clients are read
+// without blocking, so one that stops halfway through a request doesn't hold
+// up the others.
+struct broker_client {
+  uint8_t request[LIBHOTH_MAILBOX_SIZE];
+  size_t request_len;
+};
+
+static int client_write_exact(int fd, const void* buf, size_t count) {
+  const uint8_t* buf_u8 = (const uint8_t*)buf;
+  while (count > 0) {
+    ssize_t bytes_written = send(fd, buf_u8, count, MSG_NOSIGNAL);
+    if (bytes_written < 0 && errno == EINTR) {
+      continue;
+    }
+    // A client that doesn't read its responses eventually fills the socket
+    // buffer; it gets dropped rather than stalling everyone else.
+    if (bytes_written <= 0) {
+      return -1;
+    }
+    count -= bytes_written;
+    buf_u8 += bytes_written;
+  }
+  return 0;
+}
+
+// Forwards a complete request to the RoT and writes back its response.
+// Returns non-zero if the client should be disconnected.
+static int broker_forward(struct libhoth_device* dev, int client_fd,
+                          const uint8_t* request, size_t request_len) {
+  int rv = libhoth_send_request(dev, request, request_len);
+  if (rv != LIBHOTH_OK) {
+    fprintf(stderr, "broker: libhoth_send_request error: %d\n", rv);
+    return -1;
+  }
+  uint8_t response[LIBHOTH_MAILBOX_SIZE];
+  size_t response_size = 0;
+  rv = libhoth_receive_response(dev, response, sizeof(response),
+                                &response_size, HOTH_CMD_TIMEOUT_MS_DEFAULT);
+  if (rv != LIBHOTH_OK) {
+    fprintf(stderr, "broker: libhoth_receive_response error: %d\n", rv);
+    return -1;
+  }
+  return client_write_exact(client_fd, response, response_size);
+}
+
+// Reads what `client_fd` has sent so far, and serves the request once all of
+// it is in. Returns non-zero if the client should be disconnected.
+static int broker_client_read(struct libhoth_device* dev, int client_fd,
+                              struct broker_client* client) {
+  while (true) {
+    // Until the header is in, only ask for the header.
+    size_t expected_len = sizeof(struct hoth_host_request);
+    if (client->request_len >= sizeof(struct hoth_host_request)) {
+      struct hoth_host_request header;
+      memcpy(&header, client->request, sizeof(header));
+      if (header.data_len > sizeof(client->request) - sizeof(header)) {
+        fprintf(stderr, "broker: request payload size too large: %d\n",
+                header.data_len);
+        return -1;
+      }
+      expected_len += header.data_len;
+    }
+    if (client->request_len == expected_len) {
+      client->request_len = 0;
+      return broker_forward(dev, client_fd, client->request, expected_len);
+    }
+
+    ssize_t bytes_read = read(client_fd, client->request + client->request_len,
+                              expected_len - client->request_len);
+    if (bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // The rest of the request hasn't arrived yet.
+      return 0;
+    }
+    if (bytes_read <= 0) {
+      return -1;
+    }
+    client->request_len += bytes_read;
+  }
+}
+
+// Returns true if a broker is accepting connections on `addr`.
+static bool broker_is_running(const struct sockaddr_un* addr) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  bool running =
+      connect(fd, (const struct sockaddr*)addr, sizeof(*addr)) == 0;
+  close(fd);
+  return running;
+}
+
+static int broker_listen(const char* socket_path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Broker socket path too long: %s\n", socket_path);
+    return -1;
+  }
+  strcpy(addr.sun_path, socket_path);
+
+  if (broker_is_running(&addr)) {
+    fprintf(stderr, "A broker is already running on %s\n", socket_path);
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    perror("socket() failed");
+    return -1;
+  }
+  // Remove the socket left behind by a previous broker.
+  unlink(socket_path);
+  if (bind(fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(fd, BROKER_LISTEN_BACKLOG) != 0) {
+    fprintf(stderr, "Failed to listen on %s: %s\n", socket_path,
+            strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int command_broker_serve(const struct htool_invocation* inv) {
+  const char* transport;
+  if (htool_get_param_string(htool_global_flags(), "transport", &transport) !=
+      0) {
+    return -1;
+  }
+  if (strcmp(transport, "broker") == 0) {
+    fprintf(stderr, "The broker can't use --transport=broker itself\n");
+    return -1;
+  }
+
+  struct libhoth_device* dev = htool_libhoth_device();
+  if (!dev) {
+    return -1;
+  }
+
+  const char* socket_path = broker_socket_path();
+  int listen_fd = broker_listen(socket_path);
+  if (listen_fd < 0) {
+    return -1;
+  }
+
+  // fds[0] is the listening socket; the rest are clients, whose partial
+  // requests are in clients[i - 1]. Requests are served one at a time, since
+  // the RoT only has one mailbox.
+  struct pollfd fds[1 + BROKER_MAX_CLIENTS];
+  static struct broker_client clients[BROKER_MAX_CLIENTS];
+  nfds_t num_fds = 1;
+  fds[0] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+  while (true) {
+    if (poll(fds, num_fds, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll() failed");
+      break;
+    }
+
+    for (nfds_t i = 1; i < num_fds;) {
+      if (fds[i].revents == 0) {
+        i++;
+        continue;
+      }
+      if ((fds[i].revents & POLLIN) &&
+          broker_client_read(dev, fds[i].fd, &clients[i - 1]) == 0) {
+        i++;
+        continue;
+      }
+      // Error, hangup or EOF: drop the client.
+      close(fds[i].fd);
+      num_fds--;
+      fds[i] = fds[num_fds];
+      clients[i - 1] = clients[num_fds - 1];
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int client_fd =
+          accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+      if (client_fd >= 0) {
+        if (num_fds < 1 + BROKER_MAX_CLIENTS) {
+          clients[num_fds - 1].request_len = 0;
+          fds[num_fds++] = (struct pollfd){.fd = client_fd, .events = POLLIN};
+        } else {
+          fprintf(stderr, "broker: too many clients\n");
+          close(client_fd);
+        }
+      }
+    }
+  }
+
+  for (nfds_t i = 1; i < num_fds; i++) {
+    close(fds[i].fd);
+  }
+  close(listen_fd);
+  unlink(socket_path);
+  return -1;
+}
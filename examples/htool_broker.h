@@ -0,0 +1,32 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBHOTH_EXAMPLES_HTOOL_BROKER_H_
+#define LIBHOTH_EXAMPLES_HTOOL_BROKER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct htool_invocation;
+
+// Opens the RoT with the usual transport flags and serves host commands for
+// `--transport=broker` clients on the `broker_socket` socket until killed.
+int command_broker_serve(const struct htool_invocation* inv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBHOTH_EXAMPLES_HTOOL_BROKER_H_
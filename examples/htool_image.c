@@ -0,0 +1,292 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "htool_image.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "htool.h"
+#include "htool_cmd.h"
+#include "protocol/payload_reader.h"
+#include "protocol/sparse_image.h"
+
+struct decompressor {
+  const char* tool;
+  uint8_t magic[6];
+  size_t magic_len;
+};
+
+static const struct decompressor decompressors[] = {
+    {"zstd", {0x28, 0xB5, 0x2F, 0xFD}, 4},
+    {"xz", {0xFD, '7', 'z', 'X', 'Z', 0x00}, 6},
+    {"lz4", {0x04, 0x22, 0x4D, 0x18}, 4},
+};
+
+static const struct decompressor* find_decompressor(int fd) {
+  uint8_t magic[6];
+  ssize_t n = pread(fd, magic, sizeof(magic), 0);
+  for (size_t i = 0; i < sizeof(decompressors) / sizeof(decompressors[0]);
+       i++) {
+    const struct decompressor* d = &decompressors[i];
+    if (n >= (ssize_t)d->magic_len &&
+        memcmp(magic, d->magic, d->magic_len) == 0) {
+      return d;
+    }
+  }
+  return NULL;
+}
+
+// Runs `tool -dc` with `fd` as its stdin. Returns its stdout, or -1.
+static int start_decompressor(const char* tool, int fd, pid_t* pid) {
+  int pipe_fds[2];
+  if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+    perror("pipe2() failed");
+    return -1;
+  }
+  *pid = fork();
+  if (*pid < 0) {
+    perror("fork() failed");
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return -1;
+  }
+  if (*pid == 0) {
+    if (dup2(fd, STDIN_FILENO) < 0 || dup2(pipe_fds[1], STDOUT_FILENO) < 0) {
+      _exit(127);
+    }
+    execlp(tool, tool, "-dc", (char*)NULL);
+    fprintf(stderr, "Failed to run %s: %s\n", tool, strerror(errno));
+    _exit(127);
+  }
+  close(pipe_fds[1]);
+  return pipe_fds[0];
+}
+
+// Waits for the decompressor to exit. Returns -1 if it failed.
+static int reap_decompressor(struct htool_image* image) {
+  if (image->decompressor < 0) {
+    return image->decompressor_failed ? -1 : 0;
+  }
+  int wstatus;
+  pid_t pid = waitpid(image->decompressor, &wstatus, 0);
+  image->decompressor = -1;
+  if (pid < 0) {
+    perror("waitpid() failed");
+    image->decompressor_failed = true;
+  } else if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+    fprintf(stderr, "Decompressor failed\n");
+    image->decompressor_failed = true;
+  }
+  return image->decompressor_failed ? -1 : 0;
+}
+
+// Reads `image->fd`. End of file from a decompressor only counts once it has
+// exited successfully, so a corrupt or truncated file fails the read before
+// anything is finalized.
+static ssize_t image_read_fd(void* ctx, void* buf, size_t len) {
+  struct htool_image* image = (struct htool_image*)ctx;
+  if (image->decompressor_failed) {
+    return -1;
+  }
+  ssize_t n = libhoth_payload_read_fd(&image->fd, buf, len);
+  if (n == 0 && reap_decompressor(image) != 0) {
+    return -1;
+  }
+  return n;
+}
+
+int htool_image_open(const char* path, struct htool_image* image) {
+  image->decompressor = -1;
+  image->decompressor_failed = false;
+  image->mappable = false;
+  int fd = strcmp(path, "-") == 0 ? dup(STDIN_FILENO)
+                                  : open(path, O_RDONLY | O_CLOEXEC, 0);
+  if (fd == -1) {
+    fprintf(stderr, "Error opening file %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  struct stat statbuf;
+  if (fstat(fd, &statbuf)) {
+    fprintf(stderr, "fstat error: %s\n", strerror(errno));
+    close(fd);
+    return -1;
+  }
+  bool compressed = false;
+  if (S_ISREG(statbuf.st_mode)) {
+    const struct decompressor* d = find_decompressor(fd);
+    if (d != NULL) {
+      compressed = true;
+      int out_fd = start_decompressor(d->tool, fd, &image->decompressor);
+      close(fd);
+      if (out_fd < 0) {
+        return -1;
+      }
+      fd = out_fd;
+    }
+  }
+  image->fd = fd;
+  image->fd_reader = (struct libhoth_payload_reader){
+      .read = image_read_fd,
+      .ctx = image,
+  };
+
+  if (libhoth_sparse_reader_init(&image->sparse, &image->fd_reader) != 0) {
+    htool_image_close(image);
+    return -1;
+  }
+  image->mappable = S_ISREG(statbuf.st_mode) && !compressed &&
+                    libhoth_sparse_reader_image_size(&image->sparse) == 0;
+  return 0;
+}
+
+int htool_image_close(struct htool_image* image) {
+  close(image->fd);
+  return reap_decompressor(image);
+}
+
+static int image_read_all(struct htool_image* image,
+                          struct htool_image_data* data) {
+  const size_t CHUNK_SIZE = 1024 * 1024;
+  size_t capacity = libhoth_sparse_reader_image_size(&image->sparse);
+  while (true) {
+    if (data->size == capacity) {
+      capacity = capacity == 0 ? CHUNK_SIZE : capacity + CHUNK_SIZE;
+      uint8_t* buf = realloc(data->data, capacity);
+      if (buf == NULL) {
+        fprintf(stderr, "Out of memory loading image\n");
+        return -1;
+      }
+      data->data = buf;
+    }
+    ssize_t len = libhoth_payload_read_full(&image->sparse.reader,
+                                            data->data + data->size,
+                                            capacity - data->size);
+    if (len < 0) {
+      return -1;
+    }
+    data->size += len;
+    if (data->size < capacity) {
+      return 0;
+    }
+  }
+}
+
+int htool_image_load(const char* path, struct htool_image_data* data) {
+  *data = (struct htool_image_data){};
+  struct htool_image image;
+  if (htool_image_open(path, &image)) {
+    return -1;
+  }
+  int status = 0;
+  if (image.mappable) {
+    struct stat statbuf;
+    if (fstat(image.fd, &statbuf)) {
+      fprintf(stderr, "fstat error: %s\n", strerror(errno));
+      status = -1;
+    } else if (statbuf.st_size > 0) {
+      data->data =
+          mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, image.fd, 0);
+      if (data->data == MAP_FAILED) {
+        fprintf(stderr, "mmap error: %s\n", strerror(errno));
+        data->data = NULL;
+        status = -1;
+      } else {
+        data->size = statbuf.st_size;
+        data->mapped = true;
+      }
+    }
+  } else {
+    status = image_read_all(&image, data);
+  }
+  if (htool_image_close(&image) != 0) {
+    status = -1;
+  }
+  if (status != 0) {
+    htool_image_data_free(data);
+  }
+  return status;
+}
+
+void htool_image_data_free(struct htool_image_data* data) {
+  if (data->mapped) {
+    munmap(data->data, data->size);
+  } else {
+    free(data->data);
+  }
+  *data = (struct htool_image_data){};
+}
+
+int htool_image_sparse(const struct htool_invocation* inv) {
+  const char* source_file;
+  const char* dest_file;
+  if (htool_get_param_string(inv, "source-file", &source_file) ||
+      htool_get_param_string(inv, "dest-file", &dest_file)) {
+    return -1;
+  }
+
+  int fd = open(source_file, O_RDONLY, 0);
+  if (fd == -1) {
+    fprintf(stderr, "Error opening file %s: %s\n", source_file,
+            strerror(errno));
+    return -1;
+  }
+  int retval = -1;
+  struct stat statbuf;
+  if (fstat(fd, &statbuf)) {
+    fprintf(stderr, "fstat error: %s\n", strerror(errno));
+    goto cleanup1;
+  }
+  uint8_t* image = NULL;
+  if (statbuf.st_size > 0) {
+    image = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (image == MAP_FAILED) {
+      fprintf(stderr, "mmap error: %s\n", strerror(errno));
+      goto cleanup1;
+    }
+  }
+
+  int out_fd = open(dest_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out_fd == -1) {
+    fprintf(stderr, "Error opening file %s: %s\n", dest_file,
+            strerror(errno));
+    goto cleanup2;
+  }
+  if (libhoth_sparse_image_encode(image, statbuf.st_size, out_fd) == 0) {
+    retval = 0;
+  }
+  if (close(out_fd) != 0) {
+    perror("close() failed");
+    retval = -1;
+  }
+
+cleanup2:
+  if (image != NULL) {
+    munmap(image, statbuf.st_size);
+  }
+cleanup1:
+  close(fd);
+  return retval;
+}
@@ -0,0 +1,80 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBHOTH_EXAMPLES_HTOOL_IMAGE_H_
+#define LIBHOTH_EXAMPLES_HTOOL_IMAGE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "protocol/payload_reader.h"
+#include "protocol/sparse_image.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct htool_invocation;
+
+// An image file opened for flashing.
+struct htool_image {
+  // The file, or the stdout of the decompressor reading it.
+  int fd;
+  // The decompressor's pid, or -1 once it has been reaped.
+  pid_t decompressor;
+  // Set if the decompressor exited with an error.
+  bool decompressor_failed;
+  // True if `fd` is a plain image file, which can be mapped instead of
+  // streamed.
+  bool mappable;
+
+  struct libhoth_payload_reader fd_reader;
+  // Reads the expanded image from `fd_reader`.
+  struct libhoth_sparse_reader sparse;
+};
+
+// Opens `path` ("-" for stdin). Files compressed with zstd, xz or lz4 are
+// decompressed by running the matching tool, and sparse images are expanded;
+// read the result from `image->sparse.reader`. A compressed stdin must be
+// decompressed by the caller's pipeline.
+int htool_image_open(const char* path, struct htool_image* image);
+
+// Returns -1 if the decompressor failed. Reads from `image` already fail at
+// the end of the data in that case.
+int htool_image_close(struct htool_image* image);
+
+// The whole expanded image, in memory.
+struct htool_image_data {
+  uint8_t* data;
+  size_t size;
+  // Whether `data` is a mapping of the file rather than a heap buffer.
+  bool mapped;
+};
+
+// Opens `path` as htool_image_open() does and loads it: plain image files are
+// mapped, anything else is read into memory. Free it with
+// htool_image_data_free().
+int htool_image_load(const char* path, struct htool_image_data* data);
+
+void htool_image_data_free(struct htool_image_data* data);
+
+int htool_image_sparse(const struct htool_invocation* inv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBHOTH_EXAMPLES_HTOOL_IMAGE_H_
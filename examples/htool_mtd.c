@@ -34,12 +34,21 @@ struct libhoth_device* htool_libhoth_mtd_device(void) {
   const char* mtddev_path_str;
   const char* mtddev_name_str;
   uint32_t mailbox_location;
+  bool mtddev_mmap;
+  const char* mtddev_mmap_path_str;
+  uint32_t mtddev_mmap_offset;
   rv = htool_get_param_string(htool_global_flags(), "mtddev_path",
                               &mtddev_path_str) ||
        htool_get_param_string(htool_global_flags(), "mtddev_name",
                               &mtddev_name_str) ||
        htool_get_param_u32(htool_global_flags(), "mailbox_location",
-                           &mailbox_location);
+                           &mailbox_location) ||
+       htool_get_param_bool(htool_global_flags(), "mtddev_mmap",
+                            &mtddev_mmap) ||
+       htool_get_param_string(htool_global_flags(), "mtddev_mmap_path",
+                              &mtddev_mmap_path_str) ||
+       htool_get_param_u32(htool_global_flags(), "mtddev_mmap_offset",
+                           &mtddev_mmap_offset);
   if (rv) {
     return NULL;
   }
@@ -52,6 +61,9 @@ struct libhoth_device* htool_libhoth_mtd_device(void) {
       .path = mtddev_path_str,
       .name = mtddev_name_str,
       .mailbox = mailbox_location,
+      .use_mmap = mtddev_mmap,
+      .mmap_path = mtddev_mmap_path_str,
+      .mmap_offset = mtddev_mmap_offset,
   };
   rv = libhoth_mtd_open(&opts, &result);
   if (rv) {
@@ -26,8 +26,11 @@
 
 #include "host_commands.h"
 #include "htool.h"
+#include "htool_image.h"
+#include "protocol/image_hash.h"
 #include "protocol/payload_info.h"
 #include "protocol/payload_status.h"
+#include "protocol/spi_proxy.h"
 
 int htool_payload_status() {
   struct libhoth_device* dev = htool_libhoth_device();
@@ -77,6 +80,21 @@ int htool_payload_status() {
   return 0;
 }
 
+static void print_payload_info(const struct payload_info* info) {
+  printf("Payload Info:\n");
+  printf("  name: %-32s\n", info->image_name);
+  printf("  family: %u\n", info->image_family);
+  printf("  version: %u.%u.%u.%u\n", info->image_version.major,
+         info->image_version.minor, info->image_version.point,
+         info->image_version.subpoint);
+  printf("  type: %u\n", info->image_type);
+  printf("  hash: ");
+  for (int i = 0; i < sizeof(info->image_hash); i++) {
+    printf("%02x", info->image_hash[i]);
+  }
+  printf("\n");
+}
+
 int htool_payload_info(const struct htool_invocation* inv) {
   struct libhoth_device* dev = htool_libhoth_device();
   if (!dev) {
@@ -115,18 +133,7 @@ int htool_payload_info(const struct htool_invocation* inv) {
     goto cleanup;
   }
 
-  printf("Payload Info:\n");
-  printf("  name: %-32s\n", info.image_name);
-  printf("  family: %u\n", info.image_family);
-  printf("  version: %u.%u.%u.%u\n", info.image_version.major,
-         info.image_version.minor, info.image_version.point,
-         info.image_version.subpoint);
-  printf("  type: %u\n", info.image_type);
-  printf("  hash: ");
-  for (int i = 0; i < sizeof(info.image_hash); i++) {
-    printf("%02x", info.image_hash[i]);
-  }
-  printf("\n");
+  print_payload_info(&info);
 
 cleanup:
   if (munmap(image, statbuf.st_size) != 0) {
@@ -142,3 +149,62 @@ cleanup2:
 
   return 0;
 }
+
+int htool_payload_verify_hash(const struct htool_invocation* inv) {
+  const char* image_file;
+  if (htool_get_param_string(inv, "source-file", &image_file) != 0) {
+    return -1;
+  }
+
+  struct htool_image_data image;
+  if (htool_image_load(image_file, &image) != 0) {
+    return -1;
+  }
+  uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE];
+  int hash_size = libhoth_image_compute_hash(image.data, image.size, hash);
+  int status = hash_size < 0 ? -1 : 0;
+  if (status == 0) {
+    printf("hash: ");
+    for (int i = 0; i < hash_size; i++) {
+      printf("%02x", hash[i]);
+    }
+    printf("\n");
+    status = libhoth_image_verify_hash(image.data, image.size);
+  }
+  if (status == 0) {
+    printf("Image hash matches its descriptor.\n");
+  }
+  htool_image_data_free(&image);
+  return status;
+}
+
+int htool_spi_payload_info(const struct htool_invocation* inv) {
+  uint32_t flash_size;
+  const char* address_mode;
+  if (htool_get_param_u32(inv, "flash_size", &flash_size) ||
+      htool_get_param_string(inv, "address_mode", &address_mode)) {
+    return -1;
+  }
+
+  struct libhoth_device* dev = htool_libhoth_device();
+  if (!dev) {
+    return -1;
+  }
+
+  bool is_4_byte;
+  bool enter_exit_4b;
+  if (htool_get_address_mode(address_mode, &is_4_byte, &enter_exit_4b)) {
+    return -1;
+  }
+  struct libhoth_spi_proxy spi;
+  if (libhoth_spi_proxy_init(&spi, dev, is_4_byte, enter_exit_4b)) {
+    return -1;
+  }
+
+  struct payload_info info;
+  if (libhoth_spi_proxy_payload_info(&spi, flash_size, &info)) {
+    return -1;
+  }
+  print_payload_info(&info);
+  return 0;
+}
@@ -26,6 +26,11 @@ extern "C" {
 
 int htool_payload_status();
 int htool_payload_info(const struct htool_invocation* inv);
+// Hashes the static regions of an image file and checks the hash against its
+// image descriptor.
+int htool_payload_verify_hash(const struct htool_invocation* inv);
+// Same as htool_payload_info(), for the image in the SPI flash.
+int htool_spi_payload_info(const struct htool_invocation* inv);
 
 #ifdef __cplusplus
 }
@@ -16,6 +16,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -26,7 +27,9 @@
 
 #include "htool.h"
 #include "htool_cmd.h"
+#include "htool_image.h"
 #include "protocol/payload_update.h"
+#include "protocol/progress.h"
 
 int htool_payload_update(const struct htool_invocation *inv) {
   struct libhoth_device *dev = htool_libhoth_device();
@@ -35,20 +38,25 @@ int htool_payload_update(const struct htool_invocation *inv) {
   }
 
   const char *image_file;
-  if (htool_get_param_string(inv, "source-file", &image_file)) {
+  uint32_t window;
+  bool differential;
+  const char *journal;
+  if (htool_get_param_string(inv, "source-file", &image_file) ||
+      htool_get_param_u32(inv, "window", &window) ||
+      htool_get_param_bool(inv, "differential", &differential) ||
+      htool_get_param_string(inv, "journal", &journal)) {
     return -1;
   }
 
-  int fd = open(image_file, O_RDONLY, 0);
-  if (fd == -1) {
-    fprintf(stderr, "Error opening file %s: %s\n", image_file, strerror(errno));
+  struct htool_image source;
+  if (htool_image_open(image_file, &source)) {
     return -1;
   }
 
   int retval = -1;
 
   struct stat statbuf;
-  if (fstat(fd, &statbuf)) {
+  if (fstat(source.fd, &statbuf)) {
     fprintf(stderr, "fstat error: %s\n", strerror(errno));
     goto cleanup;
   }
@@ -57,14 +65,31 @@ int htool_payload_update(const struct htool_invocation *inv) {
     goto cleanup;
   }
 
-  uint8_t *image = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-  if (image == MAP_FAILED) {
-    fprintf(stderr, "mmap error: %s\n", strerror(errno));
-    goto cleanup;
+  struct libhoth_progress_stderr progress;
+  libhoth_progress_stderr_init(&progress, "Flashing");
+  struct libhoth_payload_update_options options = {
+      .window = window,
+      .progress = &progress.progress,
+      .differential = differential,
+      .journal_path = strlen(journal) > 0 ? journal : NULL,
+  };
+
+  // Plain image files are mapped; everything else is streamed.
+  uint8_t *image = NULL;
+  enum payload_update_err payload_update_status;
+  if (!source.mappable) {
+    payload_update_status = libhoth_payload_update_stream(
+        dev, &source.sparse.reader,
+        libhoth_sparse_reader_image_size(&source.sparse), &options);
+  } else {
+    image = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, source.fd, 0);
+    if (image == MAP_FAILED) {
+      fprintf(stderr, "mmap error: %s\n", strerror(errno));
+      goto cleanup;
+    }
+    payload_update_status = libhoth_payload_update_with_options(
+        dev, image, statbuf.st_size, &options);
   }
-
-  enum payload_update_err payload_update_status =
-      libhoth_payload_update(dev, image, statbuf.st_size);
   switch (payload_update_status) {
     case PAYLOAD_UPDATE_OK:
       fprintf(stderr, "Payload update finished\n");
@@ -86,15 +111,16 @@ int htool_payload_update(const struct htool_invocation *inv) {
       break;
   }
 
-  int ret = munmap(image, statbuf.st_size);
-  if (ret != 0) {
-    fprintf(stderr, "munmap error: %d\n", ret);
+  if (image != NULL) {
+    int ret = munmap(image, statbuf.st_size);
+    if (ret != 0) {
+      fprintf(stderr, "munmap error: %d\n", ret);
+    }
   }
 
 cleanup:
-  ret = close(fd);
-  if (ret != 0) {
-    fprintf(stderr, "close error: %d\n", ret);
+  if (htool_image_close(&source) != 0) {
+    retval = -1;
   }
   return retval;
 }
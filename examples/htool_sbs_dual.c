@@ -1,12 +1,17 @@
 #include "htool_sbs_dual.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "host_commands.h"
+#include "htool.h"
 #include "htool_cmd.h"
+#include "htool_image.h"
 #include "htool_target_control.h"
+#include "protocol/progress.h"
+#include "protocol/spi_proxy.h"
 
 const char* sbs_dual_status_str(uint16_t status);
 
@@ -45,6 +50,198 @@ const char* sbs_dual_status_str(uint16_t status) {
   }
 }
 
+// One of the flashes written by `sbs_dual update`.
+struct sbs_dual_flash {
+  int index;
+  struct htool_image_data image;
+  struct libhoth_spi_proxy_plan plan;
+};
+
+// Reports the progress of one step of `sbs_dual update` as part of the
+// progress of the whole run.
+struct sbs_dual_progress {
+  struct libhoth_progress progress;
+  const struct libhoth_progress* total;
+  uint64_t base;
+  uint64_t total_size;
+};
+
+static void sbs_dual_progress_func(void* param, uint64_t numerator,
+                                   uint64_t denominator) {
+  struct sbs_dual_progress* progress = (struct sbs_dual_progress*)param;
+  progress->total->func(progress->total->param, progress->base + numerator,
+                        progress->total_size);
+}
+
+// Connects the target to the other flash, so that the RoT reaches `index`.
+static int sbs_dual_reach_flash(int index, int* rot_flash) {
+  if (*rot_flash == index) {
+    return 0;
+  }
+  struct hoth_response_target_control response;
+  int ret = target_control_perform_action(
+      HOTH_TARGET_CONTROL_SBS_MUX_DUAL,
+      index == 0
+          ? HOTH_TARGET_CONTROL_ACTION_SBS_MUX_DUAL_CONNECT_TARGET_TO_SPI_FLASH_1
+          : HOTH_TARGET_CONTROL_ACTION_SBS_MUX_DUAL_CONNECT_TARGET_TO_SPI_FLASH_0,
+      &response);
+  if (ret) {
+    return ret;
+  }
+  *rot_flash = index;
+  return 0;
+}
+
+// Returns the flash the RoT reaches (the one the target isn't connected to),
+// or -1 if unknown.
+static int sbs_dual_rot_flash(void) {
+  struct hoth_response_target_control response;
+  if (target_control_perform_action(HOTH_TARGET_CONTROL_SBS_MUX_DUAL,
+                                    HOTH_TARGET_CONTROL_ACTION_GET_STATUS,
+                                    &response) != 0) {
+    return -1;
+  }
+  switch (response.status) {
+    case HOTH_TARGET_CONTROL_SBS_MUX_DUAL_TARGET_CONNECTED_TO_SPI_FLASH_0:
+      return 1;
+    case HOTH_TARGET_CONTROL_SBS_MUX_DUAL_TARGET_CONNECTED_TO_SPI_FLASH_1:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+static int sbs_dual_update(const struct htool_invocation* inv) {
+  struct {
+    const char* files[2];
+    uint32_t start;
+    bool verify;
+    uint32_t window;
+    bool differential;
+    const char* address_mode;
+  } args;
+  if (htool_get_param_string(inv, "flash_0", &args.files[0]) ||
+      htool_get_param_string(inv, "flash_1", &args.files[1]) ||
+      htool_get_param_u32(inv, "start", &args.start) ||
+      htool_get_param_bool(inv, "verify", &args.verify) ||
+      htool_get_param_u32(inv, "window", &args.window) ||
+      htool_get_param_bool(inv, "differential", &args.differential) ||
+      htool_get_param_string(inv, "address_mode", &args.address_mode)) {
+    return -1;
+  }
+  bool is_4_byte;
+  bool enter_exit_4b;
+  if (htool_get_address_mode(args.address_mode, &is_4_byte, &enter_exit_4b)) {
+    return -1;
+  }
+
+  struct libhoth_device* dev = htool_libhoth_device();
+  if (!dev) {
+    return -1;
+  }
+
+  // Start with the flash the RoT already reaches, so that the mux is only
+  // switched once between the two.
+  const int initial_rot_flash = sbs_dual_rot_flash();
+  int rot_flash = initial_rot_flash;
+  const int first = initial_rot_flash == 1 ? 1 : 0;
+
+  struct sbs_dual_flash flashes[2];
+  size_t num_flashes = 0;
+  for (int i = 0; i < 2; i++) {
+    const int index = i == 0 ? first : 1 - first;
+    if (strlen(args.files[index]) > 0) {
+      flashes[num_flashes++] = (struct sbs_dual_flash){.index = index};
+    }
+  }
+  if (num_flashes == 0) {
+    fprintf(stderr, "Pass --flash_0 and/or --flash_1\n");
+    return -1;
+  }
+
+  int result = -1;
+  size_t num_loaded = 0;
+  uint64_t total_size = 0;
+  for (; num_loaded < num_flashes; num_loaded++) {
+    struct sbs_dual_flash* flash = &flashes[num_loaded];
+    if (htool_image_load(args.files[flash->index], &flash->image)) {
+      goto cleanup;
+    }
+    total_size += flash->image.size * (args.verify ? 2 : 1);
+  }
+
+  struct libhoth_spi_proxy spi = {
+      .dev = dev,
+      .is_4_byte = is_4_byte,
+      .window = args.window,
+  };
+  // Without --differential the plans don't depend on what's in the flashes,
+  // so both are made before the first flash is touched, and the second one is
+  // started as soon as the first is done.
+  if (!args.differential) {
+    for (size_t i = 0; i < num_flashes; i++) {
+      if (libhoth_spi_proxy_plan_update(
+              &spi, args.start, flashes[i].image.data, flashes[i].image.size,
+              /*read_flash=*/false, &flashes[i].plan)) {
+        goto cleanup;
+      }
+    }
+  }
+
+  struct libhoth_progress_stderr total_progress;
+  libhoth_progress_stderr_init(&total_progress, "Erasing/Programming/Verifying");
+  struct sbs_dual_progress progress = {
+      .progress = {.func = sbs_dual_progress_func, .param = &progress},
+      .total = &total_progress.progress,
+      .total_size = total_size,
+  };
+  for (size_t i = 0; i < num_flashes; i++) {
+    struct sbs_dual_flash* flash = &flashes[i];
+    if (sbs_dual_reach_flash(flash->index, &rot_flash) ||
+        libhoth_spi_proxy_init(&spi, dev, is_4_byte, enter_exit_4b)) {
+      goto restore_mux;
+    }
+    spi.window = args.window;
+    if (args.differential &&
+        libhoth_spi_proxy_plan_update(&spi, args.start, flash->image.data,
+                                      flash->image.size, /*read_flash=*/true,
+                                      &flash->plan)) {
+      goto restore_mux;
+    }
+    if (libhoth_spi_proxy_apply_plan(&spi, &flash->plan, flash->image.data,
+                                     &progress.progress)) {
+      fprintf(stderr, "Failed to update spi flash %d\n", flash->index);
+      goto restore_mux;
+    }
+    progress.base += flash->image.size;
+    if (args.verify) {
+      if (libhoth_spi_proxy_verify(&spi, args.start, flash->image.data,
+                                   flash->image.size, &progress.progress)) {
+        fprintf(stderr, "Failed to verify spi flash %d\n", flash->index);
+        goto restore_mux;
+      }
+      progress.base += flash->image.size;
+    }
+  }
+  result = 0;
+
+restore_mux:
+  if (initial_rot_flash >= 0 &&
+      sbs_dual_reach_flash(initial_rot_flash, &rot_flash) != 0) {
+    fprintf(stderr, "Failed to put the SBS mux back\n");
+    result = -1;
+  }
+
+cleanup:
+  for (size_t i = 0; i < num_flashes; i++) {
+    libhoth_spi_proxy_plan_destroy(&flashes[i].plan);
+  }
+  for (size_t i = 0; i < num_loaded; i++) {
+    htool_image_data_free(&flashes[i].image);
+  }
+  return result;
+}
+
 int htool_sbs_dual_run(const struct htool_invocation* inv) {
   const char* subcommand = inv->cmd->verbs[1];
   if (strcmp(subcommand, SBS_DUAL_GET_CMD_STR) == 0) {
@@ -57,6 +254,8 @@ int htool_sbs_dual_run(const struct htool_invocation* inv) {
                     SBS_DUAL_CONNECT_TARGET_TO_SPI_FLASH_1_CMD_STR) == 0) {
     return sbs_dual_perform_action(
         HOTH_TARGET_CONTROL_ACTION_SBS_MUX_DUAL_CONNECT_TARGET_TO_SPI_FLASH_1);
+  } else if (strcmp(subcommand, SBS_DUAL_UPDATE_CMD_STR) == 0) {
+    return sbs_dual_update(inv);
   } else {
     fprintf(stderr, "Invalid subcommand: %s\n", subcommand);
     return -1;
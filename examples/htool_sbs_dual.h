@@ -8,6 +8,7 @@
   "connect_target_to_spi_flash_0"
 #define SBS_DUAL_CONNECT_TARGET_TO_SPI_FLASH_1_CMD_STR \
   "connect_target_to_spi_flash_1"
+#define SBS_DUAL_UPDATE_CMD_STR "update"
 
 int htool_sbs_dual_run(const struct htool_invocation* inv);
 
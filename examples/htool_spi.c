@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -24,6 +25,41 @@
 #include "htool.h"
 #include "htool_cmd.h"
 
+static int parse_read_mode(const char* str, int* read_mode) {
+  if (strcmp(str, "slow") == 0) {
+    *read_mode = LIBHOTH_SPI_READ_MODE_SLOW;
+  } else if (strcmp(str, "fast") == 0) {
+    *read_mode = LIBHOTH_SPI_READ_MODE_FAST;
+  } else if (strcmp(str, "dual") == 0) {
+    *read_mode = LIBHOTH_SPI_READ_MODE_DUAL;
+  } else if (strcmp(str, "quad") == 0) {
+    *read_mode = LIBHOTH_SPI_READ_MODE_QUAD;
+  } else {
+    fprintf(stderr, "Invalid spidev read mode: %s\n", str);
+    return -1;
+  }
+  return 0;
+}
+
+// Splits a '<chip path>:<line>' spec. `chip` must hold PATH_MAX bytes.
+static int parse_ready_gpio(const char* str, char* chip, uint32_t* line) {
+  const char* sep = strrchr(str, ':');
+  char* end;
+  if (sep == NULL || sep == str || sep - str >= PATH_MAX || sep[1] == '\0') {
+    fprintf(stderr, "Invalid spidev ready GPIO: %s\n", str);
+    return -1;
+  }
+  unsigned long value = strtoul(sep + 1, &end, 0);
+  if (*end != '\0' || value > UINT32_MAX) {
+    fprintf(stderr, "Invalid spidev ready GPIO line: %s\n", sep + 1);
+    return -1;
+  }
+  memcpy(chip, str, sep - str);
+  chip[sep - str] = '\0';
+  *line = value;
+  return 0;
+}
+
 struct libhoth_device* htool_libhoth_spi_device(void) {
   static struct libhoth_device* result;
   if (result) {
@@ -37,6 +73,11 @@ struct libhoth_device* htool_libhoth_spi_device(void) {
   uint32_t spidev_speed_hz;
   uint32_t spidev_device_busy_wait_timeout;
   uint32_t spidev_device_busy_wait_check_interval;
+  const char* spidev_read_mode_str;
+  uint32_t spidev_speculative_read_size;
+  const char* spidev_ready_gpio_str;
+  bool spidev_ready_gpio_active_low;
+  bool spidev_adaptive_busy_wait;
   rv = htool_get_param_string(htool_global_flags(), "spidev_path",
                               &spidev_path_str) ||
        htool_get_param_u32(htool_global_flags(), "mailbox_location",
@@ -49,7 +90,18 @@ struct libhoth_device* htool_libhoth_spi_device(void) {
                            &spidev_device_busy_wait_timeout) ||
        htool_get_param_u32(htool_global_flags(),
                            "spidev_device_busy_wait_check_interval",
-                           &spidev_device_busy_wait_check_interval);
+                           &spidev_device_busy_wait_check_interval) ||
+       htool_get_param_string(htool_global_flags(), "spidev_read_mode",
+                              &spidev_read_mode_str) ||
+       htool_get_param_u32(htool_global_flags(), "spidev_speculative_read_size",
+                           &spidev_speculative_read_size) ||
+       htool_get_param_string(htool_global_flags(), "spidev_ready_gpio",
+                              &spidev_ready_gpio_str) ||
+       htool_get_param_bool(htool_global_flags(),
+                            "spidev_ready_gpio_active_low",
+                            &spidev_ready_gpio_active_low) ||
+       htool_get_param_bool(htool_global_flags(), "spidev_adaptive_busy_wait",
+                            &spidev_adaptive_busy_wait);
   if (rv) {
     return NULL;
   }
@@ -59,6 +111,19 @@ struct libhoth_device* htool_libhoth_spi_device(void) {
     return NULL;
   }
 
+  int read_mode;
+  if (parse_read_mode(spidev_read_mode_str, &read_mode) != 0) {
+    return NULL;
+  }
+
+  char ready_gpio_chip[PATH_MAX] = "";
+  uint32_t ready_gpio_line = 0;
+  if (strlen(spidev_ready_gpio_str) > 0 &&
+      parse_ready_gpio(spidev_ready_gpio_str, ready_gpio_chip,
+                       &ready_gpio_line) != 0) {
+    return NULL;
+  }
+
   struct libhoth_spi_device_init_options opts = {
       .path = spidev_path_str,
       .mailbox = mailbox_location,
@@ -66,6 +131,12 @@ struct libhoth_device* htool_libhoth_spi_device(void) {
       .speed = spidev_speed_hz,
       .device_busy_wait_timeout = spidev_device_busy_wait_timeout,
       .device_busy_wait_check_interval = spidev_device_busy_wait_check_interval,
+      .read_mode = read_mode,
+      .speculative_read_size = spidev_speculative_read_size,
+      .ready_gpio_chip = ready_gpio_chip,
+      .ready_gpio_line = ready_gpio_line,
+      .ready_gpio_active_low = spidev_ready_gpio_active_low,
+      .adaptive_busy_wait = spidev_adaptive_busy_wait,
   };
   rv = libhoth_spi_open(&opts, &result);
   if (rv) {
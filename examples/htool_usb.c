@@ -29,6 +29,7 @@
 #include "host_commands.h"
 #include "htool_cmd.h"
 #include "transports/libhoth_usb.h"
+#include "transports/libhoth_usb_device.h"
 
 static int enumerate_devices(
     libusb_context* libusb_ctx,
@@ -381,6 +382,17 @@ struct libhoth_device* htool_libhoth_usb_device(void) {
       fprintf(stderr, "Invalid format for --usb_retry_delay: %s\n", delay_str);
       return NULL;
   }
+  uint32_t pipeline_depth;
+  if (htool_get_param_u32(htool_global_flags(), "usb_fifo_pipeline_depth",
+                          &pipeline_depth)) {
+    return NULL;
+  }
+  if (pipeline_depth < 1 ||
+      pipeline_depth > LIBHOTH_USB_FIFO_MAX_PIPELINE_DEPTH) {
+    fprintf(stderr, "Invalid --usb_fifo_pipeline_depth: %u\n",
+            pipeline_depth);
+    return NULL;
+  }
   // Convert duration to milliseconds for comparison with monotonic time helper
   uint64_t retry_duration_ms = (uint64_t)retry_duration_us / 1000;
 
@@ -396,7 +408,10 @@ struct libhoth_device* htool_libhoth_usb_device(void) {
       monotonic_time.tv_sec ^ monotonic_time.tv_nsec ^ getpid();
 
   struct libhoth_usb_device_init_options opts = {
-      .usb_device = usb_dev, .usb_ctx = ctx, .prng_seed = prng_seed};
+      .usb_device = usb_dev,
+      .usb_ctx = ctx,
+      .prng_seed = prng_seed,
+      .fifo_pipeline_depth = (uint8_t)pipeline_depth};
 
   int rv = LIBUSB_ERROR_BUSY; // Initialize rv to trigger the loop
   uint64_t start_time_ms = get_monotonic_ms();
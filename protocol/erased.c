@@ -0,0 +1,105 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "erased.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Bytes checked per iteration of the vector loops.
+#define ERASED_BLOCK_SIZE 64
+
+// Returns true if the ERASED_BLOCK_SIZE bytes at `p` are all 0xFF.
+static inline bool erased_block(const uint8_t* p) {
+#if defined(__SSE2__)
+  __m128i v = _mm_and_si128(
+      _mm_and_si128(_mm_loadu_si128((const __m128i*)p),
+                    _mm_loadu_si128((const __m128i*)(p + 16))),
+      _mm_and_si128(_mm_loadu_si128((const __m128i*)(p + 32)),
+                    _mm_loadu_si128((const __m128i*)(p + 48))));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)0xFF))) ==
+         0xFFFF;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  uint8x16_t v = vandq_u8(vandq_u8(vld1q_u8(p), vld1q_u8(p + 16)),
+                          vandq_u8(vld1q_u8(p + 32), vld1q_u8(p + 48)));
+  return vminvq_u8(v) == 0xFF;
+#else
+  uint64_t acc = UINT64_MAX;
+  for (size_t i = 0; i < ERASED_BLOCK_SIZE; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, p + i, sizeof(word));
+    acc &= word;
+  }
+  return acc == UINT64_MAX;
+#endif
+}
+
+static inline bool erased_word(const uint8_t* p) {
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word == UINT64_MAX;
+}
+
+size_t libhoth_erased_prefix_len(const uint8_t* buf, size_t len) {
+  size_t i = 0;
+  // Whole blocks and words first; the byte loop finds where the run ends.
+  while (i + ERASED_BLOCK_SIZE <= len && erased_block(buf + i)) {
+    i += ERASED_BLOCK_SIZE;
+  }
+  while (i + sizeof(uint64_t) <= len && erased_word(buf + i)) {
+    i += sizeof(uint64_t);
+  }
+  while (i < len && buf[i] == 0xFF) {
+    i++;
+  }
+  return i;
+}
+
+size_t libhoth_erased_suffix_len(const uint8_t* buf, size_t len) {
+  size_t i = len;
+  while (i >= ERASED_BLOCK_SIZE && erased_block(buf + i - ERASED_BLOCK_SIZE)) {
+    i -= ERASED_BLOCK_SIZE;
+  }
+  while (i >= sizeof(uint64_t) && erased_word(buf + i - sizeof(uint64_t))) {
+    i -= sizeof(uint64_t);
+  }
+  while (i > 0 && buf[i - 1] == 0xFF) {
+    i--;
+  }
+  return len - i;
+}
+
+bool libhoth_next_programmed_span(const uint8_t* buf, size_t len,
+                                  size_t max_span_len, size_t* offset,
+                                  size_t* span_len) {
+  if (*offset >= len) {
+    return false;
+  }
+  *offset += libhoth_erased_prefix_len(buf + *offset, len - *offset);
+  if (*offset == len) {
+    return false;
+  }
+  const size_t max_len = MIN(max_span_len, len - *offset);
+  *span_len = max_len - libhoth_erased_suffix_len(buf + *offset, max_len);
+  return true;
+}
@@ -0,0 +1,46 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LIBHOTH_PROTOCOL_ERASED_H_
+#define _LIBHOTH_PROTOCOL_ERASED_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Helpers for skipping erased (0xFF) flash contents in images, which tend to
+// be mostly erased. They use SSE2 or NEON where the target has them.
+
+// Returns the number of leading 0xFF bytes in `buf`.
+size_t libhoth_erased_prefix_len(const uint8_t* buf, size_t len);
+
+// Returns the number of trailing 0xFF bytes in `buf`.
+size_t libhoth_erased_suffix_len(const uint8_t* buf, size_t len);
+
+// Finds the next span of `buf` that holds data, starting at or after
+// `*offset`. The span is at most `max_span_len` bytes, and neither starts nor
+// ends with 0xFF. Returns false if the rest of `buf` is erased.
+bool libhoth_next_programmed_span(const uint8_t* buf, size_t len,
+                                  size_t max_span_len, size_t* offset,
+                                  size_t* span_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _LIBHOTH_PROTOCOL_ERASED_H_
@@ -0,0 +1,73 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "erased.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+TEST(ErasedTest, PrefixAndSuffix) {
+  // Long enough to go through the block, word and byte loops.
+  for (size_t len : {0, 1, 7, 8, 63, 64, 65, 200}) {
+    for (size_t pos = 0; pos < len; ++pos) {
+      std::vector<uint8_t> buf(len, 0xFF);
+      buf[pos] = 0xFE;
+      EXPECT_EQ(libhoth_erased_prefix_len(buf.data(), len), pos);
+      EXPECT_EQ(libhoth_erased_suffix_len(buf.data(), len), len - pos - 1);
+    }
+    std::vector<uint8_t> erased(len, 0xFF);
+    EXPECT_EQ(libhoth_erased_prefix_len(erased.data(), len), len);
+    EXPECT_EQ(libhoth_erased_suffix_len(erased.data(), len), len);
+  }
+}
+
+TEST(ErasedTest, NextProgrammedSpan) {
+  std::vector<uint8_t> buf(300, 0xFF);
+  buf[10] = 0;
+  buf[20] = 0;
+  buf[250] = 0;
+
+  size_t offset = 0;
+  size_t span_len = 0;
+  ASSERT_TRUE(
+      libhoth_next_programmed_span(buf.data(), buf.size(), 100, &offset,
+                                   &span_len));
+  EXPECT_EQ(offset, 10);
+  EXPECT_EQ(span_len, 11);
+
+  offset += span_len;
+  ASSERT_TRUE(
+      libhoth_next_programmed_span(buf.data(), buf.size(), 100, &offset,
+                                   &span_len));
+  EXPECT_EQ(offset, 250);
+  EXPECT_EQ(span_len, 1);
+
+  offset += span_len;
+  EXPECT_FALSE(libhoth_next_programmed_span(buf.data(), buf.size(), 100,
+                                            &offset, &span_len));
+}
+
+TEST(ErasedTest, NextProgrammedSpanIsCapped) {
+  std::vector<uint8_t> buf(300, 0);
+
+  size_t offset = 0;
+  size_t span_len = 0;
+  ASSERT_TRUE(
+      libhoth_next_programmed_span(buf.data(), buf.size(), 128, &offset,
+                                   &span_len));
+  EXPECT_EQ(offset, 0);
+  EXPECT_EQ(span_len, 128);
+}
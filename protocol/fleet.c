@@ -0,0 +1,117 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fleet.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "host_cmd.h"
+
+struct fleet_pool {
+  struct libhoth_fleet_member* members;
+  size_t num_members;
+  libhoth_fleet_op op;
+  void* param;
+
+  pthread_mutex_t lock;
+  size_t next;
+};
+
+static void* fleet_worker(void* arg) {
+  struct fleet_pool* pool = (struct fleet_pool*)arg;
+  while (true) {
+    pthread_mutex_lock(&pool->lock);
+    size_t index = pool->next;
+    if (index < pool->num_members) {
+      pool->next++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (index >= pool->num_members) {
+      return NULL;
+    }
+
+    struct libhoth_fleet_member* member = &pool->members[index];
+    if (member->dev == NULL) {
+      member->status = LIBHOTH_ERR_INVALID_PARAMETER;
+      continue;
+    }
+    member->status = pool->op(member, index, pool->param);
+  }
+}
+
+int libhoth_fleet_run(struct libhoth_fleet_member* members, size_t num_members,
+                      size_t max_workers, libhoth_fleet_op op, void* param) {
+  if ((members == NULL && num_members > 0) || op == NULL) {
+    return -1;
+  }
+  if (max_workers == 0) {
+    max_workers = LIBHOTH_FLEET_DEFAULT_MAX_WORKERS;
+  }
+  if (max_workers > num_members) {
+    max_workers = num_members;
+  }
+
+  struct fleet_pool pool = {
+      .members = members,
+      .num_members = num_members,
+      .op = op,
+      .param = param,
+      .next = 0,
+  };
+  pthread_mutex_init(&pool.lock, NULL);
+
+  pthread_t workers[max_workers > 0 ? max_workers : 1];
+  size_t num_started = 0;
+  for (; num_started < max_workers; num_started++) {
+    int rv = pthread_create(&workers[num_started], NULL, fleet_worker, &pool);
+    if (rv != 0) {
+      fprintf(stderr, "pthread_create() failed: %s\n", strerror(rv));
+      break;
+    }
+  }
+  if (num_started == 0 && num_members > 0) {
+    pthread_mutex_destroy(&pool.lock);
+    return -1;
+  }
+  for (size_t i = 0; i < num_started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  pthread_mutex_destroy(&pool.lock);
+
+  int num_failed = 0;
+  for (size_t i = 0; i < num_members; i++) {
+    if (members[i].status != 0) {
+      num_failed++;
+    }
+  }
+  return num_failed;
+}
+
+int libhoth_fleet_hostcmd_op(struct libhoth_fleet_member* member,
+                             size_t index, void* param) {
+  (void)index;
+  const struct libhoth_fleet_hostcmd* cmd =
+      (const struct libhoth_fleet_hostcmd*)param;
+  member->result_size = 0;
+  if (cmd == NULL || (cmd->resp_buf_size > 0 && member->result == NULL)) {
+    return -1;
+  }
+  return libhoth_hostcmd_exec(member->dev, cmd->command, cmd->version,
+                              cmd->req_payload, cmd->req_payload_size,
+                              member->result, cmd->resp_buf_size,
+                              &member->result_size);
+}
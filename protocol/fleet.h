@@ -0,0 +1,84 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBHOTH_PROTOCOL_FLEET_H_
+#define LIBHOTH_PROTOCOL_FLEET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "transports/libhoth_device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default number of devices operated on concurrently by libhoth_fleet_run().
+#define LIBHOTH_FLEET_DEFAULT_MAX_WORKERS 8
+
+// One RoT in a fleet. Devices may come from any transport (USB, spidev, mtd,
+// ...); the fleet never opens or closes them itself.
+struct libhoth_fleet_member {
+  struct libhoth_device* dev;
+  // Human-readable identifier (e.g. usb_loc or device path); optional.
+  const char* name;
+  // Per-device scratch space for the operation's output; optional.
+  void* result;
+  // Number of valid bytes in `result`, if the operation sets it (as
+  // libhoth_fleet_hostcmd_op() does).
+  size_t result_size;
+
+  // Filled in by libhoth_fleet_run(): the return value of the operation for
+  // this device.
+  int status;
+};
+
+// An operation to run against one device. `index` is the member's position in
+// the array passed to libhoth_fleet_run(). Operations run concurrently on
+// different devices, so they must not share mutable state without their own
+// locking. Returns 0 on success.
+typedef int (*libhoth_fleet_op)(struct libhoth_fleet_member* member,
+                                size_t index, void* param);
+
+// Runs `op` once for every member, with at most `max_workers` devices being
+// operated on at the same time (0 means LIBHOTH_FLEET_DEFAULT_MAX_WORKERS).
+// Each device is only ever used by one worker, so the operation may issue any
+// sequence of host commands (a whole payload update, for example). Returns
+// the number of members whose operation failed, or -1 if the worker pool
+// could not be started.
+int libhoth_fleet_run(struct libhoth_fleet_member* members, size_t num_members,
+                      size_t max_workers, libhoth_fleet_op op, void* param);
+
+// Parameters for libhoth_fleet_hostcmd_op(). Up to `resp_buf_size` bytes of
+// response are written to each member's `result` buffer, which must be at
+// least that large, and the actual size to its `result_size`.
+struct libhoth_fleet_hostcmd {
+  uint16_t command;
+  uint8_t version;
+  const void* req_payload;
+  size_t req_payload_size;
+  size_t resp_buf_size;
+};
+
+// A libhoth_fleet_op that sends the same host command (a
+// `struct libhoth_fleet_hostcmd` passed as `param`) to every device. `index`
+// is unused.
+int libhoth_fleet_hostcmd_op(struct libhoth_fleet_member* member,
+                             size_t index, void* param);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBHOTH_PROTOCOL_FLEET_H_
@@ -0,0 +1,161 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fleet.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+
+#include "test/libhoth_device_mock.h"
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Return;
+
+constexpr int kCmd = 0xff42;
+constexpr size_t kNumDevices = 5;
+
+TEST_F(LibHothTest, fleet_hostcmd_all_devices) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .Times(kNumDevices)
+      .WillRepeatedly(Return(LIBHOTH_OK));
+  const uint32_t expected_resp = 0x5a5a1234;
+  EXPECT_CALL(mock_, receive)
+      .Times(kNumDevices)
+      .WillRepeatedly(DoAll(CopyResp(&expected_resp, sizeof(expected_resp)),
+                            Return(LIBHOTH_OK)));
+
+  struct libhoth_device devs[kNumDevices];
+  uint32_t results[kNumDevices] = {};
+  struct libhoth_fleet_member members[kNumDevices] = {};
+  for (size_t i = 0; i < kNumDevices; i++) {
+    devs[i] = hoth_dev_;
+    members[i].dev = &devs[i];
+    members[i].result = &results[i];
+    members[i].status = -1;
+  }
+
+  struct libhoth_fleet_hostcmd cmd = {
+      .command = kCmd,
+      .resp_buf_size = sizeof(uint32_t),
+  };
+  EXPECT_EQ(libhoth_fleet_run(members, kNumDevices, /*max_workers=*/2,
+                              libhoth_fleet_hostcmd_op, &cmd),
+            0);
+  for (size_t i = 0; i < kNumDevices; i++) {
+    EXPECT_EQ(members[i].status, 0);
+    EXPECT_EQ(members[i].result_size, sizeof(expected_resp));
+    EXPECT_EQ(results[i], expected_resp);
+  }
+}
+
+TEST_F(LibHothTest, fleet_hostcmd_variable_size_responses) {
+  struct libhoth_device devs[kNumDevices];
+  uint8_t results[kNumDevices][kNumDevices] = {};
+  struct libhoth_fleet_member members[kNumDevices] = {};
+  const uint8_t payload[kNumDevices] = {1, 2, 3, 4, 5};
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .Times(kNumDevices)
+      .WillRepeatedly(Return(LIBHOTH_OK));
+  for (size_t i = 0; i < kNumDevices; i++) {
+    devs[i] = hoth_dev_;
+    members[i].dev = &devs[i];
+    members[i].result = results[i];
+    // Device i answers with i + 1 bytes.
+    EXPECT_CALL(mock_, receive(&devs[i], _, _, _, _))
+        .WillOnce(DoAll(CopyResp(payload, i + 1), Return(LIBHOTH_OK)));
+  }
+
+  struct libhoth_fleet_hostcmd cmd = {
+      .command = kCmd,
+      .resp_buf_size = kNumDevices,
+  };
+  EXPECT_EQ(libhoth_fleet_run(members, kNumDevices, /*max_workers=*/0,
+                              libhoth_fleet_hostcmd_op, &cmd),
+            0);
+  for (size_t i = 0; i < kNumDevices; i++) {
+    EXPECT_EQ(members[i].status, 0);
+    ASSERT_EQ(members[i].result_size, i + 1);
+    EXPECT_EQ(std::memcmp(results[i], payload, i + 1), 0);
+  }
+}
+
+TEST_F(LibHothTest, fleet_hostcmd_device_fails) {
+  struct libhoth_device devs[kNumDevices];
+  uint32_t results[kNumDevices] = {};
+  struct libhoth_fleet_member members[kNumDevices] = {};
+  const uint32_t expected_resp = 0x5a5a1234;
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .Times(kNumDevices)
+      .WillRepeatedly(Return(LIBHOTH_OK));
+  for (size_t i = 0; i < kNumDevices; i++) {
+    devs[i] = hoth_dev_;
+    members[i].dev = &devs[i];
+    members[i].result = &results[i];
+    if (i == 2) {
+      // Never answers.
+      EXPECT_CALL(mock_, receive(&devs[i], _, _, _, _))
+          .WillOnce(Return(LIBHOTH_ERR_TIMEOUT));
+    } else {
+      EXPECT_CALL(mock_, receive(&devs[i], _, _, _, _))
+          .WillOnce(DoAll(CopyResp(&expected_resp, sizeof(expected_resp)),
+                          Return(LIBHOTH_OK)));
+    }
+  }
+
+  struct libhoth_fleet_hostcmd cmd = {
+      .command = kCmd,
+      .resp_buf_size = sizeof(uint32_t),
+  };
+  EXPECT_EQ(libhoth_fleet_run(members, kNumDevices, /*max_workers=*/2,
+                              libhoth_fleet_hostcmd_op, &cmd),
+            1);
+  for (size_t i = 0; i < kNumDevices; i++) {
+    if (i == 2) {
+      EXPECT_NE(members[i].status, 0);
+      EXPECT_EQ(members[i].result_size, 0);
+    } else {
+      EXPECT_EQ(members[i].status, 0);
+      EXPECT_EQ(members[i].result_size, sizeof(expected_resp));
+      EXPECT_EQ(results[i], expected_resp);
+    }
+  }
+}
+
+TEST_F(LibHothTest, fleet_reports_per_device_failures) {
+  struct libhoth_fleet_member members[kNumDevices] = {};
+  for (size_t i = 0; i < kNumDevices; i++) {
+    members[i].dev = &hoth_dev_;
+  }
+  members[3].dev = nullptr;
+
+  std::atomic<int> calls{0};
+  auto fail_odd = [](struct libhoth_fleet_member*, size_t index,
+                     void* param) -> int {
+    static_cast<std::atomic<int>*>(param)->fetch_add(1);
+    return (index % 2) ? -1 : 0;
+  };
+  // Members 1 and 3 fail: 1 from the operation, 3 for lacking a device.
+  EXPECT_EQ(libhoth_fleet_run(members, kNumDevices, /*max_workers=*/0,
+                              fail_odd, &calls),
+            2);
+  EXPECT_EQ(calls.load(), (int)kNumDevices - 1);
+  EXPECT_EQ(members[0].status, 0);
+  EXPECT_EQ(members[1].status, -1);
+  EXPECT_EQ(members[3].status, LIBHOTH_ERR_INVALID_PARAMETER);
+  EXPECT_EQ(members[4].status, 0);
+}
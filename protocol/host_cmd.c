@@ -19,6 +19,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/param.h>
+#include <time.h>
+#include <unistd.h>
 
 void hex_dump(FILE* out, const void* buffer, size_t size) {
   if (!buffer || !size) {
@@ -74,19 +77,35 @@ uint8_t libhoth_calculate_checksum(const void* header, size_t header_size,
   return 0x100 - sum;
 }
 
+static uint8_t iov_checksum(const void* header, size_t header_size,
+                            const struct iovec* iov, int iovcnt,
+                            size_t data_size) {
+  uint8_t sum = 0x100 - libhoth_calculate_checksum(header, header_size, NULL, 0);
+  for (int i = 0; i < iovcnt && data_size > 0; ++i) {
+    size_t len = iov[i].iov_len < data_size ? iov[i].iov_len : data_size;
+    sum += 0x100 - libhoth_calculate_checksum(iov[i].iov_base, len, NULL, 0);
+    data_size -= len;
+  }
+  return 0x100 - sum;
+}
+
 static int populate_ec_request_header(uint16_t command, uint8_t command_version,
-                                      const void* request, size_t request_size,
+                                      const struct iovec* request_iov,
+                                      int request_iovcnt,
                                       struct hoth_host_request* request_header) {
   if (!request_header) {
     fprintf(stderr, "Request header argument cannot be NULL\n");
     return -EINVAL;
   }
 
-  if (request_size > 0 && !request) {
-    fprintf(stderr, "Request data argument cannot be NULL with size > 0\n");
-    return -EINVAL;
+  for (int i = 0; i < request_iovcnt; ++i) {
+    if (request_iov[i].iov_len > 0 && !request_iov[i].iov_base) {
+      fprintf(stderr, "Request data argument cannot be NULL with size > 0\n");
+      return -EINVAL;
+    }
   }
 
+  size_t request_size = libhoth_iov_length(request_iov, request_iovcnt);
   if (request_size > UINT16_MAX) {
     fprintf(stderr, "Error, request_size (%lu) > max (%lu)\n",
             (unsigned long)request_size, (unsigned long)UINT16_MAX);
@@ -100,14 +119,16 @@ static int populate_ec_request_header(uint16_t command, uint8_t command_version,
   request_header->reserved = 0;
   request_header->data_len = (uint16_t)request_size;
   // Note that we've set `checksum` to zero earlier, so this is deterministic.
-  request_header->checksum = libhoth_calculate_checksum(
-      request_header, sizeof(*request_header), request, request_size);
+  request_header->checksum =
+      iov_checksum(request_header, sizeof(*request_header), request_iov,
+                   request_iovcnt, request_size);
 
   return 0;
 }
 
 static int validate_ec_response_header(
-    const struct hoth_host_response* response_header, const void* response,
+    const struct hoth_host_response* response_header,
+    const struct iovec* response_iov, int response_iovcnt,
     size_t response_size) {
   uint8_t response_checksum;
 
@@ -116,13 +137,6 @@ static int validate_ec_response_header(
     return -EINVAL;
   }
 
-  if (!response && response_header->data_len > 0) {
-    fprintf(
-        stderr,
-        "response cannot be NULL if the response data_len is greater than 0\n");
-    return -EINVAL;
-  }
-
   if (response_header->struct_version != HOTH_HOST_RESPONSE_VERSION) {
     fprintf(stderr, "Error: unexpected struct_version. Got %u, expected %u\n",
             response_header->struct_version, HOTH_HOST_RESPONSE_VERSION);
@@ -137,8 +151,8 @@ static int validate_ec_response_header(
   }
 
   response_checksum =
-      libhoth_calculate_checksum(response_header, sizeof(*response_header),
-                                    response, response_header->data_len);
+      iov_checksum(response_header, sizeof(*response_header), response_iov,
+                   response_iovcnt, response_header->data_len);
 
   // Since this checksum includes the `checksum` field in `response_header`, it
   // should be zero.
@@ -146,8 +160,15 @@ static int validate_ec_response_header(
     fprintf(stderr, "Error: response checksum (%u) != 0\n", response_checksum);
     fprintf(stderr, "Response header:\n");
     hex_dump(stderr, response_header, sizeof(*response_header));
-    fprintf(stderr, "Response body:\n");
-    hex_dump(stderr, response, response_header->data_len);
+    if (response_header->data_len > 0) {
+      uint8_t response[LIBHOTH_MAILBOX_SIZE];
+      size_t len = libhoth_iov_gather(response, sizeof(response), response_iov,
+                                      response_iovcnt);
+      fprintf(stderr, "Response body:\n");
+      hex_dump(stderr, response,
+               len < response_header->data_len ? len
+                                               : response_header->data_len);
+    }
     return -EINVAL;
   }
 
@@ -157,79 +178,250 @@ static int validate_ec_response_header(
 int libhoth_hostcmd_exec(struct libhoth_device* dev, uint16_t command, uint8_t version,
                  const void* req_payload, size_t req_payload_size,
                  void* resp_buf, size_t resp_buf_size, size_t* out_resp_size) {
-  struct {
-    struct hoth_host_request hdr;
-    uint8_t payload_buf[LIBHOTH_MAILBOX_SIZE - sizeof(struct hoth_host_request)];
-  } req;
-  if (req_payload_size > sizeof(req.payload_buf)) {
+  const struct iovec req_iov = {
+      .iov_base = (void*)req_payload,
+      .iov_len = req_payload_size,
+  };
+  return libhoth_hostcmd_execv(dev, command, version, &req_iov, 1, resp_buf,
+                               resp_buf_size, out_resp_size);
+}
+
+static int hostcmd_send(struct libhoth_device* dev, uint16_t command,
+                        uint8_t version, const struct iovec* req_iov,
+                        int req_iovcnt) {
+  if (req_iovcnt < 0 || req_iovcnt >= LIBHOTH_IOV_MAX ||
+      (req_iovcnt > 0 && !req_iov)) {
+    fprintf(stderr, "Invalid request iovec count: %d\n", req_iovcnt);
+    return -1;
+  }
+  const size_t max_req_payload_size =
+      LIBHOTH_MAILBOX_SIZE - sizeof(struct hoth_host_request);
+  size_t req_payload_size = libhoth_iov_length(req_iov, req_iovcnt);
+  if (req_payload_size > max_req_payload_size) {
     fprintf(stderr, "req_payload_size too large: %d > %d\n",
-            (int)req_payload_size, (int)sizeof(req.payload_buf));
+            (int)req_payload_size, (int)max_req_payload_size);
     return -1;
   }
-  if (req_payload) {
-    memcpy(req.payload_buf, req_payload, req_payload_size);
+
+  // The header is the only part of the request that is built here; the
+  // payload pieces are handed to the transport where they are.
+  struct hoth_host_request req_hdr;
+  struct iovec iov[LIBHOTH_IOV_MAX];
+  iov[0] = (struct iovec){.iov_base = &req_hdr, .iov_len = sizeof(req_hdr)};
+  for (int i = 0; i < req_iovcnt; ++i) {
+    iov[i + 1] = req_iov[i];
   }
-  int status = populate_ec_request_header(command, version, req.payload_buf,
-                                          req_payload_size, &req.hdr);
+  int status = populate_ec_request_header(command, version, req_iov,
+                                          req_iovcnt, &req_hdr);
   if (status != 0) {
     fprintf(stderr, "populate_ec_request_header() failed: %d\n", status);
     return -1;
   }
-  status = libhoth_send_request(dev, &req, sizeof(req.hdr) + req_payload_size);
+  status = libhoth_send_requestv(dev, iov, req_iovcnt + 1);
   if (status != LIBHOTH_OK) {
     fprintf(stderr, "libhoth_send_request() failed: %d\n", status);
     return -1;
   }
-  struct {
-    struct hoth_host_response hdr;
-    uint8_t payload_buf[LIBHOTH_MAILBOX_SIZE - sizeof(struct hoth_host_response)];
-  } resp;
+  return 0;
+}
+
+// Receives and validates the response to the command sent on `op->dev`.
+// Returns LIBHOTH_ERR_TIMEOUT if the transport reports that the response isn't
+// ready within `timeout_ms`. Otherwise returns the
+// same value libhoth_hostcmd_exec() would. If `exact_size` is set, the
+// response payload must be exactly `op->resp_buf_size` bytes long.
+static int hostcmd_receive(struct libhoth_hostcmd_op* op, bool exact_size,
+                           int timeout_ms) {
+  // The response payload is received directly into `resp_buf`. Anything that
+  // doesn't fit (error details or an unexpectedly large response) lands in
+  // `spill` so it can still be checksummed and reported.
+  size_t direct_size = 0;
+  if (op->resp_buf) {
+    direct_size = MIN(op->resp_buf_size, sizeof(op->spill));
+  }
+  int resp_iovcnt = 0;
+  struct iovec resp_iov[3];
+  resp_iov[resp_iovcnt++] = (struct iovec){.iov_base = &op->resp_hdr,
+                                           .iov_len = sizeof(op->resp_hdr)};
+  if (direct_size > 0) {
+    resp_iov[resp_iovcnt++] =
+        (struct iovec){.iov_base = op->resp_buf, .iov_len = direct_size};
+  }
+  if (direct_size < sizeof(op->spill)) {
+    resp_iov[resp_iovcnt++] = (struct iovec){
+        .iov_base = op->spill, .iov_len = sizeof(op->spill) - direct_size};
+  }
   size_t resp_size;
-  status = libhoth_receive_response(dev, &resp, sizeof(resp), &resp_size,
-                                   HOTH_CMD_TIMEOUT_MS_DEFAULT);
+  int status = libhoth_receive_responsev(op->dev, resp_iov, resp_iovcnt,
+                                         &resp_size, timeout_ms);
+  if (status == LIBHOTH_ERR_TIMEOUT) {
+    return LIBHOTH_ERR_TIMEOUT;
+  }
   if (status != LIBHOTH_OK) {
     fprintf(stderr, "libhoth_receive_response() failed: %d\n", status);
     return -1;
   }
-  status = validate_ec_response_header(&resp.hdr, resp.payload_buf, resp_size);
+  if (resp_size < sizeof(op->resp_hdr)) {
+    fprintf(stderr, "EC response too short: %zu\n", resp_size);
+    return -1;
+  }
+  size_t resp_payload_size = resp_size - sizeof(struct hoth_host_response);
+  status = validate_ec_response_header(&op->resp_hdr, &resp_iov[1],
+                                       resp_iovcnt - 1, resp_payload_size);
   if (status != 0) {
     fprintf(stderr, "EC response header invalid: %d\n", status);
     return -1;
   }
-  if (resp.hdr.result != HOTH_RES_SUCCESS) {
-    fprintf(stderr, "EC response contained error: %d", resp.hdr.result);
-    if (resp.hdr.data_len >= 4) {
+  if (op->resp_hdr.result != HOTH_RES_SUCCESS) {
+    fprintf(stderr, "EC response contained error: %d", op->resp_hdr.result);
+    if (op->resp_hdr.data_len >= 4) {
       uint32_t error_code;
-      memcpy(&error_code, resp.payload_buf, sizeof(error_code));
+      libhoth_iov_gather(&error_code, sizeof(error_code), &resp_iov[1],
+                         resp_iovcnt - 1);
       fprintf(stderr, " (extended: 0x%08x)\n", error_code);
     } else {
       fprintf(stderr, "\n");
     }
-    return HTOOL_ERROR_HOST_COMMAND_START + resp.hdr.result;
+    return HTOOL_ERROR_HOST_COMMAND_START + op->resp_hdr.result;
   }
 
-  size_t resp_payload_size = resp_size - sizeof(struct hoth_host_response);
-  if (out_resp_size) {
-    if (resp_payload_size > resp_buf_size) {
+  if (!exact_size) {
+    if (resp_payload_size > op->resp_buf_size) {
       fprintf(
           stderr,
           "Response payload too large to fit in supplied buffer: %zu > %zu\n",
-          resp_payload_size, resp_buf_size);
+          resp_payload_size, op->resp_buf_size);
       return -1;
     }
   } else {
-    if (resp_payload_size != resp_buf_size) {
+    if (resp_payload_size != op->resp_buf_size) {
       fprintf(stderr,
               "Unexpected response payload size: got %zu expected %zu\n",
-              resp_payload_size, resp_buf_size);
+              resp_payload_size, op->resp_buf_size);
       return -1;
     }
   }
-  if (resp_buf) {
-    memcpy(resp_buf, resp.payload_buf, resp_payload_size);
+  op->resp_size = resp_payload_size;
+  return 0;
+}
+
+int libhoth_hostcmd_execv(struct libhoth_device* dev, uint16_t command,
+                          uint8_t version, const struct iovec* req_iov,
+                          int req_iovcnt, void* resp_buf, size_t resp_buf_size,
+                          size_t* out_resp_size) {
+  int status = hostcmd_send(dev, command, version, req_iov, req_iovcnt);
+  if (status != 0) {
+    return status;
+  }
+
+  struct libhoth_hostcmd_op op = {
+      .dev = dev,
+      .resp_buf = resp_buf,
+      .resp_buf_size = resp_buf_size,
+  };
+  status = hostcmd_receive(&op, /*exact_size=*/out_resp_size == NULL,
+                           HOTH_CMD_TIMEOUT_MS_DEFAULT);
+  if (status == LIBHOTH_ERR_TIMEOUT) {
+    fprintf(stderr, "libhoth_receive_response() failed: %d\n", status);
+    return -1;
+  }
+  if (status != 0) {
+    return status;
   }
   if (out_resp_size) {
-    *out_resp_size = resp_payload_size;
+    *out_resp_size = op.resp_size;
+  }
+  return 0;
+}
+
+int libhoth_hostcmd_submit(struct libhoth_device* dev,
+                           struct libhoth_hostcmd_op* op, uint16_t command,
+                           uint8_t version, const void* req_payload,
+                           size_t req_payload_size) {
+  const struct iovec req_iov = {
+      .iov_base = (void*)req_payload,
+      .iov_len = req_payload_size,
+  };
+  return libhoth_hostcmd_submitv(dev, op, command, version, &req_iov, 1);
+}
+
+int libhoth_hostcmd_submitv(struct libhoth_device* dev,
+                            struct libhoth_hostcmd_op* op, uint16_t command,
+                            uint8_t version, const struct iovec* req_iov,
+                            int req_iovcnt) {
+  if (op == NULL || op->in_flight) {
+    fprintf(stderr, "Host command op is NULL or already in flight\n");
+    return -1;
+  }
+  op->dev = dev;
+  op->resp_size = 0;
+  op->status = hostcmd_send(dev, command, version, req_iov, req_iovcnt);
+  if (op->status != 0) {
+    return op->status;
   }
+  op->in_flight = true;
   return 0;
 }
+
+bool libhoth_hostcmd_poll(struct libhoth_hostcmd_op* op, int timeout_ms) {
+  if (op == NULL || !op->in_flight) {
+    return true;
+  }
+  int status = hostcmd_receive(op, /*exact_size=*/false, timeout_ms);
+  if (status == LIBHOTH_ERR_TIMEOUT) {
+    return false;
+  }
+  op->in_flight = false;
+  op->status = status;
+  if (op->complete) {
+    op->complete(op, status);
+  }
+  return true;
+}
+
+static uint64_t monotonic_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Responses on a device arrive in submission order, so an op can only be
+// polled once every op before it on the same device has completed.
+static bool device_has_pending_op(struct libhoth_hostcmd_op* const* ops,
+                                  size_t index) {
+  for (size_t i = 0; i < index; ++i) {
+    if (ops[i] != NULL && ops[i]->in_flight &&
+        ops[i]->dev == ops[index]->dev) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int libhoth_poll(struct libhoth_hostcmd_op* const* ops, size_t num_ops,
+                 int timeout_ms) {
+  const uint64_t start_us = monotonic_us();
+  while (true) {
+    int completed = 0;
+    size_t in_flight = 0;
+    for (size_t i = 0; i < num_ops; ++i) {
+      if (ops[i] == NULL || !ops[i]->in_flight ||
+          device_has_pending_op(ops, i)) {
+        continue;
+      }
+      if (libhoth_hostcmd_poll(ops[i], 0)) {
+        completed++;
+      } else {
+        in_flight++;
+      }
+    }
+    if (completed > 0 || in_flight == 0) {
+      return completed;
+    }
+    if (timeout_ms >= 0 &&
+        monotonic_us() - start_us >= (uint64_t)timeout_ms * 1000) {
+      return 0;
+    }
+    usleep(LIBHOTH_POLL_INTERVAL_US);
+  }
+}
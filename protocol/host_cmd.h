@@ -15,8 +15,10 @@
 #ifndef _LIBHOTH_PROTOCOL_HOST_CMD_H_
 #define _LIBHOTH_PROTOCOL_HOST_CMD_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <sys/uio.h>
 
 #include "transports/libhoth_device.h"
 
@@ -106,6 +108,85 @@ int libhoth_hostcmd_exec(struct libhoth_device* dev, uint16_t command,
                          size_t req_payload_size, void* resp_buf,
                          size_t resp_buf_size, size_t* out_resp_size);
 
+// Same as libhoth_hostcmd_exec(), but the request payload is the
+// concatenation of the `req_iovcnt` buffers in `req_iov` (at most
+// LIBHOTH_IOV_MAX - 1), and the response payload is received directly into
+// `resp_buf`. The checksum is computed across the pieces in place, so callers
+// can pass a protocol header and a slice of a larger image without first
+// copying them into a staging buffer.
+int libhoth_hostcmd_execv(struct libhoth_device* dev, uint16_t command,
+                          uint8_t version, const struct iovec* req_iov,
+                          int req_iovcnt, void* resp_buf, size_t resp_buf_size,
+                          size_t* out_resp_size);
+
+// Interval between rounds of transport polling in libhoth_poll().
+#define LIBHOTH_POLL_INTERVAL_US 1000
+
+struct libhoth_hostcmd_op;
+
+// Invoked from libhoth_hostcmd_poll() (or libhoth_poll()) once the command
+// completes. `status` has the same meaning as the return value of
+// libhoth_hostcmd_exec().
+typedef void (*libhoth_hostcmd_complete_fn)(struct libhoth_hostcmd_op* op,
+                                            int status);
+
+// State of one asynchronous host command. The caller owns the storage and
+// must keep it (and `resp_buf`) alive until the command completes. Only one
+// command may be in flight per device at a time, unless the transport queues
+// requests (see `fifo_pipeline_depth` in libhoth_usb.h); such commands
+// complete in submission order and must be polled in that order.
+struct libhoth_hostcmd_op {
+  // Set by the caller before libhoth_hostcmd_submit().
+  void* resp_buf;
+  size_t resp_buf_size;
+  libhoth_hostcmd_complete_fn complete;  // optional
+  void* user_ctx;
+
+  // Valid once the command has completed.
+  size_t resp_size;
+  int status;
+
+  // Private to host_cmd.c.
+  struct libhoth_device* dev;
+  bool in_flight;
+  struct hoth_host_response resp_hdr;
+  uint8_t spill[LIBHOTH_MAILBOX_SIZE - sizeof(struct hoth_host_response)];
+};
+
+// Sends a host command without waiting for the response. Returns 0 if the
+// request was handed to the transport, in which case `op` is in flight until
+// libhoth_hostcmd_poll() reports completion.
+int libhoth_hostcmd_submit(struct libhoth_device* dev,
+                           struct libhoth_hostcmd_op* op, uint16_t command,
+                           uint8_t version, const void* req_payload,
+                           size_t req_payload_size);
+
+// Same as libhoth_hostcmd_submit(), but the request payload is gathered from
+// `req_iov` as in libhoth_hostcmd_execv(). The buffers are only read during
+// the call and may be reused as soon as it returns.
+int libhoth_hostcmd_submitv(struct libhoth_device* dev,
+                            struct libhoth_hostcmd_op* op, uint16_t command,
+                            uint8_t version, const struct iovec* req_iov,
+                            int req_iovcnt);
+
+// Checks whether the response to `op` has arrived, waiting at most
+// `timeout_ms` (0 means don't wait). Returns true once the command has
+// completed, after the completion callback has run; `op->status` then holds
+// the result. Relies on the transport returning LIBHOTH_ERR_TIMEOUT from
+// receive() while the response is pending, as the USB FIFO, broker and mux
+// transports do for a zero timeout. If a wait with `timeout_ms` > 0 times out,
+// the transport may give up on the request (pipelined USB FIFO does), so
+// treat that as a failure rather than polling the op again.
+bool libhoth_hostcmd_poll(struct libhoth_hostcmd_op* op, int timeout_ms);
+
+// Polls every in-flight op in `ops` (NULL entries and completed ops are
+// skipped, as are ops queued behind a pending op on the same device) until at
+// least one completes or `timeout_ms` elapses. A negative timeout waits
+// indefinitely. Returns the number of ops that completed during this call,
+// which is 0 on timeout or if nothing was in flight.
+int libhoth_poll(struct libhoth_hostcmd_op* const* ops, size_t num_ops,
+                 int timeout_ms);
+
 uint8_t libhoth_calculate_checksum(const void* header, size_t header_size,
                                    const void* data, size_t data_size);
 
@@ -17,6 +17,10 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <cstring>
+#include <vector>
+
 #include "test/libhoth_device_mock.h"
 
 #include "protocol/host_cmd.h"
@@ -63,3 +67,154 @@ TEST_F(LibHothTest, response_failure_extended) {
     libhoth_hostcmd_exec(&hoth_dev_, kCmd, 0, nullptr, 0,  resp_buf, sizeof(resp_buf), &out_resp_size),
     HTOOL_ERROR_HOST_COMMAND_START + 2);
 }
+
+TEST_F(LibHothTest, execv_gathers_request_pieces) {
+  std::vector<uint8_t> sent;
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .WillOnce([&](struct libhoth_device*, const void* req, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(req);
+        sent.assign(p, p + size);
+        return LIBHOTH_OK;
+      });
+  const uint32_t expected_resp = 0x12345678;
+  EXPECT_CALL(mock_, receive)
+      .WillOnce(DoAll(CopyResp(&expected_resp, sizeof(expected_resp)),
+                      Return(LIBHOTH_OK)));
+
+  const uint8_t hdr[] = {0x01, 0x02, 0x03};
+  const uint8_t body[] = {0xa0, 0xa1, 0xa2, 0xa3, 0xa4};
+  const struct iovec req_iov[] = {
+      {.iov_base = const_cast<uint8_t*>(hdr), .iov_len = sizeof(hdr)},
+      {.iov_base = nullptr, .iov_len = 0},
+      {.iov_base = const_cast<uint8_t*>(body), .iov_len = sizeof(body)},
+  };
+  uint32_t resp = 0;
+  size_t out_resp_size = 0;
+  EXPECT_EQ(libhoth_hostcmd_execv(&hoth_dev_, kCmd, 0, req_iov, 3, &resp,
+                                  sizeof(resp), &out_resp_size),
+            0);
+  EXPECT_EQ(resp, expected_resp);
+  EXPECT_EQ(out_resp_size, sizeof(resp));
+
+  ASSERT_EQ(sent.size(),
+            sizeof(struct hoth_host_request) + sizeof(hdr) + sizeof(body));
+  struct hoth_host_request req_hdr;
+  std::memcpy(&req_hdr, sent.data(), sizeof(req_hdr));
+  EXPECT_EQ(req_hdr.data_len, sizeof(hdr) + sizeof(body));
+  EXPECT_EQ(libhoth_calculate_checksum(sent.data(), sent.size(), nullptr, 0),
+            0);
+  const uint8_t* payload = sent.data() + sizeof(req_hdr);
+  EXPECT_EQ(std::memcmp(payload, hdr, sizeof(hdr)), 0);
+  EXPECT_EQ(std::memcmp(payload + sizeof(hdr), body, sizeof(body)), 0);
+}
+
+TEST_F(LibHothTest, execv_rejects_oversized_response) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .WillOnce(Return(LIBHOTH_OK));
+  const uint8_t big_resp[16] = {};
+  EXPECT_CALL(mock_, receive)
+      .WillOnce(
+          DoAll(CopyResp(big_resp, sizeof(big_resp)), Return(LIBHOTH_OK)));
+
+  uint8_t resp[4];
+  size_t out_resp_size;
+  EXPECT_EQ(libhoth_hostcmd_execv(&hoth_dev_, kCmd, 0, nullptr, 0, resp,
+                                  sizeof(resp), &out_resp_size),
+            -1);
+}
+
+TEST_F(LibHothTest, submit_poll_completes_after_pending) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .WillOnce(Return(LIBHOTH_OK));
+  const uint32_t expected_resp = 0xcafef00d;
+  EXPECT_CALL(mock_, receive(_, _, _, _, 0))
+      .WillOnce(Return(LIBHOTH_ERR_TIMEOUT))
+      .WillOnce(DoAll(CopyResp(&expected_resp, sizeof(expected_resp)),
+                      Return(LIBHOTH_OK)));
+
+  uint32_t resp = 0;
+  int callback_status = -1;
+  struct libhoth_hostcmd_op op = {};
+  op.resp_buf = &resp;
+  op.resp_buf_size = sizeof(resp);
+  op.user_ctx = &callback_status;
+  op.complete = [](struct libhoth_hostcmd_op* op, int status) {
+    *static_cast<int*>(op->user_ctx) = status;
+  };
+  ASSERT_EQ(libhoth_hostcmd_submit(&hoth_dev_, &op, kCmd, 0, nullptr, 0), 0);
+  EXPECT_FALSE(libhoth_hostcmd_poll(&op, 0));
+  EXPECT_EQ(callback_status, -1);
+
+  struct libhoth_hostcmd_op* ops[] = {&op, nullptr};
+  EXPECT_EQ(libhoth_poll(ops, 2, 0), 1);
+  EXPECT_EQ(callback_status, 0);
+  EXPECT_EQ(op.status, 0);
+  EXPECT_EQ(op.resp_size, sizeof(resp));
+  EXPECT_EQ(resp, expected_resp);
+
+  // Nothing left in flight.
+  EXPECT_EQ(libhoth_poll(ops, 2, -1), 0);
+}
+
+TEST_F(LibHothTest, submit_poll_reports_error) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .WillOnce(Return(LIBHOTH_OK));
+  EXPECT_CALL(mock_, receive)
+      .WillOnce(DoAll(CopyRespRaw(&ERROR_RESPONSE_LEGACY,
+                                  sizeof(ERROR_RESPONSE_LEGACY)),
+                      Return(LIBHOTH_OK)));
+
+  struct libhoth_hostcmd_op op = {};
+  ASSERT_EQ(libhoth_hostcmd_submit(&hoth_dev_, &op, kCmd, 0, nullptr, 0), 0);
+  EXPECT_EQ(libhoth_hostcmd_submit(&hoth_dev_, &op, kCmd, 0, nullptr, 0), -1);
+  EXPECT_TRUE(libhoth_hostcmd_poll(&op, 0));
+  EXPECT_EQ(op.status, HTOOL_ERROR_HOST_COMMAND_START + 2);
+}
+
+TEST_F(LibHothTest, poll_completes_queued_ops_in_order) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .Times(2)
+      .WillRepeatedly(Return(LIBHOTH_OK));
+  const uint32_t first_resp = 1;
+  const uint32_t second_resp = 2;
+  // The second op must not be polled while the first is still pending, so
+  // only one receive() happens in the first round.
+  EXPECT_CALL(mock_, receive)
+      .WillOnce(Return(LIBHOTH_ERR_TIMEOUT))
+      .WillOnce(DoAll(CopyResp(&first_resp, sizeof(first_resp)),
+                      Return(LIBHOTH_OK)))
+      .WillOnce(DoAll(CopyResp(&second_resp, sizeof(second_resp)),
+                      Return(LIBHOTH_OK)));
+
+  uint32_t resp[2] = {};
+  struct libhoth_hostcmd_op ops[2] = {};
+  struct libhoth_hostcmd_op* op_ptrs[2] = {&ops[0], &ops[1]};
+  for (int i = 0; i < 2; i++) {
+    ops[i].resp_buf = &resp[i];
+    ops[i].resp_buf_size = sizeof(resp[i]);
+    ASSERT_EQ(libhoth_hostcmd_submit(&hoth_dev_, &ops[i], kCmd, 0, nullptr, 0),
+              0);
+  }
+  EXPECT_EQ(libhoth_poll(op_ptrs, 2, 0), 0);
+  EXPECT_EQ(libhoth_poll(op_ptrs, 2, 0), 2);
+  EXPECT_EQ(resp[0], first_resp);
+  EXPECT_EQ(resp[1], second_resp);
+}
+
+TEST_F(LibHothTest, poll_times_out_when_device_never_answers) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .WillOnce(Return(LIBHOTH_OK));
+  // Every receive is a poll, so the wait is bounded by libhoth_poll() itself.
+  EXPECT_CALL(mock_, receive(_, _, _, _, 0))
+      .WillRepeatedly(Return(LIBHOTH_ERR_TIMEOUT));
+
+  struct libhoth_hostcmd_op op = {};
+  ASSERT_EQ(libhoth_hostcmd_submit(&hoth_dev_, &op, kCmd, 0, nullptr, 0), 0);
+  struct libhoth_hostcmd_op* ops[] = {&op};
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(libhoth_poll(ops, 1, 10), 0);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(10));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(100));
+  EXPECT_TRUE(op.in_flight);
+}
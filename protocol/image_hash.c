@@ -0,0 +1,175 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "image_hash.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "payload_info.h"
+
+struct image_hasher {
+  enum hash_type type;
+  union {
+    struct libhoth_sha256_ctx sha256;
+    struct libhoth_sha512_ctx sha512;
+  };
+};
+
+static int image_hasher_init(struct image_hasher* hasher,
+                             enum hash_type type) {
+  hasher->type = type;
+  switch (type) {
+    case HASH_SHA2_256:
+      libhoth_sha256_init(&hasher->sha256);
+      return LIBHOTH_SHA256_DIGEST_SIZE;
+    case HASH_SHA2_512:
+      libhoth_sha512_init(&hasher->sha512);
+      return LIBHOTH_SHA512_DIGEST_SIZE;
+    default:
+      fprintf(stderr, "Unsupported image hash type: %d\n", type);
+      return -1;
+  }
+}
+
+static void image_hasher_update(struct image_hasher* hasher,
+                                const uint8_t* data, size_t len) {
+  if (hasher->type == HASH_SHA2_256) {
+    libhoth_sha256_update(&hasher->sha256, data, len);
+  } else {
+    libhoth_sha512_update(&hasher->sha512, data, len);
+  }
+}
+
+static void image_hasher_final(struct image_hasher* hasher,
+                               uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE]) {
+  if (hasher->type == HASH_SHA2_256) {
+    libhoth_sha256_final(&hasher->sha256, hash);
+  } else {
+    libhoth_sha512_final(&hasher->sha512, hash);
+  }
+}
+
+// Finds the descriptor of `image` and checks that its regions and hash are
+// within it, and its regions within `image`.
+static const struct image_descriptor* image_hash_descriptor(
+    const uint8_t* image, size_t len, size_t* image_offset) {
+  const struct image_descriptor* descr =
+      libhoth_find_image_descriptor(image, len);
+  if (descr == NULL) {
+    fprintf(stderr, "No image descriptor found\n");
+    return NULL;
+  }
+  const size_t descr_offset = (const uint8_t*)descr - image;
+  if (descr->descriptor_offset > descr_offset) {
+    fprintf(stderr, "Image descriptor offset 0x%x is past its location\n",
+            descr->descriptor_offset);
+    return NULL;
+  }
+  const size_t hash_len = descr->hash_type == HASH_SHA2_512
+                              ? sizeof(struct hash_sha512)
+                              : sizeof(struct hash_sha256);
+  if (sizeof(*descr) + descr->region_count * sizeof(struct image_region) +
+          hash_len >
+      descr->descriptor_area_size) {
+    fprintf(stderr, "Image regions overflow the descriptor area\n");
+    return NULL;
+  }
+  *image_offset = descr_offset - descr->descriptor_offset;
+  for (size_t i = 0; i < descr->region_count; i++) {
+    const struct image_region* region = &descr->image_regions[i];
+    if (*image_offset + (uint64_t)region->region_offset + region->region_size >
+        len) {
+      fprintf(stderr, "Image region %zu is past the end of the image\n", i);
+      return NULL;
+    }
+  }
+  return descr;
+}
+
+static int image_hash(const uint8_t* image,
+                      const struct image_descriptor* descr,
+                      size_t image_offset,
+                      uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE]) {
+  struct image_hasher hasher;
+  const int hash_size = image_hasher_init(&hasher, descr->hash_type);
+  if (hash_size < 0) {
+    return -1;
+  }
+  // Relative to the start of the image.
+  const uint64_t descr_start = descr->descriptor_offset;
+  const uint64_t descr_end = descr_start + descr->descriptor_area_size;
+  const uint8_t* base = image + image_offset;
+  for (size_t i = 0; i < descr->region_count; i++) {
+    const struct image_region* region = &descr->image_regions[i];
+    if (!(region->region_attributes & IMAGE_REGION_STATIC)) {
+      continue;
+    }
+    const uint64_t start = region->region_offset;
+    const uint64_t end = start + region->region_size;
+    // The part before the descriptor area, and the part after it.
+    if (start < descr_start) {
+      image_hasher_update(&hasher, &base[start],
+                          (end < descr_start ? end : descr_start) - start);
+    }
+    if (end > descr_end) {
+      const uint64_t after = start > descr_end ? start : descr_end;
+      image_hasher_update(&hasher, &base[after], end - after);
+    }
+  }
+  image_hasher_final(&hasher, hash);
+  return hash_size;
+}
+
+int libhoth_image_compute_hash(const uint8_t* image, size_t len,
+                               uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE]) {
+  size_t image_offset;
+  const struct image_descriptor* descr =
+      image_hash_descriptor(image, len, &image_offset);
+  if (descr == NULL) {
+    return -1;
+  }
+  return image_hash(image, descr, image_offset, hash);
+}
+
+int libhoth_image_verify_hash(const uint8_t* image, size_t len) {
+  size_t image_offset;
+  const struct image_descriptor* descr =
+      image_hash_descriptor(image, len, &image_offset);
+  if (descr == NULL) {
+    return -1;
+  }
+  uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE];
+  const int hash_size = image_hash(image, descr, image_offset, hash);
+  if (hash_size < 0) {
+    return -1;
+  }
+
+  // The hash follows the image regions.
+  const uint8_t* expected =
+      (const uint8_t*)&descr->image_regions[descr->region_count];
+  uint32_t hash_magic;
+  memcpy(&hash_magic, expected, sizeof(hash_magic));
+  if (hash_magic != TITAN_IMAGE_DESCRIPTOR_HASH_MAGIC) {
+    fprintf(stderr, "Image descriptor has no hash\n");
+    return -1;
+  }
+  if (memcmp(hash, expected + sizeof(hash_magic), hash_size) != 0) {
+    fprintf(stderr, "Image hash doesn't match its descriptor\n");
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef LIBHOTH_PROTOCOL_IMAGE_HASH_H_
+#define LIBHOTH_PROTOCOL_IMAGE_HASH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "protocol/sha2.h"
+
+#define LIBHOTH_IMAGE_HASH_MAX_SIZE LIBHOTH_SHA512_DIGEST_SIZE
+
+// Hashes the static regions (IMAGE_REGION_STATIC) of `image` in the order of
+// its image descriptor, skipping the descriptor area, with the hash the
+// descriptor names (SHA-256 or SHA-512). Returns the size of the hash written
+// to `hash`, or -1 if the image can't be hashed.
+int libhoth_image_compute_hash(const uint8_t* image, size_t len,
+                               uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE]);
+
+// Checks the hash of `image` against the one in its image descriptor. Returns
+// 0 if they match; otherwise reports why on stderr and returns -1.
+int libhoth_image_verify_hash(const uint8_t* image, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBHOTH_PROTOCOL_IMAGE_HASH_H_
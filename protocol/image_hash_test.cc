@@ -0,0 +1,119 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "image_hash.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "payload_info.h"
+
+namespace {
+
+constexpr char kTestData[] = "protocol/test/test_payload.bin";
+constexpr char kTestHash[] =
+    "50316da1d3b006ff87989aa8bcd48a33ecc4bfe2114ded138ee594f6097d58b3";
+constexpr char kTestSha512[] =
+    "671f0413826000cfb4caab8a4d8f6a7bace30b337868404e027dfc2ada50fb48"
+    "2969b18b4697b0c3fa6be9c99790c95e37b89a9dc537fee1206e0e933f2cfa4a";
+
+// Region offsets in the test payload.
+constexpr size_t kRuntimeOffset = 0x1000;
+constexpr size_t kDescriptorOffset = 0x20000;
+constexpr size_t kWriteableOffset = 0x60000;
+
+std::vector<uint8_t> ReadTestPayload() {
+  std::ifstream file(kTestData, std::ios::binary);
+  EXPECT_TRUE(file.good());
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+std::string Hex(const uint8_t* data, size_t len) {
+  std::stringstream stream;
+  stream << std::hex;
+  for (size_t i = 0; i < len; i++) {
+    stream << std::setw(2) << std::setfill('0') << (int)data[i];
+  }
+  return stream.str();
+}
+
+TEST(ImageHashTest, sha256) {
+  std::vector<uint8_t> image = ReadTestPayload();
+  ASSERT_FALSE(image.empty());
+
+  uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE];
+  ASSERT_EQ(libhoth_image_compute_hash(image.data(), image.size(), hash),
+            LIBHOTH_SHA256_DIGEST_SIZE);
+  EXPECT_EQ(Hex(hash, LIBHOTH_SHA256_DIGEST_SIZE), kTestHash);
+  EXPECT_EQ(libhoth_image_verify_hash(image.data(), image.size()), 0);
+
+  // Neither the descriptor area nor regions that aren't static are hashed.
+  image[kDescriptorOffset + 0x10000] ^= 1;
+  image[kWriteableOffset] ^= 1;
+  EXPECT_EQ(libhoth_image_verify_hash(image.data(), image.size()), 0);
+
+  image[kRuntimeOffset + 100] ^= 1;
+  EXPECT_NE(libhoth_image_verify_hash(image.data(), image.size()), 0);
+}
+
+TEST(ImageHashTest, sha512) {
+  std::vector<uint8_t> image = ReadTestPayload();
+  ASSERT_FALSE(image.empty());
+  auto* descr = reinterpret_cast<struct image_descriptor*>(
+      &image[kDescriptorOffset]);
+  descr->hash_type = HASH_SHA2_512;
+
+  uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE];
+  ASSERT_EQ(libhoth_image_compute_hash(image.data(), image.size(), hash),
+            LIBHOTH_SHA512_DIGEST_SIZE);
+  EXPECT_EQ(Hex(hash, LIBHOTH_SHA512_DIGEST_SIZE), kTestSha512);
+
+  // The SHA-256 hash that's in the descriptor doesn't match.
+  EXPECT_NE(libhoth_image_verify_hash(image.data(), image.size()), 0);
+  struct hash_sha512 sha512 = {.hash_magic = TITAN_IMAGE_DESCRIPTOR_HASH_MAGIC};
+  std::memcpy(sha512.hash, hash, sizeof(sha512.hash));
+  std::memcpy(&descr->image_regions[descr->region_count], &sha512,
+              sizeof(sha512));
+  EXPECT_EQ(libhoth_image_verify_hash(image.data(), image.size()), 0);
+}
+
+TEST(ImageHashTest, bad_descriptor) {
+  std::vector<uint8_t> image = ReadTestPayload();
+  ASSERT_FALSE(image.empty());
+  auto* descr = reinterpret_cast<struct image_descriptor*>(
+      &image[kDescriptorOffset]);
+  uint8_t hash[LIBHOTH_IMAGE_HASH_MAX_SIZE];
+
+  // Regions past the end of the image.
+  EXPECT_EQ(libhoth_image_compute_hash(image.data(), image.size() - 1, hash),
+            -1);
+
+  descr->hash_type = HASH_SHA3_256;
+  EXPECT_EQ(libhoth_image_compute_hash(image.data(), image.size(), hash), -1);
+
+  descr->hash_type = HASH_SHA2_256;
+  descr->descriptor_magic ^= 1;
+  EXPECT_EQ(libhoth_image_compute_hash(image.data(), image.size(), hash), -1);
+}
+
+}  // namespace
@@ -167,22 +167,25 @@ enum key_rotation_err libhoth_key_rotation_update(struct libhoth_device* dev,
     return KEY_ROTATION_INITIATE_FAIL;
   }
   fprintf(stderr, "Writing the image to hoth.\n");
-  struct hoth_request_variable_length request;
+  struct hoth_request_key_rotation_record request;
   uint16_t offset = 0;
   const uint8_t* packet_data = image;
   while (size > 0) {
     size_t size_to_send = (size < KEY_ROTATION_RECORD_WRITE_MAX_SIZE
                                ? (uint16_t)(size)
                                : KEY_ROTATION_RECORD_WRITE_MAX_SIZE);
-    request.hdr.operation = KEY_ROTATION_RECORD_WRITE;
-    request.hdr.packet_offset = offset;
-    request.hdr.packet_size = size_to_send;
-    memcpy(request.data, packet_data, size_to_send);
+    request.operation = KEY_ROTATION_RECORD_WRITE;
+    request.packet_offset = offset;
+    request.packet_size = size_to_send;
+    request.reserved = 0;
+    const struct iovec req_iov[] = {
+        {.iov_base = &request, .iov_len = sizeof(request)},
+        {.iov_base = (void*)packet_data, .iov_len = size_to_send},
+    };
     size_t response_length;
-    int ret = libhoth_hostcmd_exec(
+    int ret = libhoth_hostcmd_execv(
         dev, HOTH_CMD_BOARD_SPECIFIC_BASE + HOTH_PRV_CMD_HAVEN_KEY_ROTATION_OP,
-        0, &request, sizeof(request.hdr) + request.hdr.packet_size, NULL, 0,
-        &response_length);
+        0, req_iov, 2, NULL, 0, &response_length);
     if (ret != 0) {
       fprintf(stderr, "Error code from hoth: %d\n", ret);
       return KEY_ROTATION_ERR;
@@ -43,7 +43,12 @@ bool libhoth_payload_info(const uint8_t* image, size_t len,
   if (descr == NULL) {
     return false;
   }
+  libhoth_image_descriptor_payload_info(descr, payload_info);
+  return true;
+}
 
+void libhoth_image_descriptor_payload_info(
+    const struct image_descriptor* descr, struct payload_info* payload_info) {
   memcpy(payload_info->image_name, descr->image_name,
          sizeof(payload_info->image_name));
   payload_info->image_name[sizeof(payload_info->image_name)-1] = 0;
@@ -63,6 +68,4 @@ bool libhoth_payload_info(const uint8_t* image, size_t len,
         (struct hash_sha256*)((uint8_t*)&descr->image_regions + region_size);
     memcpy(payload_info->image_hash, hash->hash, sizeof(hash->hash));
   }
-
-  return true;
 }
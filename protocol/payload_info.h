@@ -161,6 +161,11 @@ const struct image_descriptor* libhoth_find_image_descriptor(const uint8_t* imag
 bool libhoth_payload_info(const uint8_t* image, size_t len,
                           struct payload_info* payload_info);
 
+// Fills in `payload_info` from `descr`, which must be followed by its image
+// regions and, if it has a SHA-256 hash, the hash.
+void libhoth_image_descriptor_payload_info(
+    const struct image_descriptor* descr, struct payload_info* payload_info);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,52 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "payload_reader.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+ssize_t libhoth_payload_read_fd(void* ctx, void* buf, size_t len) {
+  const int fd = *(const int*)ctx;
+  while (true) {
+    ssize_t n = read(fd, buf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      perror("Failed to read image");
+    }
+    return n;
+  }
+}
+
+ssize_t libhoth_payload_read_full(const struct libhoth_payload_reader* reader,
+                                  void* buf, size_t len) {
+  uint8_t* buf_u8 = (uint8_t*)buf;
+  size_t total = 0;
+  while (total < len) {
+    ssize_t n = reader->read(reader->ctx, buf_u8 + total, len - total);
+    if (n < 0) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    total += n;
+  }
+  return total;
+}
@@ -0,0 +1,47 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LIBHOTH_PROTOCOL_PAYLOAD_READER_H_
+#define _LIBHOTH_PROTOCOL_PAYLOAD_READER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// A source of image bytes that is read front to back, such as a pipe.
+struct libhoth_payload_reader {
+  // Reads up to `len` bytes of the image into `buf`. Returns the number of
+  // bytes read, 0 at the end of the image, or -1 on error.
+  ssize_t (*read)(void* ctx, void* buf, size_t len);
+  void* ctx;
+};
+
+// A libhoth_payload_reader read function for file descriptors. `ctx` points
+// to the fd, as an int.
+ssize_t libhoth_payload_read_fd(void* ctx, void* buf, size_t len);
+
+// Reads from `reader` until `len` bytes are in `buf` or the image ends.
+// Returns the number of bytes read, or -1 on error.
+ssize_t libhoth_payload_read_full(const struct libhoth_payload_reader* reader,
+                                  void* buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _LIBHOTH_PROTOCOL_PAYLOAD_READER_H_
@@ -14,11 +14,19 @@
 
 #include "payload_update.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
+#include <unistd.h>
 
 #include "command_version.h"
+#include "erased.h"
 #include "host_cmd.h"
 #include "payload_info.h"
 #include "transports/libhoth_device.h"
@@ -80,59 +88,438 @@ static int libhoth_payload_update_finalize(
   return 0;
 }
 
-enum payload_update_err libhoth_payload_update(struct libhoth_device* dev,
-                                               uint8_t* image, size_t size) {
-  if (libhoth_find_image_descriptor(image, size) == NULL) {
-    return PAYLOAD_UPDATE_BAD_IMG;
+// Finds the next chunk of the image to send, starting at or after `*offset`.
+// If `staged` is NULL, the staging half is erased there: bytes that are 0xFF
+// are already in that state, so they're skipped at the start of a chunk and
+// trimmed off its end. Otherwise `staged` holds what the staging half
+// contains, and the same goes for bytes that match it; matching bytes between
+// ones that differ are sent along rather than splitting the chunk. Returns
+// false if there is nothing left to send.
+static bool payload_update_next_chunk(const uint8_t* image,
+                                      const uint8_t* staged, size_t size,
+                                      size_t* offset, size_t* chunk_size) {
+  const size_t max_chunk_size = LIBHOTH_MAILBOX_SIZE -
+                                sizeof(struct hoth_host_request) -
+                                sizeof(struct payload_update_packet);
+  if (staged == NULL) {
+    return libhoth_next_programmed_span(image, size, max_chunk_size, offset,
+                                        chunk_size);
+  }
+  while (*offset < size && image[*offset] == staged[*offset]) {
+    (*offset)++;
+  }
+  if (*offset == size) {
+    return false;
   }
+  size_t end = MIN(*offset + max_chunk_size, size);
+  while (image[end - 1] == staged[end - 1]) {
+    end--;
+  }
+  *chunk_size = end - *offset;
+  return true;
+}
 
-  fprintf(stderr, "Initiating payload update protocol with libhoth.\n");
-  if (send_payload_update_request_with_command(dev, PAYLOAD_UPDATE_INITIATE) !=
-      0) {
-    return PAYLOAD_UPDATE_INITIATE_FAIL;
+// A PAYLOAD_UPDATE_CONTINUE or PAYLOAD_UPDATE_READ packet that has been
+// submitted.
+struct payload_update_inflight {
+  struct libhoth_hostcmd_op op;
+  // Image offset just past the packet's data.
+  size_t end;
+};
+
+// Returns how many packets to keep in flight, or 0 if `options->window` is
+// too large.
+static size_t payload_update_window(
+    struct libhoth_device* dev,
+    const struct libhoth_payload_update_options* options) {
+  const size_t window = MAX(options->window, 1);
+  if (window > LIBHOTH_PAYLOAD_UPDATE_MAX_WINDOW) {
+    fprintf(stderr, "Payload update window %zu is larger than %d\n", window,
+            LIBHOTH_PAYLOAD_UPDATE_MAX_WINDOW);
+    return 0;
   }
+  // Any more would overwrite requests the transport hasn't answered yet.
+  return MIN(window, (size_t)libhoth_device_queue_depth(dev));
+}
 
-  const size_t max_chunk_size = LIBHOTH_MAILBOX_SIZE -
-                                sizeof(struct hoth_host_request) -
-                                sizeof(struct payload_update_packet);
+// Waits for `inflight` to complete. Returns its status.
+static int payload_update_wait(struct payload_update_inflight* inflight) {
+  if (!libhoth_hostcmd_poll(&inflight->op, HOTH_CMD_TIMEOUT_MS_DEFAULT)) {
+    fprintf(stderr, "Timed out waiting for payload update packet\n");
+    return -1;
+  }
+  return inflight->op.status;
+}
 
-  fprintf(stderr, "Flashing the image to hoth.\n");
-  for (size_t offset = 0; offset < size; ++offset) {
-    if (image[offset] == 0xFF) {
+static void payload_update_progress(
+    const struct libhoth_payload_update_options* options, size_t done,
+    size_t size) {
+  // Progress can't be shown for streams of unknown size.
+  if (options->progress != NULL && size > 0) {
+    options->progress->func(options->progress->param, done, size);
+  }
+}
+
+// On-disk record of how far a payload update got, so that it can be resumed
+// after an interruption.
+#define PAYLOAD_UPDATE_JOURNAL_MAGIC 0x5f4c4e524a55485f  // "_HUJRNL_"
+#define PAYLOAD_UPDATE_JOURNAL_VERSION 1
+
+struct payload_update_journal_record {
+  uint64_t magic;
+  uint32_t version;
+  // The half being written, from PAYLOAD_UPDATE_GET_STATUS.
+  uint8_t staging_half;
+  uint8_t reserved[3];
+  uint64_t image_size;
+  uint64_t image_hash;
+  // Every packet before this image offset has been acknowledged.
+  uint64_t acked;
+} __attribute__((packed));
+
+struct payload_update_journal {
+  const char* path;
+  struct payload_update_journal_record record;
+  // `record.acked` when the record was last saved.
+  uint64_t saved;
+};
+
+// FNV-1a; only used to tell whether a journal belongs to an image.
+static uint64_t payload_update_image_hash(const uint8_t* image, size_t size) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ image[i]) * 0x100000001b3;
+  }
+  return hash;
+}
+
+static bool payload_update_journal_load(
+    const char* path, struct payload_update_journal_record* record) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  ssize_t n = read(fd, record, sizeof(*record));
+  close(fd);
+  return n == sizeof(*record) &&
+         record->magic == PAYLOAD_UPDATE_JOURNAL_MAGIC &&
+         record->version == PAYLOAD_UPDATE_JOURNAL_VERSION;
+}
+
+// Replaces the journal atomically, so a crash never leaves a torn record.
+static int payload_update_journal_save(struct payload_update_journal* journal) {
+  char tmp_path[PATH_MAX];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", journal->path) >=
+      (int)sizeof(tmp_path)) {
+    fprintf(stderr, "Payload update journal path too long\n");
+    return -1;
+  }
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to open %s: %s\n", tmp_path, strerror(errno));
+    return -1;
+  }
+  bool ok = write(fd, &journal->record, sizeof(journal->record)) ==
+                sizeof(journal->record) &&
+            fsync(fd) == 0;
+  close(fd);
+  if (!ok || rename(tmp_path, journal->path) != 0) {
+    fprintf(stderr, "Failed to write payload update journal %s: %s\n",
+            journal->path, strerror(errno));
+    unlink(tmp_path);
+    return -1;
+  }
+  journal->saved = journal->record.acked;
+  return 0;
+}
+
+// Records that everything before `end` has been acknowledged, saving the
+// journal every LIBHOTH_PAYLOAD_UPDATE_JOURNAL_INTERVAL bytes.
+static void payload_update_journal_ack(struct payload_update_journal* journal,
+                                       size_t end) {
+  if (journal == NULL) {
+    return;
+  }
+  journal->record.acked = end;
+  if (end >= journal->saved + LIBHOTH_PAYLOAD_UPDATE_JOURNAL_INTERVAL) {
+    // Not fatal; the update just resumes from an earlier point.
+    payload_update_journal_save(journal);
+  }
+}
+
+// Sends the image bytes in [start, end), held in `data`, to the staging half.
+// `staged` holds what the staging half contains over that range, or is NULL
+// if it is erased; only what differs is sent. Progress is reported against
+// the full image `size`. Acknowledged packets are recorded in `journal`, if
+// there is one.
+static int payload_update_flash(
+    struct libhoth_device* dev, const uint8_t* data, const uint8_t* staged,
+    size_t start, size_t end, size_t size,
+    const struct libhoth_payload_update_options* options,
+    struct payload_update_journal* journal) {
+  const size_t window = payload_update_window(dev, options);
+  if (window == 0) {
+    return -1;
+  }
+
+  // Ring of submitted packets, oldest at `head`. They complete in the order
+  // they were submitted.
+  struct payload_update_inflight inflight[LIBHOTH_PAYLOAD_UPDATE_MAX_WINDOW];
+  size_t head = 0;
+  size_t num_inflight = 0;
+  int status = 0;
+
+  // Offset into `data`.
+  size_t offset = 0;
+  size_t chunk_size = 0;
+  bool more = payload_update_next_chunk(data, staged, end - start, &offset,
+                                        &chunk_size);
+  while (status == 0 && (more || num_inflight > 0)) {
+    if (more && num_inflight < window) {
+      struct payload_update_inflight* next =
+          &inflight[(head + num_inflight) % window];
+      struct payload_update_packet request = {
+          .offset = start + offset,
+          .len = chunk_size,
+          .type = PAYLOAD_UPDATE_CONTINUE,
+      };
+      const struct iovec req_iov[] = {
+          {.iov_base = &request, .iov_len = sizeof(request)},
+          {.iov_base = (void*)(data + offset), .iov_len = chunk_size},
+      };
+      memset(&next->op, 0, sizeof(next->op));
+      status = libhoth_hostcmd_submitv(
+          dev, &next->op,
+          HOTH_CMD_BOARD_SPECIFIC_BASE + HOTH_PRV_CMD_HOTH_PAYLOAD_UPDATE, 0,
+          req_iov, 2);
+      if (status != 0) {
+        break;
+      }
+      next->end = start + offset + chunk_size;
+      num_inflight++;
+
+      // Work out the next packet while this one is in flight.
+      offset += chunk_size;
+      more = payload_update_next_chunk(data, staged, end - start, &offset,
+                                       &chunk_size);
       continue;
     }
-    struct payload_update_packet request;
 
-    size_t chunk_size = max_chunk_size;
-    if (size - offset < chunk_size) {
-      chunk_size = size - offset;
+    // The window is full, or everything has been sent.
+    struct payload_update_inflight* oldest = &inflight[head];
+    status = payload_update_wait(oldest);
+    head = (head + 1) % window;
+    num_inflight--;
+    if (status == 0) {
+      payload_update_journal_ack(journal, oldest->end);
+      payload_update_progress(options, oldest->end, size);
     }
+  }
+
+  // Collect what's left after a failure, so no responses are left queued in
+  // the transport.
+  for (; num_inflight > 0; num_inflight--) {
+    payload_update_wait(&inflight[head]);
+    head = (head + 1) % window;
+  }
+
+  if (status != 0) {
+    fprintf(stderr, "Error code from hoth: %d\n", status);
+    return status;
+  }
+  return 0;
+}
 
-    while (chunk_size > 0 && image[offset + chunk_size - 1] == 0xFF) {
-      --chunk_size;
+// Checks the PAYLOAD_UPDATE_READ `read`, whose data is in `staged`, against
+// `data`. Both hold the range starting at image offset `start`.
+static int payload_update_check_read(const struct payload_update_inflight* read,
+                                     const uint8_t* data, const uint8_t* staged,
+                                     size_t start, bool* differs,
+                                     bool* needs_erase) {
+  const size_t len = read->op.resp_buf_size;
+  const size_t offset = read->end - len;
+  if (read->op.resp_size != len) {
+    fprintf(stderr, "Short read of staging half at 0x%zx: %zu of %zu\n",
+            offset, read->op.resp_size, len);
+    return -1;
+  }
+  const uint8_t* expected = data + (offset - start);
+  const uint8_t* actual = staged + (offset - start);
+  if (memcmp(actual, expected, len) != 0) {
+    *differs = true;
+    for (size_t i = 0; i < len; ++i) {
+      if ((actual[i] & expected[i]) != expected[i]) {
+        *needs_erase = true;
+        break;
+      }
     }
+  }
+  return 0;
+}
 
-    if (chunk_size == 0) {
+// Reads back [start, end) of the staging half into `staged`, keeping up to
+// `options->window` reads in flight, and compares it with `data`, which holds
+// the same range of the image. `*differs` is set if any byte differs, and
+// `*needs_erase` if some byte can't be reached by programming alone, i.e. it
+// needs a bit set that is clear in flash. Reading stops early in that case,
+// leaving the rest of `staged` unset.
+static int payload_update_compare(
+    struct libhoth_device* dev, const uint8_t* data, size_t start, size_t end,
+    const struct libhoth_payload_update_options* options, uint8_t* staged,
+    bool* differs, bool* needs_erase) {
+  const size_t window = payload_update_window(dev, options);
+  if (window == 0) {
+    return -1;
+  }
+  const size_t max_read_size =
+      LIBHOTH_MAILBOX_SIZE - sizeof(struct hoth_host_response);
+
+  // Ring of submitted reads, oldest at `head`, as in payload_update_flash().
+  struct payload_update_inflight inflight[LIBHOTH_PAYLOAD_UPDATE_MAX_WINDOW];
+  size_t head = 0;
+  size_t num_inflight = 0;
+  int status = 0;
+
+  *differs = false;
+  *needs_erase = false;
+  size_t offset = start;
+  while (status == 0 &&
+         ((offset < end && !*needs_erase) || num_inflight > 0)) {
+    if (offset < end && !*needs_erase && num_inflight < window) {
+      struct payload_update_inflight* next =
+          &inflight[(head + num_inflight) % window];
+      const size_t len = MIN(max_read_size, end - offset);
+      struct payload_update_packet request = {
+          .offset = offset,
+          .len = len,
+          .type = PAYLOAD_UPDATE_READ,
+      };
+      memset(&next->op, 0, sizeof(next->op));
+      next->op.resp_buf = staged + (offset - start);
+      next->op.resp_buf_size = len;
+      status = libhoth_hostcmd_submit(
+          dev, &next->op,
+          HOTH_CMD_BOARD_SPECIFIC_BASE + HOTH_PRV_CMD_HOTH_PAYLOAD_UPDATE, 0,
+          &request, sizeof(request));
+      if (status != 0) {
+        break;
+      }
+      next->end = offset + len;
+      num_inflight++;
+      offset += len;
       continue;
     }
 
-    request.offset = offset;
-    request.len = chunk_size;
-    request.type = PAYLOAD_UPDATE_CONTINUE;
+    struct payload_update_inflight* oldest = &inflight[head];
+    status = payload_update_wait(oldest);
+    head = (head + 1) % window;
+    num_inflight--;
+    if (status != 0) {
+      fprintf(stderr, "Error reading back staging half at 0x%zx: %d\n",
+              oldest->end - oldest->op.resp_buf_size, status);
+    } else {
+      status = payload_update_check_read(oldest, data, staged, start, differs,
+                                         needs_erase);
+    }
+  }
 
-    uint8_t buffer[sizeof(struct payload_update_packet) + LIBHOTH_MAILBOX_SIZE];
-    memcpy(buffer, &request, sizeof(request));
-    memcpy(buffer + sizeof(request), image + offset, chunk_size);
+  // Collect what's left after a failure.
+  for (; num_inflight > 0; num_inflight--) {
+    payload_update_wait(&inflight[head]);
+    head = (head + 1) % window;
+  }
+  return status;
+}
+
+static int payload_update_erase(struct libhoth_device* dev, size_t offset,
+                                size_t len) {
+  struct payload_update_packet request = {
+      .offset = offset,
+      .len = len,
+      .type = PAYLOAD_UPDATE_ERASE,
+  };
+  int status = libhoth_hostcmd_exec(
+      dev, HOTH_CMD_BOARD_SPECIFIC_BASE + HOTH_PRV_CMD_HOTH_PAYLOAD_UPDATE, 0,
+      &request, sizeof(request), NULL, 0, NULL);
+  if (status != 0) {
+    fprintf(stderr, "Error erasing staging half at 0x%zx: %d\n", offset,
+            status);
+  }
+  return status;
+}
 
-    int ret = libhoth_hostcmd_exec(
-        dev, HOTH_CMD_BOARD_SPECIFIC_BASE + HOTH_PRV_CMD_HOTH_PAYLOAD_UPDATE, 0,
-        buffer, sizeof(request) + chunk_size, NULL, 0, NULL);
-    if (ret != 0) {
-      fprintf(stderr, "Error code from hoth: %d\n", ret);
-      return PAYLOAD_UPDATE_FLASH_FAIL;
+struct payload_update_stats {
+  size_t unchanged;
+  size_t erased;
+};
+
+// Writes the image bytes in [start, end), held in `data`, to the staging
+// half. In a differential update the range must be one erase block; it's left
+// untouched if it already matches, and only erased if the new contents can't
+// be programmed over the old ones.
+static int payload_update_block(
+    struct libhoth_device* dev, const uint8_t* data, size_t start, size_t end,
+    size_t size, const struct libhoth_payload_update_options* options,
+    struct payload_update_stats* stats) {
+  if (!options->differential) {
+    return payload_update_flash(dev, data, NULL, start, end, size, options,
+                                NULL);
+  }
+
+  uint8_t* staged = malloc(end - start);
+  if (staged == NULL) {
+    return -1;
+  }
+  bool differs;
+  bool needs_erase;
+  int status = payload_update_compare(dev, data, start, end, options, staged,
+                                      &differs, &needs_erase);
+  if (status == 0 && !differs) {
+    stats->unchanged += end - start;
+  } else if (status == 0 && needs_erase) {
+    status = payload_update_erase(dev, start, end - start);
+    if (status == 0) {
+      stats->erased += end - start;
+      status = payload_update_flash(dev, data, NULL, start, end, size, options,
+                                    NULL);
     }
+  } else if (status == 0) {
+    // Only the parts that differ are programmed over the old contents.
+    status = payload_update_flash(dev, data, staged, start, end, size,
+                                  options, NULL);
+  }
+  free(staged);
+  if (status != 0) {
+    return status;
+  }
+  payload_update_progress(options, end, size);
+  return 0;
+}
+
+static enum payload_update_err payload_update_begin(
+    struct libhoth_device* dev,
+    const struct libhoth_payload_update_options* options) {
+  if (options->differential) {
+    fprintf(stderr, "Flashing the changed parts of the image to hoth.\n");
+    return PAYLOAD_UPDATE_OK;
+  }
+  fprintf(stderr, "Initiating payload update protocol with libhoth.\n");
+  if (send_payload_update_request_with_command(dev, PAYLOAD_UPDATE_INITIATE) !=
+      0) {
+    return PAYLOAD_UPDATE_INITIATE_FAIL;
+  }
+  fprintf(stderr, "Flashing the image to hoth.\n");
+  return PAYLOAD_UPDATE_OK;
+}
 
-    offset += chunk_size - 1;
+static enum payload_update_err payload_update_end(
+    struct libhoth_device* dev, size_t size,
+    const struct libhoth_payload_update_options* options,
+    const struct payload_update_stats* stats) {
+  payload_update_progress(options, size, size);
+  if (options->differential) {
+    fprintf(stderr, "%zu of %zu bytes unchanged, %zu bytes erased.\n",
+            stats->unchanged, size, stats->erased);
   }
 
   fprintf(stderr, "Finalizing payload update.\n");
@@ -143,10 +530,236 @@ enum payload_update_err libhoth_payload_update(struct libhoth_device* dev,
   if (pld_needs_reinitialization != 0) {
     fprintf(stderr, "PLD updated. Re-initialization needed.\n");
   }
-
   return PAYLOAD_UPDATE_OK;
 }
 
+// Works out where an update recorded in `saved` can carry on from, checking
+// that the staging half is the same one and still holds the last block that
+// was written. Returns 0 if the update has to start over.
+static size_t payload_update_resume_point(
+    struct libhoth_device* dev, const uint8_t* image,
+    const struct libhoth_payload_update_options* options,
+    const struct payload_update_journal_record* saved) {
+  const size_t start =
+      saved->acked - saved->acked % LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE;
+  if (start == 0) {
+    return 0;
+  }
+  struct payload_update_status status;
+  if (libhoth_payload_update_getstatus(dev, &status) != 0) {
+    return 0;
+  }
+  if (status.next_half != saved->staging_half) {
+    fprintf(stderr, "Staging half changed since the update was interrupted\n");
+    return 0;
+  }
+  const size_t check = start - LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE;
+  uint8_t* staged = malloc(LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE);
+  if (staged == NULL) {
+    return 0;
+  }
+  bool differs;
+  bool needs_erase;
+  const bool same = payload_update_compare(dev, image + check, check, start,
+                                           options, staged, &differs,
+                                           &needs_erase) == 0 &&
+                    !differs;
+  free(staged);
+  if (!same) {
+    fprintf(stderr, "Staging half doesn't hold the interrupted update\n");
+    return 0;
+  }
+  return start;
+}
+
+static enum payload_update_err payload_update_journaled(
+    struct libhoth_device* dev, const uint8_t* image, size_t size,
+    const struct libhoth_payload_update_options* options) {
+  struct payload_update_journal journal = {
+      .path = options->journal_path,
+      .record =
+          {
+              .magic = PAYLOAD_UPDATE_JOURNAL_MAGIC,
+              .version = PAYLOAD_UPDATE_JOURNAL_VERSION,
+              .image_size = size,
+              .image_hash = payload_update_image_hash(image, size),
+          },
+  };
+
+  size_t start = 0;
+  struct payload_update_journal_record saved;
+  if (payload_update_journal_load(journal.path, &saved) &&
+      saved.image_size == journal.record.image_size &&
+      saved.image_hash == journal.record.image_hash && saved.acked <= size) {
+    start = payload_update_resume_point(dev, image, options, &saved);
+  }
+
+  if (start > 0) {
+    // Part of the block at `start` may have been written already; writing
+    // the same data again doesn't change it.
+    fprintf(stderr, "Resuming payload update at 0x%zx.\n", start);
+    journal.record.staging_half = saved.staging_half;
+  } else {
+    enum payload_update_err err = payload_update_begin(dev, options);
+    if (err != PAYLOAD_UPDATE_OK) {
+      return err;
+    }
+    struct payload_update_status status;
+    if (libhoth_payload_update_getstatus(dev, &status) != 0) {
+      return PAYLOAD_UPDATE_INITIATE_FAIL;
+    }
+    journal.record.staging_half = status.next_half;
+  }
+  journal.record.acked = start;
+  if (payload_update_journal_save(&journal) != 0) {
+    return PAYLOAD_UPDATE_FLASH_FAIL;
+  }
+
+  if (payload_update_flash(dev, image + start, NULL, start, size, size,
+                           options, &journal) != 0) {
+    payload_update_journal_save(&journal);
+    return PAYLOAD_UPDATE_FLASH_FAIL;
+  }
+
+  const struct payload_update_stats stats = {0};
+  enum payload_update_err err = payload_update_end(dev, size, options, &stats);
+  if (err == PAYLOAD_UPDATE_OK) {
+    unlink(journal.path);
+  }
+  return err;
+}
+
+enum payload_update_err libhoth_payload_update(struct libhoth_device* dev,
+                                               uint8_t* image, size_t size) {
+  const struct libhoth_payload_update_options options = {0};
+  return libhoth_payload_update_with_options(dev, image, size, &options);
+}
+
+enum payload_update_err libhoth_payload_update_with_options(
+    struct libhoth_device* dev, uint8_t* image, size_t size,
+    const struct libhoth_payload_update_options* options) {
+  if (libhoth_find_image_descriptor(image, size) == NULL) {
+    return PAYLOAD_UPDATE_BAD_IMG;
+  }
+  if (options->journal_path != NULL) {
+    if (options->differential) {
+      fprintf(stderr,
+              "A payload update journal can't be used in differential mode\n");
+      return PAYLOAD_UPDATE_INITIATE_FAIL;
+    }
+    return payload_update_journaled(dev, image, size, options);
+  }
+
+  enum payload_update_err err = payload_update_begin(dev, options);
+  if (err != PAYLOAD_UPDATE_OK) {
+    return err;
+  }
+
+  struct payload_update_stats stats = {0};
+  if (options->differential) {
+    for (size_t start = 0; start < size;
+         start += LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE) {
+      const size_t end =
+          MIN(start + LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE, size);
+      if (payload_update_block(dev, image + start, start, end, size, options,
+                               &stats) != 0) {
+        return PAYLOAD_UPDATE_FLASH_FAIL;
+      }
+    }
+  } else if (payload_update_flash(dev, image, NULL, 0, size, size, options,
+                                  NULL) != 0) {
+    return PAYLOAD_UPDATE_FLASH_FAIL;
+  }
+
+  return payload_update_end(dev, size, options, &stats);
+}
+
+enum payload_update_err libhoth_payload_update_stream(
+    struct libhoth_device* dev, const struct libhoth_payload_reader* reader,
+    size_t size, const struct libhoth_payload_update_options* options) {
+  // The image is handled one descriptor-aligned block at a time, so blocks
+  // never straddle a region, and an erase block in differential updates.
+  _Static_assert(TITAN_IMAGE_DESCRIPTOR_ALIGNMENT ==
+                     LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE,
+                 "stream blocks must be erase blocks");
+  if (options->journal_path != NULL) {
+    fprintf(stderr,
+            "A payload update journal can't be used with a streamed image\n");
+    return PAYLOAD_UPDATE_INITIATE_FAIL;
+  }
+  uint8_t* block = malloc(TITAN_IMAGE_DESCRIPTOR_ALIGNMENT);
+  if (block == NULL) {
+    return PAYLOAD_UPDATE_FLASH_FAIL;
+  }
+
+  enum payload_update_err err = payload_update_begin(dev, options);
+  if (err != PAYLOAD_UPDATE_OK) {
+    free(block);
+    return err;
+  }
+
+  struct payload_update_stats stats = {0};
+  bool found_descriptor = false;
+  // Image offset just past the descriptor area, once it has been found.
+  size_t descriptor_end = 0;
+  size_t offset = 0;
+  while (true) {
+    ssize_t len = libhoth_payload_read_full(reader, block,
+                                            TITAN_IMAGE_DESCRIPTOR_ALIGNMENT);
+    if (len < 0) {
+      fprintf(stderr, "Error reading the image at 0x%zx\n", offset);
+      err = PAYLOAD_UPDATE_FLASH_FAIL;
+      break;
+    }
+    if (len == 0) {
+      break;
+    }
+    // Blocks start at descriptor-aligned offsets, which is where the
+    // descriptor can be. Its area may run on into later blocks.
+    if (!found_descriptor && (size_t)len >= sizeof(struct image_descriptor)) {
+      struct image_descriptor descriptor;
+      memcpy(&descriptor, block, sizeof(descriptor));
+      if (descriptor.descriptor_magic == TITAN_IMAGE_DESCRIPTOR_MAGIC) {
+        found_descriptor = true;
+        descriptor_end = offset + descriptor.descriptor_area_size;
+      }
+    }
+    if (payload_update_block(dev, block, offset, offset + len, size, options,
+                             &stats) != 0) {
+      err = PAYLOAD_UPDATE_FLASH_FAIL;
+      break;
+    }
+    offset += len;
+    if ((size_t)len < TITAN_IMAGE_DESCRIPTOR_ALIGNMENT) {
+      break;
+    }
+  }
+  free(block);
+  if (err != PAYLOAD_UPDATE_OK) {
+    return err;
+  }
+
+  // The staging half isn't finalized, so a bad image never becomes active.
+  if (!found_descriptor || descriptor_end > offset) {
+    return PAYLOAD_UPDATE_BAD_IMG;
+  }
+  if (size > 0 && offset != size) {
+    fprintf(stderr, "Image is %zu bytes, expected %zu\n", offset, size);
+    return PAYLOAD_UPDATE_BAD_IMG;
+  }
+  return payload_update_end(dev, offset, options, &stats);
+}
+
+enum payload_update_err libhoth_payload_update_fd(
+    struct libhoth_device* dev, int fd, size_t size,
+    const struct libhoth_payload_update_options* options) {
+  const struct libhoth_payload_reader reader = {
+      .read = libhoth_payload_read_fd,
+      .ctx = &fd,
+  };
+  return libhoth_payload_update_stream(dev, &reader, size, options);
+}
+
 int libhoth_payload_update_getstatus(
     struct libhoth_device* dev, struct payload_update_status* update_status) {
   struct payload_update_packet request;
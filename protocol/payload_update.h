@@ -19,8 +19,12 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "payload_reader.h"
+#include "progress.h"
 #include "transports/libhoth_device.h"
 
 #define HOTH_PRV_CMD_HOTH_PAYLOAD_UPDATE 0x0005
@@ -70,8 +74,65 @@ struct payload_update_finalize_response_v1 {
   uint8_t pld_needs_reinitialization;
 } __attribute__((packed));
 
+// Granularity of PAYLOAD_UPDATE_ERASE in differential updates.
+#define LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE (64 * 1024)
+
+// How often the payload update journal is saved, in image bytes.
+#define LIBHOTH_PAYLOAD_UPDATE_JOURNAL_INTERVAL (1024 * 1024)
+
+// Maximum number of PAYLOAD_UPDATE_CONTINUE packets that can be in flight at
+// once.
+#define LIBHOTH_PAYLOAD_UPDATE_MAX_WINDOW 8
+
+struct libhoth_payload_update_options {
+  // Number of PAYLOAD_UPDATE_CONTINUE packets to keep in flight, up to
+  // LIBHOTH_PAYLOAD_UPDATE_MAX_WINDOW. 0 means 1. Limited to what the
+  // transport can queue (see `fifo_pipeline_depth` in libhoth_usb.h). Even
+  // with a window of 1, the next packet is prepared while the current one is
+  // in flight.
+  size_t window;
+  // Optional; told how many bytes of the image have been written.
+  struct libhoth_progress* progress;
+  // Instead of erasing the whole staging half with PAYLOAD_UPDATE_INITIATE,
+  // read it back with PAYLOAD_UPDATE_READ, using `window`, and only touch the
+  // LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE blocks that differ from `image`.
+  // A block is erased and rewritten if some byte needs a bit set; otherwise
+  // only the bytes that differ are programmed. This pays off when the staging
+  // half holds an image close to the new one, as it does after regular A/B
+  // updates. Needs firmware that supports PAYLOAD_UPDATE_READ and
+  // PAYLOAD_UPDATE_ERASE.
+  bool differential;
+  // If set, progress is recorded in a journal file at this path, and an
+  // update of the same image that was interrupted carries on where it left
+  // off instead of starting over. Before resuming, the staging half is
+  // checked with PAYLOAD_UPDATE_GET_STATUS and by reading back the last
+  // block written. The journal is removed once the update has been
+  // finalized. Only supported by libhoth_payload_update_with_options(), and
+  // not in differential mode, which skips already-written blocks anyway;
+  // setting it otherwise fails with PAYLOAD_UPDATE_INITIATE_FAIL.
+  const char* journal_path;
+};
+
 enum payload_update_err libhoth_payload_update(struct libhoth_device* dev,
                                                uint8_t* image, size_t len);
+enum payload_update_err libhoth_payload_update_with_options(
+    struct libhoth_device* dev, uint8_t* image, size_t len,
+    const struct libhoth_payload_update_options* options);
+// Same as libhoth_payload_update_with_options(), but pulls the image from
+// `reader` one TITAN_IMAGE_DESCRIPTOR_ALIGNMENT block at a time, so the whole
+// image is never held in memory. The image descriptor is looked for as blocks
+// go by; if there is none, PAYLOAD_UPDATE_BAD_IMG is returned without
+// finalizing the update. `size` is the expected image size, pass 0 if it
+// isn't known; a stream of any other length is rejected the same way.
+enum payload_update_err libhoth_payload_update_stream(
+    struct libhoth_device* dev, const struct libhoth_payload_reader* reader,
+    size_t size, const struct libhoth_payload_update_options* options);
+
+// Streams the image from `fd`, which may be a pipe.
+enum payload_update_err libhoth_payload_update_fd(
+    struct libhoth_device* dev, int fd, size_t size,
+    const struct libhoth_payload_update_options* options);
+
 int libhoth_payload_update_getstatus(
     struct libhoth_device* dev, struct payload_update_status* update_status);
 
@@ -14,9 +14,18 @@
 
 #include "payload_update.h"
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
 
 #include "command_version.h"
+#include "payload_info.h"
+#include "protocol/host_cmd.h"
 #include "test/libhoth_device_mock.h"
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -33,6 +42,15 @@ constexpr int64_t kMagic = 0x5F435344474D495F;
 constexpr int64_t kAlign = 1 << 16;
 constexpr int64_t kDummy = 0;
 
+MATCHER_P(UsesPayloadUpdateType, type, "") {
+  struct payload_update_packet packet;
+  std::memcpy(&packet,
+              static_cast<const uint8_t*>(arg) +
+                  sizeof(struct hoth_host_request),
+              sizeof(packet));
+  return packet.type == type;
+}
+
 TEST_F(LibHothTest, payload_update_bad_image_test) {
   EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
       .WillRepeatedly(Return(LIBHOTH_OK));
@@ -135,6 +153,590 @@ TEST_F(LibHothTest, payload_update_flash_fail) {
             PAYLOAD_UPDATE_FLASH_FAIL);
 }
 
+TEST_F(LibHothTest, payload_update_window_test) {
+  static constexpr uint32_t kVersionMask = 0x1;
+  {
+    InSequence s;
+
+    // Initiate.
+    EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+    // Three continue packets, with up to two in flight.
+    EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+        .Times(2)
+        .WillRepeatedly(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .Times(2)
+        .WillRepeatedly(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+    // Finalize.
+    EXPECT_CALL(mock_, send(_, UsesCommand(HOTH_CMD_GET_CMD_VERSIONS), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kVersionMask, sizeof(kVersionMask)),
+                        Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_, send(_, UsesCommandWithVersion(kCmd, 0), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+  }
+
+  // Three packets' worth of data.
+  std::vector<uint8_t> buffer(2 * LIBHOTH_MAILBOX_SIZE + 100);
+  std::memcpy(buffer.data(), &kMagic, sizeof(kMagic));
+
+  std::vector<uint64_t> progress_calls;
+  struct libhoth_progress progress = {
+      .func =
+          [](void* param, uint64_t numerator, uint64_t denominator) {
+            static_cast<std::vector<uint64_t>*>(param)->push_back(numerator);
+          },
+      .param = &progress_calls,
+  };
+  struct libhoth_payload_update_options options = {
+      .window = 2,
+      .progress = &progress,
+  };
+  hoth_dev_.queue_depth = 2;
+
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer.data(),
+                                                buffer.size(), &options),
+            PAYLOAD_UPDATE_OK);
+  ASSERT_EQ(progress_calls.size(), 4);
+  EXPECT_LT(progress_calls[0], progress_calls[1]);
+  EXPECT_LT(progress_calls[1], progress_calls[2]);
+  EXPECT_EQ(progress_calls[2], buffer.size());
+  EXPECT_EQ(progress_calls[3], buffer.size());
+}
+
+TEST_F(LibHothTest, payload_update_window_limited_by_transport) {
+  static constexpr uint32_t kVersionMask = 0x1;
+  {
+    InSequence s;
+
+    // Initiate, then three continue packets, one at a time.
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+          .WillOnce(Return(LIBHOTH_OK));
+      EXPECT_CALL(mock_, receive)
+          .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+    }
+    // Finalize.
+    EXPECT_CALL(mock_, send(_, UsesCommand(HOTH_CMD_GET_CMD_VERSIONS), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kVersionMask, sizeof(kVersionMask)),
+                        Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_, send(_, UsesCommandWithVersion(kCmd, 0), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+  }
+
+  std::vector<uint8_t> buffer(2 * LIBHOTH_MAILBOX_SIZE + 100);
+  std::memcpy(buffer.data(), &kMagic, sizeof(kMagic));
+  // The mock device holds a single request.
+  struct libhoth_payload_update_options options = {
+      .window = 2,
+  };
+
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer.data(),
+                                                buffer.size(), &options),
+            PAYLOAD_UPDATE_OK);
+}
+
+TEST_F(LibHothTest, payload_update_window_too_large) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .WillOnce(Return(LIBHOTH_OK));
+  EXPECT_CALL(mock_, receive)
+      .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+
+  uint8_t buffer[100] = {0};
+  std::memcpy(buffer, &kMagic, sizeof(kMagic));
+  struct libhoth_payload_update_options options = {
+      .window = LIBHOTH_PAYLOAD_UPDATE_MAX_WINDOW + 1,
+  };
+
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer,
+                                                sizeof(buffer), &options),
+            PAYLOAD_UPDATE_FLASH_FAIL);
+}
+
+TEST_F(LibHothTest, payload_update_differential_unchanged) {
+  uint8_t buffer[100] = {0};
+  std::memcpy(buffer, &kMagic, sizeof(kMagic));
+
+  static constexpr uint32_t kVersionMask = 0x1;
+  {
+    InSequence s;
+
+    EXPECT_CALL(mock_, send(_, UsesPayloadUpdateType(PAYLOAD_UPDATE_READ), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(buffer, sizeof(buffer)), Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_, send(_, UsesCommand(HOTH_CMD_GET_CMD_VERSIONS), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kVersionMask, sizeof(kVersionMask)),
+                        Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_,
+                send(_, UsesPayloadUpdateType(PAYLOAD_UPDATE_FINALIZE), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+  }
+
+  struct libhoth_payload_update_options options = {
+      .differential = true,
+  };
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer,
+                                                sizeof(buffer), &options),
+            PAYLOAD_UPDATE_OK);
+}
+
+TEST_F(LibHothTest, payload_update_differential_changed) {
+  uint8_t buffer[100] = {0};
+  std::memcpy(buffer, &kMagic, sizeof(kMagic));
+  // Programmed to zero, so the magic can't be written without an erase.
+  const uint8_t staged[sizeof(buffer)] = {0};
+
+  static constexpr uint32_t kVersionMask = 0x1;
+  {
+    InSequence s;
+
+    EXPECT_CALL(mock_, send(_, UsesPayloadUpdateType(PAYLOAD_UPDATE_READ), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(staged, sizeof(staged)), Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_,
+                send(_, UsesPayloadUpdateType(PAYLOAD_UPDATE_ERASE), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_,
+                send(_, UsesPayloadUpdateType(PAYLOAD_UPDATE_CONTINUE), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_, send(_, UsesCommand(HOTH_CMD_GET_CMD_VERSIONS), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kVersionMask, sizeof(kVersionMask)),
+                        Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_,
+                send(_, UsesPayloadUpdateType(PAYLOAD_UPDATE_FINALIZE), _))
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+  }
+
+  struct libhoth_payload_update_options options = {
+      .differential = true,
+  };
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer,
+                                                sizeof(buffer), &options),
+            PAYLOAD_UPDATE_OK);
+}
+
+// Hands out `image` a few hundred bytes at a time, like a pipe would.
+struct MemoryReader {
+  const std::vector<uint8_t>* image;
+  size_t offset;
+
+  static ssize_t Read(void* ctx, void* buf, size_t len) {
+    auto* self = static_cast<MemoryReader*>(ctx);
+    len = std::min({len, self->image->size() - self->offset, size_t{300}});
+    std::memcpy(buf, self->image->data() + self->offset, len);
+    self->offset += len;
+    return len;
+  }
+};
+
+std::vector<uint8_t> MakeErasedImage(size_t size, size_t descriptor_offset) {
+  std::vector<uint8_t> image(size, 0xFF);
+  struct image_descriptor descriptor = {};
+  descriptor.descriptor_magic = TITAN_IMAGE_DESCRIPTOR_MAGIC;
+  descriptor.descriptor_area_size = sizeof(descriptor);
+  std::memcpy(image.data() + descriptor_offset, &descriptor,
+              sizeof(descriptor));
+  return image;
+}
+
+TEST_F(LibHothTest, payload_update_stream_test) {
+  {
+    Sequence s_send, s_receive;
+
+    EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+        .InSequence(s_send)
+        .WillRepeatedly(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .InSequence(s_receive)
+        .WillRepeatedly(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+
+    static constexpr uint32_t kVersionMask = 0x1;
+    EXPECT_CALL(mock_, send(_, UsesCommand(HOTH_CMD_GET_CMD_VERSIONS), _))
+        .InSequence(s_send, s_receive)
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .InSequence(s_send, s_receive)
+        .WillOnce(DoAll(CopyResp(&kVersionMask, sizeof(kVersionMask)),
+                        Return(LIBHOTH_OK)));
+    EXPECT_CALL(mock_, send(_, UsesCommandWithVersion(kCmd, 0), _))
+        .InSequence(s_send, s_receive)
+        .WillOnce(Return(LIBHOTH_OK));
+    EXPECT_CALL(mock_, receive)
+        .InSequence(s_send, s_receive)
+        .WillOnce(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+  }
+
+  // The descriptor is in the second block, and the image ends mid-block.
+  const std::vector<uint8_t> image = MakeErasedImage(2 * kAlign + 100, kAlign);
+  MemoryReader reader_ctx = {.image = &image, .offset = 0};
+  const struct libhoth_payload_reader reader = {
+      .read = MemoryReader::Read,
+      .ctx = &reader_ctx,
+  };
+  const struct libhoth_payload_update_options options = {};
+
+  EXPECT_EQ(libhoth_payload_update_stream(&hoth_dev_, &reader, image.size(),
+                                          &options),
+            PAYLOAD_UPDATE_OK);
+  EXPECT_EQ(reader_ctx.offset, image.size());
+}
+
+TEST_F(LibHothTest, payload_update_stream_bad_image) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .WillRepeatedly(Return(LIBHOTH_OK));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+  // Not finalized.
+  EXPECT_CALL(mock_, send(_, UsesCommand(HOTH_CMD_GET_CMD_VERSIONS), _))
+      .Times(0);
+
+  // The descriptor isn't descriptor-aligned.
+  const std::vector<uint8_t> image = MakeErasedImage(2 * kAlign, 100);
+  MemoryReader reader_ctx = {.image = &image, .offset = 0};
+  const struct libhoth_payload_reader reader = {
+      .read = MemoryReader::Read,
+      .ctx = &reader_ctx,
+  };
+  const struct libhoth_payload_update_options options = {};
+
+  EXPECT_EQ(libhoth_payload_update_stream(&hoth_dev_, &reader, image.size(),
+                                          &options),
+            PAYLOAD_UPDATE_BAD_IMG);
+}
+
+TEST_F(LibHothTest, payload_update_stream_truncated) {
+  EXPECT_CALL(mock_, send(_, UsesCommand(kCmd), _))
+      .WillRepeatedly(Return(LIBHOTH_OK));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(DoAll(CopyResp(&kDummy, 0), Return(LIBHOTH_OK)));
+  // Not finalized.
+  EXPECT_CALL(mock_, send(_, UsesCommand(HOTH_CMD_GET_CMD_VERSIONS), _))
+      .Times(0);
+
+  // The stream ends a block short of the announced size.
+  const std::vector<uint8_t> image = MakeErasedImage(2 * kAlign, 0);
+  MemoryReader reader_ctx = {.image = &image, .offset = 0};
+  const struct libhoth_payload_reader reader = {
+      .read = MemoryReader::Read,
+      .ctx = &reader_ctx,
+  };
+  const struct libhoth_payload_update_options options = {};
+
+  EXPECT_EQ(libhoth_payload_update_stream(&hoth_dev_, &reader,
+                                          image.size() + kAlign, &options),
+            PAYLOAD_UPDATE_BAD_IMG);
+}
+
+// Plays the RoT's side of the payload update protocol, with a staging half
+// that keeps its contents between updates. Requests may be queued up to the
+// device's queue depth, and are answered in order.
+class FakeStagingHalf {
+ public:
+  explicit FakeStagingHalf(size_t size) : flash_(size, 0xFF) {}
+
+  int Send(struct libhoth_device* dev, const void* request,
+           size_t request_size) {
+    struct hoth_host_request header;
+    std::memcpy(&header, request, sizeof(header));
+    const uint8_t* payload =
+        static_cast<const uint8_t*>(request) + sizeof(header);
+    EXPECT_LT(responses_.size(), libhoth_device_queue_depth(dev));
+    responses_.emplace_back();
+
+    if (header.command == HOTH_CMD_GET_CMD_VERSIONS) {
+      const uint32_t version_mask = 0x1;
+      Respond(&version_mask, sizeof(version_mask));
+      return LIBHOTH_OK;
+    }
+    struct payload_update_packet packet;
+    std::memcpy(&packet, payload, sizeof(packet));
+    switch (packet.type) {
+      case PAYLOAD_UPDATE_INITIATE:
+        initiates_++;
+        std::fill(flash_.begin(), flash_.end(), 0xFF);
+        break;
+      case PAYLOAD_UPDATE_CONTINUE:
+        if (continues_ == fail_after_continues_) {
+          responses_.back().fail = true;
+          break;
+        }
+        continues_++;
+        continued_bytes_ += packet.len;
+        for (size_t i = 0; i < packet.len; ++i) {
+          flash_[packet.offset + i] &= payload[sizeof(packet) + i];
+        }
+        break;
+      case PAYLOAD_UPDATE_ERASE:
+        std::fill_n(flash_.begin() + packet.offset, packet.len, 0xFF);
+        break;
+      case PAYLOAD_UPDATE_READ:
+        reads_++;
+        max_queued_reads_ =
+            std::max(max_queued_reads_, static_cast<int>(responses_.size()));
+        Respond(flash_.data() + packet.offset, packet.len);
+        break;
+      case PAYLOAD_UPDATE_GET_STATUS: {
+        struct payload_update_status status = {};
+        status.next_half = 1;
+        Respond(&status, sizeof(status));
+        break;
+      }
+      case PAYLOAD_UPDATE_FINALIZE:
+        finalizes_++;
+        break;
+    }
+    return LIBHOTH_OK;
+  }
+
+  int Receive(struct libhoth_device* dev, void* response,
+              size_t max_response_size, size_t* actual_size, int timeout_ms) {
+    if (responses_.empty()) {
+      ADD_FAILURE() << "receive without a queued request";
+      return -1;
+    }
+    const Response next = std::move(responses_.front());
+    responses_.pop_front();
+    if (next.fail) {
+      return -1;
+    }
+    struct hoth_host_response header = {};
+    header.struct_version = HOTH_HOST_RESPONSE_VERSION;
+    header.data_len = next.data.size();
+    header.checksum = libhoth_calculate_checksum(
+        &header, sizeof(header), next.data.data(), next.data.size());
+    std::memcpy(response, &header, sizeof(header));
+    std::memcpy(static_cast<uint8_t*>(response) + sizeof(header),
+                next.data.data(), next.data.size());
+    *actual_size = sizeof(header) + next.data.size();
+    return LIBHOTH_OK;
+  }
+
+  std::vector<uint8_t>& flash() { return flash_; }
+  int initiates() const { return initiates_; }
+  int continues() const { return continues_; }
+  size_t continued_bytes() const { return continued_bytes_; }
+  int reads() const { return reads_; }
+  int max_queued_reads() const { return max_queued_reads_; }
+  int finalizes() const { return finalizes_; }
+  void FailAfterContinues(int n) { fail_after_continues_ = n; }
+
+ private:
+  void Respond(const void* data, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    responses_.back().data.assign(bytes, bytes + len);
+  }
+
+  struct Response {
+    std::vector<uint8_t> data;
+    bool fail = false;
+  };
+
+  std::vector<uint8_t> flash_;
+  std::deque<Response> responses_;
+  int fail_after_continues_ = -1;
+  int initiates_ = 0;
+  int continues_ = 0;
+  size_t continued_bytes_ = 0;
+  int reads_ = 0;
+  int max_queued_reads_ = 0;
+  int finalizes_ = 0;
+};
+
+TEST_F(LibHothTest, payload_update_resume_test) {
+  // Data in three places, the last two past the journal interval.
+  constexpr size_t kImageSize = 3 * LIBHOTH_PAYLOAD_UPDATE_JOURNAL_INTERVAL;
+  std::vector<uint8_t> image = MakeErasedImage(kImageSize, 0);
+  const size_t kData1 = 3 * LIBHOTH_PAYLOAD_UPDATE_JOURNAL_INTERVAL / 2;
+  const size_t kData2 = 5 * LIBHOTH_PAYLOAD_UPDATE_JOURNAL_INTERVAL / 2;
+  std::fill_n(image.begin() + kData1, 10, 0x11);
+  std::fill_n(image.begin() + kData2, 10, 0x22);
+
+  FakeStagingHalf fake(kImageSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeStagingHalf::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeStagingHalf::Receive));
+
+  const std::string journal = testing::TempDir() + "/payload_update_journal";
+  std::remove(journal.c_str());
+  const struct libhoth_payload_update_options options = {
+      .journal_path = journal.c_str(),
+  };
+
+  // The last packet fails.
+  fake.FailAfterContinues(2);
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, image.data(),
+                                                image.size(), &options),
+            PAYLOAD_UPDATE_FLASH_FAIL);
+  EXPECT_EQ(fake.initiates(), 1);
+  EXPECT_EQ(fake.continues(), 2);
+
+  // Carries on from the block holding the second packet.
+  fake.FailAfterContinues(-1);
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, image.data(),
+                                                image.size(), &options),
+            PAYLOAD_UPDATE_OK);
+  EXPECT_EQ(fake.initiates(), 1);
+  EXPECT_EQ(fake.continues(), 4);
+  EXPECT_EQ(fake.finalizes(), 1);
+  EXPECT_EQ(fake.flash(), image);
+  EXPECT_NE(access(journal.c_str(), F_OK), 0);
+}
+
+TEST_F(LibHothTest, payload_update_resume_other_image) {
+  constexpr size_t kImageSize = 3 * LIBHOTH_PAYLOAD_UPDATE_JOURNAL_INTERVAL;
+  std::vector<uint8_t> image = MakeErasedImage(kImageSize, 0);
+  std::fill_n(image.begin() + 2 * LIBHOTH_PAYLOAD_UPDATE_JOURNAL_INTERVAL, 10,
+              0x11);
+
+  FakeStagingHalf fake(kImageSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeStagingHalf::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeStagingHalf::Receive));
+
+  const std::string journal =
+      testing::TempDir() + "/payload_update_journal_other";
+  std::remove(journal.c_str());
+  const struct libhoth_payload_update_options options = {
+      .journal_path = journal.c_str(),
+  };
+
+  fake.FailAfterContinues(1);
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, image.data(),
+                                                image.size(), &options),
+            PAYLOAD_UPDATE_FLASH_FAIL);
+
+  // A different image starts over.
+  image[kImageSize - 1] = 0;
+  fake.FailAfterContinues(-1);
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, image.data(),
+                                                image.size(), &options),
+            PAYLOAD_UPDATE_OK);
+  EXPECT_EQ(fake.initiates(), 2);
+  EXPECT_EQ(fake.flash(), image);
+}
+
+TEST_F(LibHothTest, payload_update_differential_sends_changed_chunks) {
+  constexpr size_t kImageSize = 2 * LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE;
+  std::vector<uint8_t> image = MakeErasedImage(kImageSize, 0);
+  std::fill(image.begin() + 0x1000, image.end(), 0x5A);
+
+  FakeStagingHalf fake(kImageSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeStagingHalf::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeStagingHalf::Receive));
+  fake.flash() = image;
+
+  // Clearing bits needs no erase, so only the changed bytes are sent.
+  image[0x2000] = 0x50;
+  image[0x2001] = 0x40;
+  image[0x10000 + 0x3000] = 0x00;
+  const struct libhoth_payload_update_options options = {
+      .differential = true,
+  };
+  std::vector<uint8_t> buffer = image;
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer.data(),
+                                                buffer.size(), &options),
+            PAYLOAD_UPDATE_OK);
+  EXPECT_EQ(fake.continues(), 2);
+  EXPECT_EQ(fake.continued_bytes(), 3);
+  EXPECT_EQ(fake.flash(), image);
+
+  // Setting a bit needs an erase, after which the whole block is rewritten.
+  image[0x10000 + 0x3000] = 0xFF;
+  buffer = image;
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer.data(),
+                                                buffer.size(), &options),
+            PAYLOAD_UPDATE_OK);
+  EXPECT_EQ(fake.continued_bytes(),
+            3 + LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE);
+  EXPECT_EQ(fake.flash(), image);
+}
+
+TEST_F(LibHothTest, payload_update_differential_windowed_readback) {
+  constexpr size_t kImageSize = LIBHOTH_PAYLOAD_UPDATE_ERASE_BLOCK_SIZE;
+  const std::vector<uint8_t> image = MakeErasedImage(kImageSize, 0);
+
+  FakeStagingHalf fake(kImageSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeStagingHalf::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeStagingHalf::Receive));
+  fake.flash() = image;
+
+  hoth_dev_.queue_depth = 4;
+  const struct libhoth_payload_update_options options = {
+      .window = 4,
+      .differential = true,
+  };
+  std::vector<uint8_t> buffer = image;
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer.data(),
+                                                buffer.size(), &options),
+            PAYLOAD_UPDATE_OK);
+  EXPECT_EQ(fake.max_queued_reads(), 4);
+  EXPECT_EQ(fake.continues(), 0);
+  const size_t read_size =
+      LIBHOTH_MAILBOX_SIZE - sizeof(struct hoth_host_response);
+  EXPECT_EQ(fake.reads(), (kImageSize + read_size - 1) / read_size);
+}
+
+TEST_F(LibHothTest, payload_update_journal_unsupported) {
+  // Rejected before anything is sent.
+  EXPECT_CALL(mock_, send).Times(0);
+
+  const std::vector<uint8_t> image = MakeErasedImage(kAlign, 0);
+  const struct libhoth_payload_update_options differential = {
+      .differential = true,
+      .journal_path = "unused",
+  };
+  std::vector<uint8_t> buffer = image;
+  EXPECT_EQ(libhoth_payload_update_with_options(&hoth_dev_, buffer.data(),
+                                                buffer.size(), &differential),
+            PAYLOAD_UPDATE_INITIATE_FAIL);
+
+  MemoryReader reader_ctx = {.image = &image, .offset = 0};
+  const struct libhoth_payload_reader reader = {
+      .read = MemoryReader::Read,
+      .ctx = &reader_ctx,
+  };
+  const struct libhoth_payload_update_options streamed = {
+      .journal_path = "unused",
+  };
+  EXPECT_EQ(libhoth_payload_update_stream(&hoth_dev_, &reader, image.size(),
+                                          &streamed),
+            PAYLOAD_UPDATE_INITIATE_FAIL);
+}
+
 TEST_F(LibHothTest, payload_update_command_version_fail) {
   {
     InSequence s;
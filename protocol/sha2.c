@@ -0,0 +1,439 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "sha2.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LIBHOTH_SHA2_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__GNUC__) && defined(__linux__)
+#define LIBHOTH_SHA2_ARM 1
+#include <arm_neon.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint64_t SHA512_K[80] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f,
+    0xe9b5dba58189dbbc, 0x3956c25bf348b538, 0x59f111f1b605d019,
+    0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242,
+    0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+    0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+    0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3,
+    0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65, 0x2de92c6f592b0275,
+    0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+    0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f,
+    0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+    0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc,
+    0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+    0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6,
+    0x92722c851482353b, 0xa2bfe8a14cf10364, 0xa81a664bbc423001,
+    0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+    0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+    0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99,
+    0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb,
+    0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc,
+    0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915,
+    0xc67178f2e372532b, 0xca273eceea26619c, 0xd186b8c721c0c207,
+    0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba,
+    0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+    0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+    0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a,
+    0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
+};
+
+static uint32_t ror32(uint32_t x, unsigned n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static uint64_t ror64(uint64_t x, unsigned n) {
+  return (x >> n) | (x << (64 - n));
+}
+
+static uint32_t load_be32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t load_be64(const uint8_t* p) {
+  return ((uint64_t)load_be32(p) << 32) | load_be32(p + 4);
+}
+
+static void store_be32(uint8_t* p, uint32_t x) {
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+static void store_be64(uint8_t* p, uint64_t x) {
+  store_be32(p, x >> 32);
+  store_be32(p + 4, x);
+}
+
+static void sha256_compress_portable(uint32_t state[8], const uint8_t* data,
+                                     size_t num_blocks) {
+  for (; num_blocks > 0; num_blocks--, data += 64) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+      w[i] = load_be32(&data[4 * i]);
+    }
+    for (int i = 16; i < 64; i++) {
+      const uint32_t s0 =
+          ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const uint32_t s1 =
+          ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+      const uint32_t t1 = h + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) +
+                          ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+      const uint32_t t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) +
+                          ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#if LIBHOTH_SHA2_X86
+
+__attribute__((target("sha,sse4.1"))) static void sha256_compress_x86(
+    uint32_t state[8], const uint8_t* data, size_t num_blocks) {
+  // Swaps the bytes of each 32-bit word.
+  const __m128i bswap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // The instructions want the state as ABEF and CDGH.
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]),
+                                  0xb1);  // CDAB
+  __m128i state1 = _mm_shuffle_epi32(
+      _mm_loadu_si128((const __m128i*)&state[4]), 0x1b);  // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);       // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);            // CDGH
+
+  for (; num_blocks > 0; num_blocks--, data += 64) {
+    const __m128i abef = state0;
+    const __m128i cdgh = state1;
+    __m128i w[16];
+    for (int i = 0; i < 16; i++) {
+      if (i < 4) {
+        w[i] = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i*)&data[16 * i]), bswap);
+      } else {
+        w[i] = _mm_sha256msg2_epu32(
+            _mm_add_epi32(_mm_sha256msg1_epu32(w[i - 4], w[i - 3]),
+                          _mm_alignr_epi8(w[i - 1], w[i - 2], 4)),
+            w[i - 1]);
+      }
+      __m128i msg = _mm_add_epi32(
+          w[i], _mm_loadu_si128((const __m128i*)&SHA256_K[4 * i]));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+      msg = _mm_shuffle_epi32(msg, 0x0e);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    }
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1b);                 // FEBA
+  state1 = _mm_shuffle_epi32(state1, 0xb1);              // DCHG
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0);           // DCBA
+  state1 = _mm_alignr_epi8(state1, tmp, 8);              // HGFE
+  _mm_storeu_si128((__m128i*)&state[0], state0);
+  _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+static bool sha256_cpu_supported(void) {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) ||
+      !(ecx & bit_SSSE3)) {
+    return false;
+  }
+  return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+}
+
+#define sha256_compress_cpu sha256_compress_x86
+
+#elif LIBHOTH_SHA2_ARM
+
+__attribute__((target("+crypto"))) static void sha256_compress_arm(
+    uint32_t state[8], const uint8_t* data, size_t num_blocks) {
+  uint32x4_t state0 = vld1q_u32(&state[0]);
+  uint32x4_t state1 = vld1q_u32(&state[4]);
+
+  for (; num_blocks > 0; num_blocks--, data += 64) {
+    const uint32x4_t abcd = state0;
+    const uint32x4_t efgh = state1;
+    uint32x4_t w[16];
+    for (int i = 0; i < 16; i++) {
+      if (i < 4) {
+        w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&data[16 * i])));
+      } else {
+        w[i] = vsha256su1q_u32(vsha256su0q_u32(w[i - 4], w[i - 3]), w[i - 2],
+                               w[i - 1]);
+      }
+      const uint32x4_t msg = vaddq_u32(w[i], vld1q_u32(&SHA256_K[4 * i]));
+      const uint32x4_t prev = state0;
+      state0 = vsha256hq_u32(state0, state1, msg);
+      state1 = vsha256h2q_u32(state1, prev, msg);
+    }
+    state0 = vaddq_u32(state0, abcd);
+    state1 = vaddq_u32(state1, efgh);
+  }
+
+  vst1q_u32(&state[0], state0);
+  vst1q_u32(&state[4], state1);
+}
+
+static bool sha256_cpu_supported(void) {
+  return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+}
+
+#define sha256_compress_cpu sha256_compress_arm
+
+#endif
+
+bool libhoth_sha256_accelerated(void) {
+#if LIBHOTH_SHA2_X86 || LIBHOTH_SHA2_ARM
+  static int supported = -1;
+  if (supported < 0) {
+    supported = sha256_cpu_supported();
+  }
+  return supported;
+#else
+  return false;
+#endif
+}
+
+void libhoth_sha256_init_portable(struct libhoth_sha256_ctx* ctx) {
+  static const uint32_t iv[8] = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+  memcpy(ctx->state, iv, sizeof(iv));
+  ctx->total_len = 0;
+  ctx->block_len = 0;
+  ctx->compress = sha256_compress_portable;
+}
+
+void libhoth_sha256_init(struct libhoth_sha256_ctx* ctx) {
+  libhoth_sha256_init_portable(ctx);
+#if LIBHOTH_SHA2_X86 || LIBHOTH_SHA2_ARM
+  if (libhoth_sha256_accelerated()) {
+    ctx->compress = sha256_compress_cpu;
+  }
+#endif
+}
+
+void libhoth_sha256_update(struct libhoth_sha256_ctx* ctx, const void* data,
+                           size_t len) {
+  const uint8_t* cdata = (const uint8_t*)data;
+  ctx->total_len += len;
+  if (ctx->block_len > 0) {
+    const size_t n = sizeof(ctx->block) - ctx->block_len < len
+                         ? sizeof(ctx->block) - ctx->block_len
+                         : len;
+    memcpy(&ctx->block[ctx->block_len], cdata, n);
+    ctx->block_len += n;
+    cdata += n;
+    len -= n;
+    if (ctx->block_len < sizeof(ctx->block)) {
+      return;
+    }
+    ctx->compress(ctx->state, ctx->block, 1);
+    ctx->block_len = 0;
+  }
+  // Whole blocks are compressed straight from `data`.
+  const size_t num_blocks = len / sizeof(ctx->block);
+  if (num_blocks > 0) {
+    ctx->compress(ctx->state, cdata, num_blocks);
+    cdata += num_blocks * sizeof(ctx->block);
+    len -= num_blocks * sizeof(ctx->block);
+  }
+  memcpy(ctx->block, cdata, len);
+  ctx->block_len = len;
+}
+
+void libhoth_sha256_final(struct libhoth_sha256_ctx* ctx,
+                          uint8_t digest[LIBHOTH_SHA256_DIGEST_SIZE]) {
+  const uint64_t bit_len = ctx->total_len * 8;
+  ctx->block[ctx->block_len++] = 0x80;
+  if (ctx->block_len > sizeof(ctx->block) - 8) {
+    memset(&ctx->block[ctx->block_len], 0,
+           sizeof(ctx->block) - ctx->block_len);
+    ctx->compress(ctx->state, ctx->block, 1);
+    ctx->block_len = 0;
+  }
+  memset(&ctx->block[ctx->block_len], 0,
+         sizeof(ctx->block) - 8 - ctx->block_len);
+  store_be64(&ctx->block[sizeof(ctx->block) - 8], bit_len);
+  ctx->compress(ctx->state, ctx->block, 1);
+  for (int i = 0; i < 8; i++) {
+    store_be32(&digest[4 * i], ctx->state[i]);
+  }
+}
+
+void libhoth_sha256(const void* data, size_t len,
+                    uint8_t digest[LIBHOTH_SHA256_DIGEST_SIZE]) {
+  struct libhoth_sha256_ctx ctx;
+  libhoth_sha256_init(&ctx);
+  libhoth_sha256_update(&ctx, data, len);
+  libhoth_sha256_final(&ctx, digest);
+}
+
+static void sha512_compress(uint64_t state[8], const uint8_t* data,
+                            size_t num_blocks) {
+  for (; num_blocks > 0; num_blocks--, data += 128) {
+    uint64_t w[80];
+    for (int i = 0; i < 16; i++) {
+      w[i] = load_be64(&data[8 * i]);
+    }
+    for (int i = 16; i < 80; i++) {
+      const uint64_t s0 =
+          ror64(w[i - 15], 1) ^ ror64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+      const uint64_t s1 =
+          ror64(w[i - 2], 19) ^ ror64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 80; i++) {
+      const uint64_t t1 = h + (ror64(e, 14) ^ ror64(e, 18) ^ ror64(e, 41)) +
+                          ((e & f) ^ (~e & g)) + SHA512_K[i] + w[i];
+      const uint64_t t2 = (ror64(a, 28) ^ ror64(a, 34) ^ ror64(a, 39)) +
+                          ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+void libhoth_sha512_init(struct libhoth_sha512_ctx* ctx) {
+  static const uint64_t iv[8] = {
+      0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b,
+      0xa54ff53a5f1d36f1, 0x510e527fade682d1, 0x9b05688c2b3e6c1f,
+      0x1f83d9abfb41bd6b, 0x5be0cd19137e2179,
+  };
+  memcpy(ctx->state, iv, sizeof(iv));
+  ctx->total_len = 0;
+  ctx->block_len = 0;
+}
+
+void libhoth_sha512_update(struct libhoth_sha512_ctx* ctx, const void* data,
+                           size_t len) {
+  const uint8_t* cdata = (const uint8_t*)data;
+  ctx->total_len += len;
+  if (ctx->block_len > 0) {
+    const size_t n = sizeof(ctx->block) - ctx->block_len < len
+                         ? sizeof(ctx->block) - ctx->block_len
+                         : len;
+    memcpy(&ctx->block[ctx->block_len], cdata, n);
+    ctx->block_len += n;
+    cdata += n;
+    len -= n;
+    if (ctx->block_len < sizeof(ctx->block)) {
+      return;
+    }
+    sha512_compress(ctx->state, ctx->block, 1);
+    ctx->block_len = 0;
+  }
+  const size_t num_blocks = len / sizeof(ctx->block);
+  if (num_blocks > 0) {
+    sha512_compress(ctx->state, cdata, num_blocks);
+    cdata += num_blocks * sizeof(ctx->block);
+    len -= num_blocks * sizeof(ctx->block);
+  }
+  memcpy(ctx->block, cdata, len);
+  ctx->block_len = len;
+}
+
+void libhoth_sha512_final(struct libhoth_sha512_ctx* ctx,
+                          uint8_t digest[LIBHOTH_SHA512_DIGEST_SIZE]) {
+  // The length is a 128-bit number of bits; the top bits are always 0 here.
+  const uint64_t bit_len = ctx->total_len * 8;
+  ctx->block[ctx->block_len++] = 0x80;
+  if (ctx->block_len > sizeof(ctx->block) - 16) {
+    memset(&ctx->block[ctx->block_len], 0,
+           sizeof(ctx->block) - ctx->block_len);
+    sha512_compress(ctx->state, ctx->block, 1);
+    ctx->block_len = 0;
+  }
+  memset(&ctx->block[ctx->block_len], 0,
+         sizeof(ctx->block) - 8 - ctx->block_len);
+  store_be64(&ctx->block[sizeof(ctx->block) - 8], bit_len);
+  sha512_compress(ctx->state, ctx->block, 1);
+  for (int i = 0; i < 8; i++) {
+    store_be64(&digest[8 * i], ctx->state[i]);
+  }
+}
+
+void libhoth_sha512(const void* data, size_t len,
+                    uint8_t digest[LIBHOTH_SHA512_DIGEST_SIZE]) {
+  struct libhoth_sha512_ctx ctx;
+  libhoth_sha512_init(&ctx);
+  libhoth_sha512_update(&ctx, data, len);
+  libhoth_sha512_final(&ctx, digest);
+}
@@ -0,0 +1,73 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef LIBHOTH_PROTOCOL_SHA2_H_
+#define LIBHOTH_PROTOCOL_SHA2_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LIBHOTH_SHA256_DIGEST_SIZE 32
+#define LIBHOTH_SHA512_DIGEST_SIZE 64
+
+struct libhoth_sha256_ctx {
+  uint32_t state[8];
+  uint64_t total_len;
+  uint8_t block[64];
+  size_t block_len;
+  // Compresses `num_blocks` 64-byte blocks of `data` into `state`.
+  void (*compress)(uint32_t state[8], const uint8_t* data, size_t num_blocks);
+};
+
+struct libhoth_sha512_ctx {
+  uint64_t state[8];
+  uint64_t total_len;
+  uint8_t block[128];
+  size_t block_len;
+};
+
+// Uses the SHA-256 instructions of the CPU (x86 SHA extensions or ARMv8
+// crypto extensions) if it has them.
+void libhoth_sha256_init(struct libhoth_sha256_ctx* ctx);
+// Same as libhoth_sha256_init(), but never uses the SHA-256 instructions.
+void libhoth_sha256_init_portable(struct libhoth_sha256_ctx* ctx);
+void libhoth_sha256_update(struct libhoth_sha256_ctx* ctx, const void* data,
+                           size_t len);
+void libhoth_sha256_final(struct libhoth_sha256_ctx* ctx,
+                          uint8_t digest[LIBHOTH_SHA256_DIGEST_SIZE]);
+void libhoth_sha256(const void* data, size_t len,
+                    uint8_t digest[LIBHOTH_SHA256_DIGEST_SIZE]);
+
+// Whether libhoth_sha256_init() uses the SHA-256 instructions of the CPU.
+bool libhoth_sha256_accelerated(void);
+
+void libhoth_sha512_init(struct libhoth_sha512_ctx* ctx);
+void libhoth_sha512_update(struct libhoth_sha512_ctx* ctx, const void* data,
+                           size_t len);
+void libhoth_sha512_final(struct libhoth_sha512_ctx* ctx,
+                          uint8_t digest[LIBHOTH_SHA512_DIGEST_SIZE]);
+void libhoth_sha512(const void* data, size_t len,
+                    uint8_t digest[LIBHOTH_SHA512_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBHOTH_PROTOCOL_SHA2_H_
@@ -0,0 +1,123 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "sha2.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string Hex(const uint8_t* data, size_t len) {
+  std::stringstream stream;
+  stream << std::hex;
+  for (size_t i = 0; i < len; i++) {
+    stream << std::setw(2) << std::setfill('0') << (int)data[i];
+  }
+  return stream.str();
+}
+
+std::string Sha256(const std::string& data) {
+  uint8_t digest[LIBHOTH_SHA256_DIGEST_SIZE];
+  libhoth_sha256(data.data(), data.size(), digest);
+  return Hex(digest, sizeof(digest));
+}
+
+std::string Sha512(const std::string& data) {
+  uint8_t digest[LIBHOTH_SHA512_DIGEST_SIZE];
+  libhoth_sha512(data.data(), data.size(), digest);
+  return Hex(digest, sizeof(digest));
+}
+
+TEST(Sha2Test, sha256_vectors) {
+  EXPECT_EQ(Sha256(""),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(Sha256("abc"),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  EXPECT_EQ(
+      Sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  EXPECT_EQ(Sha256(std::string(1000000, 'a')),
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST(Sha2Test, sha512_vectors) {
+  EXPECT_EQ(Sha512(""),
+            "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+            "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e");
+  EXPECT_EQ(Sha512("abc"),
+            "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+            "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f");
+  EXPECT_EQ(Sha512("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+                   "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu"),
+            "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+            "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909");
+  EXPECT_EQ(Sha512(std::string(1000000, 'a')),
+            "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973eb"
+            "de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b");
+}
+
+// Feeds the data in uneven pieces, which crosses block boundaries in every
+// way, and compares with hashing it in one go.
+TEST(Sha2Test, sha256_updates) {
+  std::vector<uint8_t> data(10000);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(i * 131 + 7);
+  }
+  uint8_t expected[LIBHOTH_SHA256_DIGEST_SIZE];
+  libhoth_sha256(data.data(), data.size(), expected);
+
+  for (bool portable : {false, true}) {
+    struct libhoth_sha256_ctx ctx;
+    if (portable) {
+      libhoth_sha256_init_portable(&ctx);
+    } else {
+      libhoth_sha256_init(&ctx);
+    }
+    for (size_t pos = 0, n = 1; pos < data.size(); pos += n, n = n * 7 % 193) {
+      libhoth_sha256_update(&ctx, &data[pos], std::min(n, data.size() - pos));
+    }
+    uint8_t digest[LIBHOTH_SHA256_DIGEST_SIZE];
+    libhoth_sha256_final(&ctx, digest);
+    EXPECT_EQ(Hex(digest, sizeof(digest)), Hex(expected, sizeof(expected)))
+        << "portable: " << portable;
+  }
+}
+
+TEST(Sha2Test, sha512_updates) {
+  std::vector<uint8_t> data(10000);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(i * 131 + 7);
+  }
+  uint8_t expected[LIBHOTH_SHA512_DIGEST_SIZE];
+  libhoth_sha512(data.data(), data.size(), expected);
+
+  struct libhoth_sha512_ctx ctx;
+  libhoth_sha512_init(&ctx);
+  for (size_t pos = 0, n = 1; pos < data.size(); pos += n, n = n * 7 % 193) {
+    libhoth_sha512_update(&ctx, &data[pos], std::min(n, data.size() - pos));
+  }
+  uint8_t digest[LIBHOTH_SHA512_DIGEST_SIZE];
+  libhoth_sha512_final(&ctx, digest);
+  EXPECT_EQ(Hex(digest, sizeof(digest)), Hex(expected, sizeof(expected)));
+}
+
+}  // namespace
@@ -0,0 +1,200 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sparse_image.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+#include <unistd.h>
+
+#include "erased.h"
+#include "payload_reader.h"
+
+static ssize_t sparse_read_plain(struct libhoth_sparse_reader* sparse,
+                                 uint8_t* buf, size_t len) {
+  if (sparse->prefix_pos < sparse->prefix_len) {
+    size_t n = MIN(len, sparse->prefix_len - sparse->prefix_pos);
+    memcpy(buf, sparse->prefix + sparse->prefix_pos, n);
+    sparse->prefix_pos += n;
+    return n;
+  }
+  return sparse->inner->read(sparse->inner->ctx, buf, len);
+}
+
+// Reads the next extent header, if there is one.
+static int sparse_next_extent(struct libhoth_sparse_reader* sparse) {
+  struct libhoth_sparse_image_extent extent;
+  ssize_t n = libhoth_payload_read_full(sparse->inner, &extent, sizeof(extent));
+  if (n == 0) {
+    sparse->inner_done = true;
+    return 0;
+  }
+  if (n != sizeof(extent)) {
+    fprintf(stderr, "Truncated sparse image extent\n");
+    return -1;
+  }
+  if (extent.len == 0 || extent.offset < sparse->pos ||
+      extent.len > sparse->image_size ||
+      extent.offset > sparse->image_size - extent.len) {
+    fprintf(stderr, "Bad sparse image extent: offset 0x%llx, len 0x%llx\n",
+            (unsigned long long)extent.offset, (unsigned long long)extent.len);
+    return -1;
+  }
+  sparse->extent = extent;
+  sparse->have_extent = true;
+  return 0;
+}
+
+static ssize_t sparse_read(void* ctx, void* buf, size_t len) {
+  struct libhoth_sparse_reader* sparse = (struct libhoth_sparse_reader*)ctx;
+  if (!sparse->sparse) {
+    return sparse_read_plain(sparse, (uint8_t*)buf, len);
+  }
+
+  if (!sparse->have_extent && !sparse->inner_done &&
+      sparse_next_extent(sparse) != 0) {
+    return -1;
+  }
+  // Up to the next extent, or the end of the image, is erased.
+  uint64_t hole_end =
+      sparse->have_extent ? sparse->extent.offset : sparse->image_size;
+  if (sparse->pos < hole_end) {
+    size_t n = MIN(len, hole_end - sparse->pos);
+    memset(buf, 0xFF, n);
+    sparse->pos += n;
+    return n;
+  }
+  if (!sparse->have_extent) {
+    return 0;
+  }
+
+  size_t n = MIN(len, sparse->extent.offset + sparse->extent.len - sparse->pos);
+  if (libhoth_payload_read_full(sparse->inner, buf, n) != (ssize_t)n) {
+    fprintf(stderr, "Truncated sparse image data at 0x%llx\n",
+            (unsigned long long)sparse->pos);
+    return -1;
+  }
+  sparse->pos += n;
+  if (sparse->pos == sparse->extent.offset + sparse->extent.len) {
+    sparse->have_extent = false;
+  }
+  return n;
+}
+
+int libhoth_sparse_reader_init(struct libhoth_sparse_reader* sparse,
+                               const struct libhoth_payload_reader* inner) {
+  memset(sparse, 0, sizeof(*sparse));
+  sparse->reader.read = sparse_read;
+  sparse->reader.ctx = sparse;
+  sparse->inner = inner;
+
+  ssize_t n =
+      libhoth_payload_read_full(inner, sparse->prefix, sizeof(sparse->prefix));
+  if (n < 0) {
+    return -1;
+  }
+  sparse->prefix_len = n;
+
+  struct libhoth_sparse_image_header header;
+  if ((size_t)n < sizeof(header)) {
+    return 0;
+  }
+  memcpy(&header, sparse->prefix, sizeof(header));
+  if (header.magic != LIBHOTH_SPARSE_IMAGE_MAGIC) {
+    return 0;
+  }
+  if (header.version != LIBHOTH_SPARSE_IMAGE_VERSION) {
+    fprintf(stderr, "Unsupported sparse image version %u\n", header.version);
+    return -1;
+  }
+  sparse->sparse = true;
+  sparse->image_size = header.image_size;
+  return 0;
+}
+
+uint64_t libhoth_sparse_reader_image_size(
+    const struct libhoth_sparse_reader* sparse) {
+  return sparse->image_size;
+}
+
+static int sparse_write(int fd, const void* buf, size_t len) {
+  const uint8_t* buf_u8 = (const uint8_t*)buf;
+  while (len > 0) {
+    ssize_t n = write(fd, buf_u8, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      perror("Failed to write sparse image");
+      return -1;
+    }
+    buf_u8 += n;
+    len -= n;
+  }
+  return 0;
+}
+
+int libhoth_sparse_image_encode(const uint8_t* image, size_t size, int fd) {
+  const struct libhoth_sparse_image_header header = {
+      .magic = LIBHOTH_SPARSE_IMAGE_MAGIC,
+      .version = LIBHOTH_SPARSE_IMAGE_VERSION,
+      .image_size = size,
+  };
+  if (sparse_write(fd, &header, sizeof(header)) != 0) {
+    return -1;
+  }
+
+  // Extents are made of the LIBHOTH_SPARSE_IMAGE_MIN_HOLE blocks that hold
+  // data, trimmed of the 0xFF bytes at either end.
+  size_t offset = 0;
+  while (offset < size) {
+    offset += libhoth_erased_prefix_len(image + offset, size - offset);
+    if (offset == size) {
+      break;
+    }
+    size_t end = offset;
+    while (end < size) {
+      size_t block_end = MIN(
+          (end / LIBHOTH_SPARSE_IMAGE_MIN_HOLE + 1) *
+              LIBHOTH_SPARSE_IMAGE_MIN_HOLE,
+          size);
+      end = block_end;
+      if (block_end == size) {
+        break;
+      }
+      // Stop before a block that is entirely erased.
+      size_t next_end = MIN(block_end + LIBHOTH_SPARSE_IMAGE_MIN_HOLE, size);
+      if (libhoth_erased_prefix_len(image + block_end, next_end - block_end) ==
+          next_end - block_end) {
+        break;
+      }
+    }
+    end -= libhoth_erased_suffix_len(image + offset, end - offset);
+
+    const struct libhoth_sparse_image_extent extent = {
+        .offset = offset,
+        .len = end - offset,
+    };
+    if (sparse_write(fd, &extent, sizeof(extent)) != 0 ||
+        sparse_write(fd, image + offset, extent.len) != 0) {
+      return -1;
+    }
+    offset = end;
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LIBHOTH_PROTOCOL_SPARSE_IMAGE_H_
+#define _LIBHOTH_PROTOCOL_SPARSE_IMAGE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "payload_reader.h"
+
+// A sparse image stores only the parts of a flash image that aren't erased.
+// It's a header followed by extents, each an extent header and then `len`
+// bytes of data. Extents are in increasing offset order and don't overlap;
+// every byte of the image outside them is 0xFF. All fields are little-endian.
+
+#define LIBHOTH_SPARSE_IMAGE_MAGIC 0x5f5352415053485f  // "_HSPARS_"
+#define LIBHOTH_SPARSE_IMAGE_VERSION 1
+
+// Runs of 0xFF at least this long become holes when encoding.
+#define LIBHOTH_SPARSE_IMAGE_MIN_HOLE 4096
+
+struct libhoth_sparse_image_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t reserved;
+  // Size of the expanded image.
+  uint64_t image_size;
+} __attribute__((packed));
+
+struct libhoth_sparse_image_extent {
+  uint64_t offset;
+  uint64_t len;
+} __attribute__((packed));
+
+// Reads an image that may or may not be sparse from `inner`, and expands it.
+// Images that aren't sparse are passed through unchanged.
+struct libhoth_sparse_reader {
+  // Reads the expanded image.
+  struct libhoth_payload_reader reader;
+
+  // Private
+  const struct libhoth_payload_reader* inner;
+  bool sparse;
+  // Start of a plain image, read to check for the magic.
+  uint8_t prefix[sizeof(struct libhoth_sparse_image_header)];
+  size_t prefix_len;
+  size_t prefix_pos;
+  uint64_t image_size;
+  // Position in the expanded image.
+  uint64_t pos;
+  struct libhoth_sparse_image_extent extent;
+  bool have_extent;
+  bool inner_done;
+};
+
+// Reads the start of `inner` to find out whether it is sparse. Returns 0 on
+// success, -1 on a read error or a bad sparse header. `inner` must outlive
+// `sparse`.
+int libhoth_sparse_reader_init(struct libhoth_sparse_reader* sparse,
+                               const struct libhoth_payload_reader* inner);
+
+// Returns the size of the expanded image, or 0 if the image isn't sparse and
+// its size isn't known up front.
+uint64_t libhoth_sparse_reader_image_size(
+    const struct libhoth_sparse_reader* sparse);
+
+// Writes `image` to `fd` as a sparse image. Returns 0 on success, -1 on error.
+int libhoth_sparse_image_encode(const uint8_t* image, size_t size, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _LIBHOTH_PROTOCOL_SPARSE_IMAGE_H_
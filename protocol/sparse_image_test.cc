@@ -0,0 +1,161 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sparse_image.h"
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "payload_reader.h"
+
+namespace {
+
+struct MemoryReader {
+  std::vector<uint8_t> data;
+  size_t offset = 0;
+  // Largest read to hand out, to exercise partial reads.
+  size_t max_read = 1000;
+
+  static ssize_t Read(void* ctx, void* buf, size_t len) {
+    auto* self = static_cast<MemoryReader*>(ctx);
+    len = std::min({len, self->data.size() - self->offset, self->max_read});
+    std::memcpy(buf, self->data.data() + self->offset, len);
+    self->offset += len;
+    return len;
+  }
+};
+
+std::vector<uint8_t> Encode(const std::vector<uint8_t>& image) {
+  FILE* file = tmpfile();
+  EXPECT_NE(file, nullptr);
+  EXPECT_EQ(libhoth_sparse_image_encode(image.data(), image.size(),
+                                        fileno(file)),
+            0);
+  struct stat statbuf;
+  EXPECT_EQ(fstat(fileno(file), &statbuf), 0);
+  std::vector<uint8_t> encoded(statbuf.st_size);
+  EXPECT_EQ(pread(fileno(file), encoded.data(), encoded.size(), 0),
+            static_cast<ssize_t>(encoded.size()));
+  fclose(file);
+  return encoded;
+}
+
+std::vector<uint8_t> ReadAll(MemoryReader* inner, uint64_t* image_size) {
+  const struct libhoth_payload_reader inner_reader = {
+      .read = MemoryReader::Read,
+      .ctx = inner,
+  };
+  struct libhoth_sparse_reader sparse;
+  EXPECT_EQ(libhoth_sparse_reader_init(&sparse, &inner_reader), 0);
+  *image_size = libhoth_sparse_reader_image_size(&sparse);
+
+  std::vector<uint8_t> result;
+  uint8_t buf[777];
+  while (true) {
+    ssize_t n = sparse.reader.read(sparse.reader.ctx, buf, sizeof(buf));
+    EXPECT_GE(n, 0);
+    if (n <= 0) {
+      break;
+    }
+    result.insert(result.end(), buf, buf + n);
+  }
+  return result;
+}
+
+TEST(SparseImageTest, RoundTrip) {
+  std::vector<uint8_t> image(100000, 0xFF);
+  image[5] = 1;
+  image[6000] = 2;
+  image[6001] = 0xFF;
+  image[6002] = 3;
+  image[99999] = 4;
+
+  MemoryReader inner = {.data = Encode(image)};
+  // The holes aren't stored.
+  EXPECT_LT(inner.data.size(), 10000);
+
+  uint64_t image_size;
+  EXPECT_EQ(ReadAll(&inner, &image_size), image);
+  EXPECT_EQ(image_size, image.size());
+}
+
+TEST(SparseImageTest, AllErased) {
+  std::vector<uint8_t> image(10000, 0xFF);
+  MemoryReader inner = {.data = Encode(image)};
+  EXPECT_EQ(inner.data.size(), sizeof(struct libhoth_sparse_image_header));
+
+  uint64_t image_size;
+  EXPECT_EQ(ReadAll(&inner, &image_size), image);
+}
+
+TEST(SparseImageTest, PlainImagePassesThrough) {
+  std::vector<uint8_t> image(5000);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = i;
+  }
+  MemoryReader inner = {.data = image};
+
+  uint64_t image_size;
+  EXPECT_EQ(ReadAll(&inner, &image_size), image);
+  EXPECT_EQ(image_size, 0);
+}
+
+TEST(SparseImageTest, ShortPlainImagePassesThrough) {
+  std::vector<uint8_t> image = {1, 2, 3};
+  MemoryReader inner = {.data = image};
+
+  uint64_t image_size;
+  EXPECT_EQ(ReadAll(&inner, &image_size), image);
+}
+
+// Returns the result of the first read from a sparse image of 100 bytes
+// whose only extent is `extent`.
+ssize_t ReadWithExtent(const struct libhoth_sparse_image_extent& extent) {
+  const struct libhoth_sparse_image_header header = {
+      .magic = LIBHOTH_SPARSE_IMAGE_MAGIC,
+      .version = LIBHOTH_SPARSE_IMAGE_VERSION,
+      .image_size = 100,
+  };
+  MemoryReader inner;
+  inner.data.resize(sizeof(header) + sizeof(extent) + extent.len);
+  std::memcpy(inner.data.data(), &header, sizeof(header));
+  std::memcpy(inner.data.data() + sizeof(header), &extent, sizeof(extent));
+
+  const struct libhoth_payload_reader inner_reader = {
+      .read = MemoryReader::Read,
+      .ctx = &inner,
+  };
+  struct libhoth_sparse_reader sparse;
+  EXPECT_EQ(libhoth_sparse_reader_init(&sparse, &inner_reader), 0);
+  uint8_t buf[200];
+  return sparse.reader.read(sparse.reader.ctx, buf, sizeof(buf));
+}
+
+TEST(SparseImageTest, BadExtentIsRejected) {
+  EXPECT_EQ(ReadWithExtent({.offset = 90, .len = 20}), -1);
+}
+
+TEST(SparseImageTest, EmptyExtentIsRejected) {
+  // Would otherwise read as the end of the image.
+  EXPECT_EQ(ReadWithExtent({.offset = 0, .len = 0}), -1);
+}
+
+}  // namespace
@@ -0,0 +1,339 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spi_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Lines are kept in an open-addressing hash table with linear probing.
+struct spi_cache_entry {
+  bool used;
+  uint32_t addr;
+  uint8_t data[LIBHOTH_SPI_CACHE_LINE_SIZE];
+};
+
+struct libhoth_spi_cache {
+  struct spi_cache_entry* entries;
+  // A power of two.
+  size_t capacity;
+  size_t num_lines;
+};
+
+#define SPI_CACHE_INITIAL_CAPACITY 64
+
+static size_t spi_cache_slot(const struct libhoth_spi_cache* cache,
+                             uint32_t addr) {
+  const uint32_t line = addr / LIBHOTH_SPI_CACHE_LINE_SIZE;
+  return (size_t)(line * 0x9e3779b1u) & (cache->capacity - 1);
+}
+
+static struct spi_cache_entry* spi_cache_find(
+    const struct libhoth_spi_cache* cache, uint32_t addr) {
+  const uint32_t line_addr = addr - addr % LIBHOTH_SPI_CACHE_LINE_SIZE;
+  for (size_t i = spi_cache_slot(cache, line_addr);;
+       i = (i + 1) & (cache->capacity - 1)) {
+    struct spi_cache_entry* entry = &cache->entries[i];
+    if (!entry->used) {
+      return NULL;
+    }
+    if (entry->addr == line_addr) {
+      return entry;
+    }
+  }
+}
+
+// Returns the entry for `line_addr`, claiming a free one if it isn't cached.
+static struct spi_cache_entry* spi_cache_claim(struct libhoth_spi_cache* cache,
+                                               uint32_t line_addr) {
+  for (size_t i = spi_cache_slot(cache, line_addr);;
+       i = (i + 1) & (cache->capacity - 1)) {
+    struct spi_cache_entry* entry = &cache->entries[i];
+    if (!entry->used) {
+      entry->used = true;
+      entry->addr = line_addr;
+      cache->num_lines++;
+      return entry;
+    }
+    if (entry->addr == line_addr) {
+      return entry;
+    }
+  }
+}
+
+static int spi_cache_grow(struct libhoth_spi_cache* cache) {
+  struct libhoth_spi_cache grown = {
+      .capacity = cache->capacity * 2,
+  };
+  grown.entries = calloc(grown.capacity, sizeof(struct spi_cache_entry));
+  if (grown.entries == NULL) {
+    return -1;
+  }
+  for (size_t i = 0; i < cache->capacity; i++) {
+    const struct spi_cache_entry* entry = &cache->entries[i];
+    if (entry->used) {
+      memcpy(spi_cache_claim(&grown, entry->addr)->data, entry->data,
+             sizeof(entry->data));
+    }
+  }
+  free(cache->entries);
+  *cache = grown;
+  return 0;
+}
+
+int libhoth_spi_cache_create(struct libhoth_spi_cache** out) {
+  struct libhoth_spi_cache* cache = calloc(1, sizeof(struct libhoth_spi_cache));
+  if (cache == NULL) {
+    return -1;
+  }
+  cache->capacity = SPI_CACHE_INITIAL_CAPACITY;
+  cache->entries = calloc(cache->capacity, sizeof(struct spi_cache_entry));
+  if (cache->entries == NULL) {
+    free(cache);
+    return -1;
+  }
+  *out = cache;
+  return 0;
+}
+
+void libhoth_spi_cache_destroy(struct libhoth_spi_cache* cache) {
+  if (cache == NULL) {
+    return;
+  }
+  free(cache->entries);
+  free(cache);
+}
+
+bool libhoth_spi_cache_contains(const struct libhoth_spi_cache* cache,
+                                uint32_t addr) {
+  return spi_cache_find(cache, addr) != NULL;
+}
+
+bool libhoth_spi_cache_read(const struct libhoth_spi_cache* cache,
+                            uint32_t addr, void* buf, size_t len) {
+  uint8_t* cbuf = (uint8_t*)buf;
+  while (len > 0) {
+    const struct spi_cache_entry* entry = spi_cache_find(cache, addr);
+    if (entry == NULL) {
+      return false;
+    }
+    const size_t offset = addr % LIBHOTH_SPI_CACHE_LINE_SIZE;
+    const size_t n = LIBHOTH_SPI_CACHE_LINE_SIZE - offset < len
+                         ? LIBHOTH_SPI_CACHE_LINE_SIZE - offset
+                         : len;
+    memcpy(cbuf, &entry->data[offset], n);
+    cbuf += n;
+    addr += n;
+    len -= n;
+  }
+  return true;
+}
+
+int libhoth_spi_cache_insert(struct libhoth_spi_cache* cache, uint32_t addr,
+                             const void* data, size_t len) {
+  if (addr % LIBHOTH_SPI_CACHE_LINE_SIZE != 0 ||
+      len % LIBHOTH_SPI_CACHE_LINE_SIZE != 0) {
+    fprintf(stderr, "Unaligned SPI cache insert: 0x%08lx+%zu\n",
+            (unsigned long)addr, len);
+    return -1;
+  }
+  const uint8_t* cdata = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i += LIBHOTH_SPI_CACHE_LINE_SIZE) {
+    // Keep the table at most half full.
+    if ((cache->num_lines + 1) * 2 > cache->capacity &&
+        spi_cache_grow(cache) != 0) {
+      return -1;
+    }
+    memcpy(spi_cache_claim(cache, addr + i)->data, &cdata[i],
+           LIBHOTH_SPI_CACHE_LINE_SIZE);
+  }
+  return 0;
+}
+
+// Removes `entry`, moving later entries of its probe sequence back so that
+// they can still be found.
+static void spi_cache_remove(struct libhoth_spi_cache* cache,
+                             struct spi_cache_entry* entry) {
+  const size_t mask = cache->capacity - 1;
+  size_t hole = entry - cache->entries;
+  cache->entries[hole].used = false;
+  cache->num_lines--;
+  for (size_t i = (hole + 1) & mask; cache->entries[i].used;
+       i = (i + 1) & mask) {
+    const size_t home = spi_cache_slot(cache, cache->entries[i].addr);
+    // Move the entry if the hole lies between its home slot and where it is.
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      cache->entries[hole] = cache->entries[i];
+      cache->entries[i].used = false;
+      hole = i;
+    }
+  }
+}
+
+void libhoth_spi_cache_invalidate(struct libhoth_spi_cache* cache,
+                                  uint32_t addr, size_t len) {
+  if (len == 0) {
+    return;
+  }
+  const uint64_t end = (uint64_t)addr + len;
+  uint64_t line_addr = addr - addr % LIBHOTH_SPI_CACHE_LINE_SIZE;
+  if ((end - line_addr) / LIBHOTH_SPI_CACHE_LINE_SIZE > cache->num_lines) {
+    // Cheaper to look at every cached line than every line of the range.
+    for (size_t i = 0; i < cache->capacity;) {
+      struct spi_cache_entry* entry = &cache->entries[i];
+      if (entry->used &&
+          (uint64_t)entry->addr + LIBHOTH_SPI_CACHE_LINE_SIZE > addr &&
+          entry->addr < end) {
+        // Another entry may have moved into this slot.
+        spi_cache_remove(cache, entry);
+        continue;
+      }
+      i++;
+    }
+    return;
+  }
+  for (; line_addr < end; line_addr += LIBHOTH_SPI_CACHE_LINE_SIZE) {
+    struct spi_cache_entry* entry = spi_cache_find(cache, line_addr);
+    if (entry != NULL) {
+      spi_cache_remove(cache, entry);
+    }
+  }
+}
+
+static bool spi_cache_read_exact(int fd, void* buf, size_t len) {
+  uint8_t* cbuf = (uint8_t*)buf;
+  while (len > 0) {
+    ssize_t n = read(fd, cbuf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    cbuf += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool spi_cache_write_exact(int fd, const void* buf, size_t len) {
+  const uint8_t* cbuf = (const uint8_t*)buf;
+  while (len > 0) {
+    ssize_t n = write(fd, cbuf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    cbuf += n;
+    len -= n;
+  }
+  return true;
+}
+
+int libhoth_spi_cache_load(struct libhoth_spi_cache* cache, const char* path,
+                           const void* key, size_t key_len) {
+  for (size_t i = 0; i < cache->capacity; i++) {
+    cache->entries[i].used = false;
+  }
+  cache->num_lines = 0;
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      return 0;
+    }
+    fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  int status = 0;
+  struct libhoth_spi_cache_file_header header;
+  uint8_t* file_key = malloc(key_len);
+  if (file_key == NULL) {
+    status = -1;
+    goto cleanup;
+  }
+  if (!spi_cache_read_exact(fd, &header, sizeof(header)) ||
+      header.magic != LIBHOTH_SPI_CACHE_MAGIC ||
+      header.version != LIBHOTH_SPI_CACHE_VERSION ||
+      header.key_len != key_len ||
+      !spi_cache_read_exact(fd, file_key, key_len) ||
+      memcmp(file_key, key, key_len) != 0) {
+    // Saved for other contents, or not a cache file at all.
+    goto cleanup;
+  }
+  for (uint64_t i = 0; i < header.num_lines; i++) {
+    uint32_t addr;
+    uint8_t data[LIBHOTH_SPI_CACHE_LINE_SIZE];
+    if (!spi_cache_read_exact(fd, &addr, sizeof(addr)) ||
+        !spi_cache_read_exact(fd, data, sizeof(data))) {
+      fprintf(stderr, "SPI cache file %s is truncated\n", path);
+      break;
+    }
+    if (libhoth_spi_cache_insert(cache, addr, data, sizeof(data)) != 0) {
+      status = -1;
+      break;
+    }
+  }
+
+cleanup:
+  free(file_key);
+  close(fd);
+  return status;
+}
+
+int libhoth_spi_cache_save(const struct libhoth_spi_cache* cache,
+                           const char* path, const void* key, size_t key_len) {
+  char tmp_path[PATH_MAX];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+      (int)sizeof(tmp_path)) {
+    fprintf(stderr, "SPI cache path too long\n");
+    return -1;
+  }
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to open %s: %s\n", tmp_path, strerror(errno));
+    return -1;
+  }
+  const struct libhoth_spi_cache_file_header header = {
+      .magic = LIBHOTH_SPI_CACHE_MAGIC,
+      .version = LIBHOTH_SPI_CACHE_VERSION,
+      .key_len = key_len,
+      .num_lines = cache->num_lines,
+  };
+  bool ok = spi_cache_write_exact(fd, &header, sizeof(header)) &&
+            spi_cache_write_exact(fd, key, key_len);
+  for (size_t i = 0; ok && i < cache->capacity; i++) {
+    const struct spi_cache_entry* entry = &cache->entries[i];
+    if (entry->used) {
+      ok = spi_cache_write_exact(fd, &entry->addr, sizeof(entry->addr)) &&
+           spi_cache_write_exact(fd, entry->data, sizeof(entry->data));
+    }
+  }
+  ok = ok && fsync(fd) == 0;
+  close(fd);
+  if (!ok || rename(tmp_path, path) != 0) {
+    fprintf(stderr, "Failed to write SPI cache %s: %s\n", path,
+            strerror(errno));
+    unlink(tmp_path);
+    return -1;
+  }
+  return 0;
+}
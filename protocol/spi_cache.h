@@ -0,0 +1,83 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LIBHOTH_PROTOCOL_SPI_CACHE_H_
+#define _LIBHOTH_PROTOCOL_SPI_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A cache of SPI flash contents, kept in aligned lines of
+// LIBHOTH_SPI_CACHE_LINE_SIZE bytes. It can be saved to a file and loaded
+// again later, tagged with a key that identifies the flash and its contents,
+// so that a stale file is never used.
+
+#define LIBHOTH_SPI_CACHE_LINE_SIZE 256
+
+#define LIBHOTH_SPI_CACHE_MAGIC 0x5f4143495053485f  // "_HSPICA_"
+#define LIBHOTH_SPI_CACHE_VERSION 1
+
+// The file starts with this header and the key, followed by `num_lines`
+// lines, each a little-endian uint32_t address and then the line's data.
+struct libhoth_spi_cache_file_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t key_len;
+  uint64_t num_lines;
+} __attribute__((packed));
+
+struct libhoth_spi_cache;
+
+int libhoth_spi_cache_create(struct libhoth_spi_cache** out);
+
+void libhoth_spi_cache_destroy(struct libhoth_spi_cache* cache);
+
+// Copies `len` bytes at `addr` from the cache into `buf`. Returns false,
+// leaving `buf` partly written, unless every line of the range is cached.
+bool libhoth_spi_cache_read(const struct libhoth_spi_cache* cache,
+                            uint32_t addr, void* buf, size_t len);
+
+// Whether the line holding `addr` is cached.
+bool libhoth_spi_cache_contains(const struct libhoth_spi_cache* cache,
+                                uint32_t addr);
+
+// Caches `len` bytes at `addr`, which must both be multiples of
+// LIBHOTH_SPI_CACHE_LINE_SIZE.
+int libhoth_spi_cache_insert(struct libhoth_spi_cache* cache, uint32_t addr,
+                             const void* data, size_t len);
+
+// Drops every line that overlaps `len` bytes at `addr`.
+void libhoth_spi_cache_invalidate(struct libhoth_spi_cache* cache,
+                                  uint32_t addr, size_t len);
+
+// Replaces the contents of `cache` with those saved in `path` with the same
+// `key`. A missing file, or one saved with another key, leaves the cache
+// empty and isn't an error.
+int libhoth_spi_cache_load(struct libhoth_spi_cache* cache, const char* path,
+                           const void* key, size_t key_len);
+
+// Saves `cache` to `path`, replacing it atomically.
+int libhoth_spi_cache_save(const struct libhoth_spi_cache* cache,
+                           const char* path, const void* key, size_t key_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _LIBHOTH_PROTOCOL_SPI_CACHE_H_
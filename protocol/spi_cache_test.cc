@@ -0,0 +1,144 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spi_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kLine = LIBHOTH_SPI_CACHE_LINE_SIZE;
+
+std::vector<uint8_t> MakeData(size_t size, uint8_t seed) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<uint8_t>(i * 7 + seed);
+  }
+  return data;
+}
+
+class SpiCacheTest : public testing::Test {
+ protected:
+  void SetUp() override { ASSERT_EQ(libhoth_spi_cache_create(&cache_), 0); }
+  void TearDown() override { libhoth_spi_cache_destroy(cache_); }
+
+  struct libhoth_spi_cache* cache_ = nullptr;
+};
+
+TEST_F(SpiCacheTest, read_needs_every_line) {
+  auto data = MakeData(4 * kLine, 1);
+  ASSERT_EQ(libhoth_spi_cache_insert(cache_, 0x1000, data.data(), data.size()),
+            0);
+
+  std::vector<uint8_t> buf(2 * kLine);
+  ASSERT_TRUE(
+      libhoth_spi_cache_read(cache_, 0x1000 + 10, buf.data(), buf.size()));
+  EXPECT_EQ(buf, std::vector<uint8_t>(data.begin() + 10,
+                                      data.begin() + 10 + buf.size()));
+
+  EXPECT_TRUE(libhoth_spi_cache_contains(cache_, 0x1000 + 4 * kLine - 1));
+  EXPECT_FALSE(libhoth_spi_cache_contains(cache_, 0x1000 + 4 * kLine));
+  EXPECT_FALSE(libhoth_spi_cache_read(cache_, 0x1000 + 3 * kLine, buf.data(),
+                                      buf.size()));
+  EXPECT_FALSE(libhoth_spi_cache_contains(cache_, 0x1000 - 1));
+}
+
+TEST_F(SpiCacheTest, insert_rejects_unaligned) {
+  auto data = MakeData(kLine, 1);
+  EXPECT_NE(libhoth_spi_cache_insert(cache_, 0x10, data.data(), kLine), 0);
+  EXPECT_NE(libhoth_spi_cache_insert(cache_, 0, data.data(), kLine - 1), 0);
+}
+
+TEST_F(SpiCacheTest, insert_replaces_line) {
+  auto first = MakeData(kLine, 1);
+  auto second = MakeData(kLine, 2);
+  ASSERT_EQ(libhoth_spi_cache_insert(cache_, 0, first.data(), kLine), 0);
+  ASSERT_EQ(libhoth_spi_cache_insert(cache_, 0, second.data(), kLine), 0);
+
+  std::vector<uint8_t> buf(kLine);
+  ASSERT_TRUE(libhoth_spi_cache_read(cache_, 0, buf.data(), buf.size()));
+  EXPECT_EQ(buf, second);
+}
+
+TEST_F(SpiCacheTest, invalidate_drops_overlapping_lines) {
+  // Enough lines to grow the table several times.
+  auto data = MakeData(1024 * kLine, 3);
+  ASSERT_EQ(libhoth_spi_cache_insert(cache_, 0, data.data(), data.size()), 0);
+
+  // A small range drops the lines it touches, including partial ones.
+  libhoth_spi_cache_invalidate(cache_, 10 * kLine + 1, kLine);
+  EXPECT_TRUE(libhoth_spi_cache_contains(cache_, 9 * kLine));
+  EXPECT_FALSE(libhoth_spi_cache_contains(cache_, 10 * kLine));
+  EXPECT_FALSE(libhoth_spi_cache_contains(cache_, 11 * kLine));
+  EXPECT_TRUE(libhoth_spi_cache_contains(cache_, 12 * kLine));
+
+  // A range larger than the cache scans the table instead.
+  libhoth_spi_cache_invalidate(cache_, 512 * kLine, 0x10000000);
+  EXPECT_TRUE(libhoth_spi_cache_contains(cache_, 511 * kLine));
+  EXPECT_FALSE(libhoth_spi_cache_contains(cache_, 512 * kLine));
+  EXPECT_FALSE(libhoth_spi_cache_contains(cache_, 1023 * kLine));
+
+  // Every remaining line is still found after the removals.
+  std::vector<uint8_t> buf(kLine);
+  for (size_t i = 0; i < 512; i++) {
+    if (i == 10 || i == 11) {
+      continue;
+    }
+    ASSERT_TRUE(libhoth_spi_cache_read(cache_, i * kLine, buf.data(), kLine))
+        << i;
+    EXPECT_EQ(buf, std::vector<uint8_t>(data.begin() + i * kLine,
+                                        data.begin() + (i + 1) * kLine));
+  }
+}
+
+TEST_F(SpiCacheTest, save_and_load) {
+  const std::string path = testing::TempDir() + "/spi_cache_save_and_load";
+  const std::string key = "flash-a";
+  auto data = MakeData(8 * kLine, 4);
+  ASSERT_EQ(libhoth_spi_cache_insert(cache_, 0x20000, data.data(), data.size()),
+            0);
+  ASSERT_EQ(libhoth_spi_cache_save(cache_, path.c_str(), key.data(),
+                                   key.size()),
+            0);
+
+  struct libhoth_spi_cache* loaded;
+  ASSERT_EQ(libhoth_spi_cache_create(&loaded), 0);
+  ASSERT_EQ(libhoth_spi_cache_load(loaded, path.c_str(), key.data(),
+                                   key.size()),
+            0);
+  std::vector<uint8_t> buf(data.size());
+  ASSERT_TRUE(
+      libhoth_spi_cache_read(loaded, 0x20000, buf.data(), buf.size()));
+  EXPECT_EQ(buf, data);
+
+  // A file saved for other contents is ignored.
+  const std::string other_key = "flash-b";
+  ASSERT_EQ(libhoth_spi_cache_load(loaded, path.c_str(), other_key.data(),
+                                   other_key.size()),
+            0);
+  EXPECT_FALSE(libhoth_spi_cache_contains(loaded, 0x20000));
+
+  // As is a missing one.
+  ASSERT_EQ(libhoth_spi_cache_load(loaded, (path + ".missing").c_str(),
+                                   key.data(), key.size()),
+            0);
+  EXPECT_FALSE(libhoth_spi_cache_contains(loaded, 0x20000));
+  libhoth_spi_cache_destroy(loaded);
+}
+
+}  // namespace
@@ -13,14 +13,21 @@
 // limitations under the License.
 
 #include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 // for MIN()
 #include <sys/param.h>
+#include <unistd.h>
 
+#include "erased.h"
 #include "host_cmd.h"
+#include "payload_info.h"
+#include "payload_reader.h"
+#include "spi_cache.h"
 #include "spi_proxy.h"
 
 const uint8_t SPI_OP_PAGE_PROGRAM = 0x02;
@@ -30,6 +37,7 @@ const uint8_t SPI_OP_ERASE_64K = 0xd8;
 const uint8_t SPI_OP_WRITE_ENABLE = 0x06;
 const uint8_t SPI_OP_ENTER_4B = 0xb7;
 const uint8_t SPI_OP_READ_STATUS = 0x05;
+const uint8_t SPI_OP_READ_JEDEC_ID = 0x9f;
 
 struct spi_operation_transaction {
   size_t header_offset;
@@ -38,12 +46,23 @@ struct spi_operation_transaction {
   size_t miso_dest_buf_len;
 };
 
-#define MAX_TRANSACTIONS 12
-#define MAX_SPI_OP_PAYLOAD_BYTES 1016
+// An SPI_OPERATION request fills the mailbox, less the host command header,
+// and so does its response.
+#define MAX_SPI_OP_PAYLOAD_BYTES \
+  (LIBHOTH_MAILBOX_SIZE - sizeof(struct hoth_host_request))
+#define MAX_SPI_OP_RESPONSE_BYTES \
+  (LIBHOTH_MAILBOX_SIZE - sizeof(struct hoth_host_response))
+// Every transaction carries at least an opcode.
+#define MAX_TRANSACTIONS                    \
+  (MAX_SPI_OP_PAYLOAD_BYTES /               \
+   (sizeof(struct hoth_spi_operation_request) + 1))
 #define OPCODE_AND_ADDRESS_MAX_SIZE 5
+// A segment of a vectored read is only split across two SPI_OPERATIONs if at
+// least this much of it fits in the first.
+#define SPI_MIN_READ_LEN 64
 #define READ_CHUNK_SIZE                                                 \
-  (MAX_SPI_OP_PAYLOAD_BYTES - sizeof(struct hoth_spi_operation_request) - \
-   OPCODE_AND_ADDRESS_MAX_SIZE)
+  (MIN(MAX_SPI_OP_PAYLOAD_BYTES, MAX_SPI_OP_RESPONSE_BYTES) -           \
+   sizeof(struct hoth_spi_operation_request) - OPCODE_AND_ADDRESS_MAX_SIZE)
 
 struct spi_operation {
   uint8_t buf[MAX_SPI_OP_PAYLOAD_BYTES];
@@ -51,16 +70,19 @@ struct spi_operation {
 
   struct spi_operation_transaction transactions[MAX_TRANSACTIONS];
   size_t num_transactions;
+  // The size of the response.
+  size_t miso_len;
 };
 
 static void spi_operation_init(struct spi_operation* op) {
   op->pos = 0;
   op->num_transactions = 0;
+  op->miso_len = 0;
 }
 
 static int spi_operation_execute(struct spi_operation* op,
                                  struct libhoth_device* dev) {
-  uint8_t response_buf[MAX_SPI_OP_PAYLOAD_BYTES];
+  uint8_t response_buf[MAX_SPI_OP_RESPONSE_BYTES];
   size_t response_len;
 
   // hexdump(op->buf, op->pos);
@@ -74,17 +96,20 @@ static int spi_operation_execute(struct spi_operation* op,
   size_t pos = 0;
   for (size_t i = 0; i < op->num_transactions; i++) {
     struct spi_operation_transaction* transaction = &op->transactions[i];
+    // Transactions that don't read return no MISO bytes at all.
+    if (transaction->miso_dest_buf_len == 0) {
+      continue;
+    }
+    if (pos + transaction->skip_miso_nbytes + transaction->miso_dest_buf_len >
+        response_len) {
+      fprintf(stderr,
+              "returned SPI operation payload is smaller than expected");
+      return -1;
+    }
     if (transaction->miso_dest_buf) {
-      if (transaction->miso_dest_buf_len > 0) {
-        if (pos + transaction->miso_dest_buf_len > response_len) {
-          fprintf(stderr,
-                  "returned SPI operation payload is smaller than expected");
-          return -1;
-        }
-        memcpy(transaction->miso_dest_buf,
-               &response_buf[pos + transaction->skip_miso_nbytes],
-               transaction->miso_dest_buf_len);
-      }
+      memcpy(transaction->miso_dest_buf,
+             &response_buf[pos + transaction->skip_miso_nbytes],
+             transaction->miso_dest_buf_len);
     }
     pos += transaction->skip_miso_nbytes + transaction->miso_dest_buf_len;
   }
@@ -93,7 +118,8 @@ static int spi_operation_execute(struct spi_operation* op,
 
 static void spi_operation_begin_transaction(struct spi_operation* op) {
   assert(op->num_transactions < MAX_TRANSACTIONS);
-  assert(op->pos + sizeof(struct hoth_spi_operation_request) < sizeof(op->buf));
+  assert(op->pos + sizeof(struct hoth_spi_operation_request) <=
+         sizeof(op->buf));
 
   op->transactions[op->num_transactions] = (struct spi_operation_transaction){
       .header_offset = op->pos,
@@ -103,11 +129,25 @@ static void spi_operation_begin_transaction(struct spi_operation* op) {
 
 static void spi_operation_write_mosi(struct spi_operation* op, const void* mosi,
                                      size_t mosi_len) {
-  assert(op->pos + mosi_len < sizeof(op->buf));
+  assert(op->pos + mosi_len <= sizeof(op->buf));
   memcpy(&op->buf[op->pos], mosi, mosi_len);
   op->pos += mosi_len;
 }
 
+// Returns whether `num_transactions` more transactions, carrying `mosi_len`
+// MOSI bytes between them, fit in `op`.
+static bool spi_operation_fits(const struct spi_operation* op,
+                               size_t num_transactions, size_t mosi_len) {
+  return op->num_transactions + num_transactions <= MAX_TRANSACTIONS &&
+         op->pos + num_transactions * sizeof(struct hoth_spi_operation_request) +
+                 mosi_len <=
+             sizeof(op->buf);
+}
+
+static size_t spi_address_len(const struct libhoth_spi_proxy* spi) {
+  return spi->is_4_byte ? 4 : 3;
+}
+
 static void spi_operation_write_mosi_address(struct spi_operation* op,
                                              bool is_4_byte, uint32_t addr) {
   const uint8_t buf[4] = {
@@ -142,6 +182,7 @@ static void spi_operation_read_miso_and_end_transaction(
   };
   memcpy(&op->buf[transaction->header_offset], &req, sizeof(req));
 
+  op->miso_len += req.miso_len;
   op->num_transactions++;
 }
 
@@ -149,71 +190,368 @@ static void spi_operation_end_transaction(struct spi_operation* op) {
   spi_operation_read_miso_and_end_transaction(op, NULL, 0);
 }
 
-static int spi_read_chunk(const struct libhoth_spi_proxy* spi, uint32_t addr,
-                          void* buf, size_t len) {
+struct spi_read_inflight {
+  struct libhoth_hostcmd_op op;
+  uint8_t resp[MAX_SPI_OP_RESPONSE_BYTES];
+  uint32_t addr;
+  size_t len;
+  // MISO bytes clocked in while the opcode and address were sent.
+  size_t skip;
+};
+
+// Called by spi_read_pipelined() with each chunk, in address order.
+typedef int (*spi_read_chunk_fn)(void* ctx, uint32_t addr,
+                                 const uint8_t* data, size_t len);
+
+static int spi_read_submit(const struct libhoth_spi_proxy* spi,
+                           struct spi_read_inflight* inflight, uint32_t addr,
+                           size_t len) {
   struct spi_operation op;
   spi_operation_init(&op);
-
   spi_operation_begin_transaction(&op);
   spi_operation_write_mosi(&op, &SPI_OP_READ, sizeof(SPI_OP_READ));
   spi_operation_write_mosi_address(&op, spi->is_4_byte, addr);
-  spi_operation_read_miso_and_end_transaction(&op, buf, len);
+  spi_operation_read_miso_and_end_transaction(&op, NULL, len);
 
-  return spi_operation_execute(&op, spi->dev);
+  inflight->op = (struct libhoth_hostcmd_op){
+      .resp_buf = inflight->resp,
+      .resp_buf_size = sizeof(inflight->resp),
+  };
+  inflight->addr = addr;
+  inflight->len = len;
+  inflight->skip = sizeof(SPI_OP_READ) + spi_address_len(spi);
+  return libhoth_hostcmd_submit(
+      spi->dev, &inflight->op,
+      HOTH_CMD_BOARD_SPECIFIC_BASE + HOTH_PRV_CMD_HOTH_SPI_OPERATION,
+      /*version=*/0, op.buf, op.pos);
 }
 
-int libhoth_spi_proxy_read(const struct libhoth_spi_proxy* spi, uint32_t addr,
-                           void* buf, size_t len) {
-  uint8_t* cbuf = (uint8_t*)buf;
-  while (len > 0) {
-    size_t read_len = MIN(len, READ_CHUNK_SIZE);
-    int status = spi_read_chunk(spi, addr, cbuf, read_len);
-    if (status) {
-      return status;
+static int spi_read_wait(struct spi_read_inflight* inflight) {
+  if (!libhoth_hostcmd_poll(&inflight->op, HOTH_CMD_TIMEOUT_MS_DEFAULT)) {
+    fprintf(stderr, "Timed out waiting for SPI read\n");
+    return -1;
+  }
+  if (inflight->op.status != 0) {
+    return inflight->op.status;
+  }
+  if (inflight->op.resp_size < inflight->skip + inflight->len) {
+    fprintf(stderr, "returned SPI operation payload is smaller than expected");
+    return -1;
+  }
+  return 0;
+}
+
+// Reads `len` bytes at `addr`, keeping up to `spi->window` SPI_OPERATION
+// reads in flight, and hands each chunk to `fn` as it arrives.
+static int spi_read_pipelined(const struct libhoth_spi_proxy* spi,
+                              uint32_t addr, size_t len, spi_read_chunk_fn fn,
+                              void* ctx) {
+  size_t window = MAX(spi->window, 1);
+  if (window > LIBHOTH_SPI_PROXY_MAX_WINDOW) {
+    fprintf(stderr, "SPI read window too large: %zu > %d\n", window,
+            LIBHOTH_SPI_PROXY_MAX_WINDOW);
+    return -1;
+  }
+  // Any more would overwrite requests the transport hasn't answered yet.
+  window = MIN(window, (size_t)libhoth_device_queue_depth(spi->dev));
+  struct spi_read_inflight inflight[LIBHOTH_SPI_PROXY_MAX_WINDOW];
+  size_t head = 0;
+  size_t num_inflight = 0;
+
+  int status = 0;
+  while (len > 0 || num_inflight > 0) {
+    if (len > 0 && num_inflight < window) {
+      const size_t read_len = MIN(len, READ_CHUNK_SIZE);
+      status = spi_read_submit(spi, &inflight[(head + num_inflight) % window],
+                               addr, read_len);
+      if (status != 0) {
+        break;
+      }
+      num_inflight++;
+      addr += read_len;
+      len -= read_len;
+      continue;
+    }
+
+    struct spi_read_inflight* oldest = &inflight[head];
+    status = spi_read_wait(oldest);
+    head = (head + 1) % window;
+    num_inflight--;
+    if (status == 0) {
+      status = fn(ctx, oldest->addr, oldest->resp + oldest->skip, oldest->len);
     }
-    len -= read_len;
-    addr += read_len;
-    cbuf += read_len;
+    if (status != 0) {
+      break;
+    }
+  }
+
+  // Collect what's left after a failure, so no responses are left queued in
+  // the transport.
+  for (; num_inflight > 0; num_inflight--) {
+    spi_read_wait(&inflight[head]);
+    head = (head + 1) % window;
   }
+  return status;
+}
+
+static int spi_read_copy_chunk(void* ctx, uint32_t addr, const uint8_t* data,
+                               size_t len) {
+  uint8_t** dest = (uint8_t**)ctx;
+  memcpy(*dest, data, len);
+  *dest += len;
   return 0;
 }
 
-int libhoth_spi_proxy_verify(const struct libhoth_spi_proxy* spi, uint32_t addr,
-                             const void* buf, size_t len,
-                             const struct libhoth_progress* progress) {
-  uint8_t read_buf[READ_CHUNK_SIZE];
-  const uint8_t* cbuf = (const uint8_t*)buf;
-  size_t len_remaining = len;
+struct libhoth_spi_proxy_cache {
+  struct libhoth_spi_cache* lines;
+  // Where to save the cache, or NULL.
+  char* path;
+  // The flash JEDEC ID followed by the caller's key.
+  uint8_t* key;
+  size_t key_len;
+  // Whether an update went through the proxy, after which the key no longer
+  // describes the flash.
+  bool updated;
+};
 
-  uint32_t last_progress_addr = addr;
-  while (len_remaining > 0) {
-    size_t read_len = MIN(len_remaining, sizeof(read_buf));
-    int status = spi_read_chunk(spi, addr, read_buf, read_len);
-    if (status) {
-      return status;
+#define SPI_JEDEC_ID_LEN 3
+// The most a cache miss reads at once.
+#define SPI_CACHE_FILL_MAX 65536
+
+static uint64_t spi_cache_line_floor(uint64_t addr) {
+  return addr - addr % LIBHOTH_SPI_CACHE_LINE_SIZE;
+}
+
+static uint64_t spi_cache_line_ceil(uint64_t addr) {
+  return spi_cache_line_floor(addr + LIBHOTH_SPI_CACHE_LINE_SIZE - 1);
+}
+
+// Reads the lines of `len` bytes at `addr` that aren't cached yet into the
+// cache, a run of missing lines at a time.
+static int spi_cache_fill(const struct libhoth_spi_proxy* spi, uint32_t addr,
+                          size_t len) {
+  struct libhoth_spi_cache* lines = spi->cache->lines;
+  uint64_t line = spi_cache_line_floor(addr);
+  const uint64_t end = spi_cache_line_ceil((uint64_t)addr + len);
+  uint8_t* run_buf = NULL;
+  int status = 0;
+  while (line < end) {
+    if (libhoth_spi_cache_contains(lines, line)) {
+      line += LIBHOTH_SPI_CACHE_LINE_SIZE;
+      continue;
     }
-    for (size_t i = 0; i < read_len; i++) {
-      if (cbuf[i] != read_buf[i]) {
-        fprintf(stderr,
-                "Verification failed at address 0x%08lx: expected 0x%02x but "
-                "was 0x%02x\n",
-                (unsigned long)(addr + i), cbuf[i], read_buf[i]);
+    const uint64_t run_start = line;
+    while (line < end && line - run_start < SPI_CACHE_FILL_MAX &&
+           !libhoth_spi_cache_contains(lines, line)) {
+      line += LIBHOTH_SPI_CACHE_LINE_SIZE;
+    }
+    if (run_buf == NULL) {
+      run_buf = malloc(SPI_CACHE_FILL_MAX);
+      if (run_buf == NULL) {
         return -1;
       }
     }
-    len_remaining -= read_len;
-    addr += read_len;
-    cbuf += read_len;
+    uint8_t* dest = run_buf;
+    status = spi_read_pipelined(spi, run_start, line - run_start,
+                                spi_read_copy_chunk, &dest);
+    if (status == 0) {
+      status = libhoth_spi_cache_insert(lines, run_start, run_buf,
+                                        line - run_start);
+    }
+    if (status != 0) {
+      break;
+    }
+  }
+  free(run_buf);
+  return status;
+}
+
+int libhoth_spi_proxy_read(const struct libhoth_spi_proxy* spi, uint32_t addr,
+                           void* buf, size_t len) {
+  if (spi->cache == NULL) {
+    uint8_t* dest = (uint8_t*)buf;
+    return spi_read_pipelined(spi, addr, len, spi_read_copy_chunk, &dest);
+  }
+  int status = spi_cache_fill(spi, addr, len);
+  if (status != 0) {
+    return status;
+  }
+  if (!libhoth_spi_cache_read(spi->cache->lines, addr, buf, len)) {
+    return -1;
+  }
+  return 0;
+}
 
-    if (progress &&
-        (len_remaining == 0 || addr >= last_progress_addr + 65536)) {
-      last_progress_addr = addr;
-      progress->func(progress->param, len - len_remaining, len);
+static int spi_readv_uncached(const struct libhoth_spi_proxy* spi,
+                              const struct libhoth_spi_proxy_segment* segs,
+                              size_t num_segs) {
+  const size_t mosi_len = sizeof(SPI_OP_READ) + spi_address_len(spi);
+  struct spi_operation op;
+  spi_operation_init(&op);
+  for (size_t i = 0; i < num_segs; i++) {
+    uint32_t addr = segs[i].addr;
+    uint8_t* buf = (uint8_t*)segs[i].buf;
+    size_t len = segs[i].len;
+    while (len > 0) {
+      // Each read returns its opcode and address bytes ahead of the data.
+      size_t miso_room = 0;
+      if (spi_operation_fits(&op, 1, mosi_len) &&
+          op.miso_len + mosi_len < MAX_SPI_OP_RESPONSE_BYTES) {
+        miso_room = MAX_SPI_OP_RESPONSE_BYTES - op.miso_len - mosi_len;
+      }
+      if (miso_room < MIN(len, SPI_MIN_READ_LEN)) {
+        int status = spi_operation_execute(&op, spi->dev);
+        if (status) {
+          return status;
+        }
+        spi_operation_init(&op);
+        continue;
+      }
+      const size_t read_len = MIN(len, miso_room);
+      spi_operation_begin_transaction(&op);
+      spi_operation_write_mosi(&op, &SPI_OP_READ, sizeof(SPI_OP_READ));
+      spi_operation_write_mosi_address(&op, spi->is_4_byte, addr);
+      spi_operation_read_miso_and_end_transaction(&op, buf, read_len);
+      addr += read_len;
+      buf += read_len;
+      len -= read_len;
     }
   }
+  if (op.num_transactions > 0) {
+    return spi_operation_execute(&op, spi->dev);
+  }
   return 0;
 }
 
+// Reads the whole lines of the segments that aren't all cached in one go with
+// spi_readv_uncached(), caches them, and then serves every segment from the
+// cache.
+static int spi_readv_cached(const struct libhoth_spi_proxy* spi,
+                            const struct libhoth_spi_proxy_segment* segs,
+                            size_t num_segs) {
+  struct libhoth_spi_cache* lines = spi->cache->lines;
+  struct libhoth_spi_proxy_segment* misses =
+      calloc(num_segs, sizeof(struct libhoth_spi_proxy_segment));
+  if (num_segs > 0 && misses == NULL) {
+    return -1;
+  }
+  size_t num_misses = 0;
+  size_t miss_len = 0;
+  for (size_t i = 0; i < num_segs; i++) {
+    const uint64_t start = spi_cache_line_floor(segs[i].addr);
+    const uint64_t end =
+        spi_cache_line_ceil((uint64_t)segs[i].addr + segs[i].len);
+    for (uint64_t line = start; line < end;
+         line += LIBHOTH_SPI_CACHE_LINE_SIZE) {
+      if (!libhoth_spi_cache_contains(lines, line)) {
+        misses[num_misses++] = (struct libhoth_spi_proxy_segment){
+            .addr = start,
+            .len = end - start,
+        };
+        miss_len += end - start;
+        break;
+      }
+    }
+  }
+
+  int status = 0;
+  uint8_t* miss_buf = NULL;
+  if (num_misses > 0) {
+    miss_buf = malloc(miss_len);
+    if (miss_buf == NULL) {
+      status = -1;
+      goto cleanup;
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < num_misses; i++) {
+      misses[i].buf = &miss_buf[offset];
+      offset += misses[i].len;
+    }
+    status = spi_readv_uncached(spi, misses, num_misses);
+    for (size_t i = 0; status == 0 && i < num_misses; i++) {
+      status = libhoth_spi_cache_insert(lines, misses[i].addr, misses[i].buf,
+                                        misses[i].len);
+    }
+    if (status != 0) {
+      goto cleanup;
+    }
+  }
+  for (size_t i = 0; i < num_segs; i++) {
+    if (!libhoth_spi_cache_read(lines, segs[i].addr, segs[i].buf,
+                                segs[i].len)) {
+      status = -1;
+      break;
+    }
+  }
+
+cleanup:
+  free(miss_buf);
+  free(misses);
+  return status;
+}
+
+int libhoth_spi_proxy_readv(const struct libhoth_spi_proxy* spi,
+                            const struct libhoth_spi_proxy_segment* segs,
+                            size_t num_segs) {
+  if (spi->cache == NULL) {
+    return spi_readv_uncached(spi, segs, num_segs);
+  }
+  return spi_readv_cached(spi, segs, num_segs);
+}
+
+struct spi_verify_ctx {
+  const uint8_t* expected;
+  uint32_t start_addr;
+  size_t len;
+  uint32_t last_progress_addr;
+  const struct libhoth_progress* progress;
+};
+
+static int spi_verify_chunk(void* ctx, uint32_t addr, const uint8_t* data,
+                            size_t len) {
+  struct spi_verify_ctx* verify = (struct spi_verify_ctx*)ctx;
+  const size_t offset = addr - verify->start_addr;
+  const uint8_t* expected = verify->expected + offset;
+  if (memcmp(expected, data, len) != 0) {
+    size_t first = 0;
+    while (expected[first] == data[first]) {
+      first++;
+    }
+    size_t end = first + 1;
+    while (end < len && expected[end] != data[end]) {
+      end++;
+    }
+    fprintf(stderr,
+            "Verification failed at addresses 0x%08lx-0x%08lx: expected 0x%02x "
+            "but was 0x%02x\n",
+            (unsigned long)(addr + first), (unsigned long)(addr + end - 1),
+            expected[first], data[first]);
+    return -1;
+  }
+
+  const uint32_t end_addr = addr + len;
+  if (verify->progress &&
+      (offset + len == verify->len ||
+       end_addr >= verify->last_progress_addr + 65536)) {
+    verify->last_progress_addr = end_addr;
+    verify->progress->func(verify->progress->param, offset + len, verify->len);
+  }
+  return 0;
+}
+
+int libhoth_spi_proxy_verify(const struct libhoth_spi_proxy* spi, uint32_t addr,
+                             const void* buf, size_t len,
+                             const struct libhoth_progress* progress) {
+  struct spi_verify_ctx verify = {
+      .expected = (const uint8_t*)buf,
+      .start_addr = addr,
+      .len = len,
+      .last_progress_addr = addr,
+      .progress = progress,
+  };
+  return spi_read_pipelined(spi, addr, len, spi_verify_chunk, &verify);
+}
+
 static void spi_write_page(struct spi_operation* op,
                            const struct libhoth_spi_proxy* spi, uint32_t addr,
                            const uint8_t* buf, size_t len) {
@@ -255,6 +593,8 @@ int libhoth_spi_proxy_init(struct libhoth_spi_proxy* spi,
                            bool enter_exit_4b) {
   spi->dev = dev;
   spi->is_4_byte = is_4_byte;
+  spi->window = 1;
+  spi->cache = NULL;
 
   struct spi_operation op;
   spi_operation_init(&op);
@@ -279,67 +619,679 @@ int libhoth_spi_proxy_init(struct libhoth_spi_proxy* spi,
   return status;
 }
 
-int libhoth_spi_proxy_update(const struct libhoth_spi_proxy* spi, uint32_t addr,
-                             const void* buf, size_t len,
-                             const struct libhoth_progress* progress) {
-  const uint32_t SPI_PAGE_SIZE = 256;
+static void spi_proxy_cache_free(struct libhoth_spi_proxy_cache* cache) {
+  libhoth_spi_cache_destroy(cache->lines);
+  free(cache->path);
+  free(cache->key);
+  free(cache);
+}
 
-  // There is only enough space in the buffer for 3 page writes (and associated
-  // erases and write-enable transactions)
-  const uint32_t MAX_PAGES_PER_OP = 3;
+int libhoth_spi_proxy_open_cache(struct libhoth_spi_proxy* spi,
+                                 const char* path, const void* key,
+                                 size_t key_len) {
+  if (spi->cache != NULL) {
+    fprintf(stderr, "SPI proxy cache is already open\n");
+    return -1;
+  }
+  struct libhoth_spi_proxy_cache* cache =
+      calloc(1, sizeof(struct libhoth_spi_proxy_cache));
+  if (cache == NULL) {
+    return -1;
+  }
+  int status = -1;
+  cache->key_len = SPI_JEDEC_ID_LEN + key_len;
+  cache->key = malloc(cache->key_len);
+  if (cache->key == NULL || libhoth_spi_cache_create(&cache->lines) != 0) {
+    goto err_out;
+  }
+  if (path != NULL) {
+    cache->path = strdup(path);
+    if (cache->path == NULL) {
+      goto err_out;
+    }
+  }
 
+  // Tag the cache with the flash chip, so one file isn't used for another.
   struct spi_operation op;
   spi_operation_init(&op);
+  spi_operation_begin_transaction(&op);
+  spi_operation_write_mosi(&op, &SPI_OP_READ_JEDEC_ID,
+                           sizeof(SPI_OP_READ_JEDEC_ID));
+  spi_operation_read_miso_and_end_transaction(&op, cache->key,
+                                              SPI_JEDEC_ID_LEN);
+  status = spi_operation_execute(&op, spi->dev);
+  if (status != 0) {
+    goto err_out;
+  }
+  if (key_len > 0) {
+    memcpy(&cache->key[SPI_JEDEC_ID_LEN], key, key_len);
+  }
+
+  if (path != NULL) {
+    status = libhoth_spi_cache_load(cache->lines, path, cache->key,
+                                    cache->key_len);
+    if (status != 0) {
+      goto err_out;
+    }
+  }
+  spi->cache = cache;
+  return 0;
+
+err_out:
+  spi_proxy_cache_free(cache);
+  return status;
+}
 
-  uint8_t* cbuf = (uint8_t*)buf;
-  size_t pages_in_op = 0;
+int libhoth_spi_proxy_close_cache(struct libhoth_spi_proxy* spi) {
+  struct libhoth_spi_proxy_cache* cache = spi->cache;
+  if (cache == NULL) {
+    return 0;
+  }
+  spi->cache = NULL;
+  int status = 0;
+  if (cache->path != NULL) {
+    if (cache->updated) {
+      // The lines that are left are still right, but the key may not be.
+      if (unlink(cache->path) != 0 && errno != ENOENT) {
+        fprintf(stderr, "Failed to remove %s: %s\n", cache->path,
+                strerror(errno));
+        status = -1;
+      }
+    } else {
+      status = libhoth_spi_cache_save(cache->lines, cache->path, cache->key,
+                                      cache->key_len);
+    }
+  }
+  spi_proxy_cache_free(cache);
+  return status;
+}
 
-  uint32_t need_erase_addr = addr;
+// The size of the hash that follows the image regions of `descr`.
+static size_t spi_descriptor_hash_len(const struct image_descriptor* descr) {
+  switch (descr->hash_type) {
+    case HASH_SHA2_256:
+      return sizeof(struct hash_sha256);
+    case HASH_SHA2_512:
+      return sizeof(struct hash_sha512);
+    default:
+      return 0;
+  }
+}
 
-  uint32_t last_progress_addr = addr;
+// Reads the magic at each descriptor alignment and returns the address of the
+// first match in `*descr_addr`, or -1 if there isn't one.
+static int spi_probe_descriptor_magic(const struct libhoth_spi_proxy* spi,
+                                      size_t flash_size,
+                                      uint32_t* descr_addr) {
+  size_t num_probes = 0;
+  while (num_probes * TITAN_IMAGE_DESCRIPTOR_ALIGNMENT +
+             sizeof(struct image_descriptor) <=
+         flash_size) {
+    num_probes++;
+  }
+  uint64_t* magics = calloc(num_probes, sizeof(uint64_t));
+  struct libhoth_spi_proxy_segment* segs =
+      calloc(num_probes, sizeof(struct libhoth_spi_proxy_segment));
+  int status = -1;
+  if (num_probes > 0 && (magics == NULL || segs == NULL)) {
+    goto cleanup;
+  }
+  for (size_t i = 0; i < num_probes; i++) {
+    segs[i] = (struct libhoth_spi_proxy_segment){
+        .addr = i * TITAN_IMAGE_DESCRIPTOR_ALIGNMENT,
+        .len = sizeof(uint64_t),
+        .buf = &magics[i],
+    };
+  }
+  status = libhoth_spi_proxy_readv(spi, segs, num_probes);
+  if (status != 0) {
+    goto cleanup;
+  }
+  status = -1;
+  for (size_t i = 0; i < num_probes; i++) {
+    if (magics[i] == TITAN_IMAGE_DESCRIPTOR_MAGIC) {
+      *descr_addr = segs[i].addr;
+      status = 0;
+      break;
+    }
+  }
+  if (status != 0) {
+    fprintf(stderr, "No image descriptor in the first 0x%zx bytes of flash\n",
+            flash_size);
+  }
 
-  size_t len_remaining = len;
-  while (len_remaining > 0) {
-    size_t page_end = ((addr + SPI_PAGE_SIZE) / SPI_PAGE_SIZE) * SPI_PAGE_SIZE;
+cleanup:
+  free(segs);
+  free(magics);
+  return status;
+}
 
-    if (page_end > need_erase_addr) {
-      uint32_t erase_start_64k = (addr / 65536) * 65536;
-      uint32_t erase_start_4k = (addr / 4096) * 4096;
-      uint32_t erase_end_64k = erase_start_64k + 65536;
-      uint32_t erase_end_4k = erase_start_4k + 4096;
+int libhoth_spi_proxy_find_image_descriptor(
+    const struct libhoth_spi_proxy* spi, size_t flash_size,
+    uint32_t* descr_addr, struct image_descriptor** descr) {
+  uint32_t addr;
+  int status = spi_probe_descriptor_magic(spi, flash_size, &addr);
+  if (status != 0) {
+    return status;
+  }
 
-      if ((erase_start_64k >= addr || erase_start_64k == erase_start_4k) &&
-          (erase_end_64k <= (addr + len_remaining) ||
-           erase_end_64k == erase_end_4k)) {
-        need_erase_addr = erase_end_64k;
-        spi_erase_generic(&op, spi, erase_start_64k, SPI_OP_ERASE_64K);
-      } else {
-        need_erase_addr = erase_end_4k;
-        spi_erase_generic(&op, spi, erase_start_4k, SPI_OP_ERASE_4K);
+  struct image_descriptor header;
+  status = libhoth_spi_proxy_read(spi, addr, &header, sizeof(header));
+  if (status != 0) {
+    return status;
+  }
+  const size_t len = sizeof(header) +
+                     header.region_count * sizeof(struct image_region) +
+                     spi_descriptor_hash_len(&header);
+  if (len > header.descriptor_area_size ||
+      addr + (uint64_t)header.descriptor_area_size > flash_size) {
+    fprintf(stderr, "Image descriptor at 0x%08x is clipped\n", addr);
+    return -1;
+  }
+
+  // The regions and hash follow the header.
+  uint8_t* buf = malloc(len);
+  if (buf == NULL) {
+    return -1;
+  }
+  memcpy(buf, &header, sizeof(header));
+  status = libhoth_spi_proxy_read(spi, addr + sizeof(header),
+                                  &buf[sizeof(header)], len - sizeof(header));
+  if (status != 0) {
+    free(buf);
+    return status;
+  }
+  *descr_addr = addr;
+  *descr = (struct image_descriptor*)buf;
+  return 0;
+}
+
+int libhoth_spi_proxy_payload_info(const struct libhoth_spi_proxy* spi,
+                                   size_t flash_size,
+                                   struct payload_info* payload_info) {
+  uint32_t descr_addr;
+  struct image_descriptor* descr;
+  int status = libhoth_spi_proxy_find_image_descriptor(spi, flash_size,
+                                                       &descr_addr, &descr);
+  if (status != 0) {
+    return status;
+  }
+  libhoth_image_descriptor_payload_info(descr, payload_info);
+  free(descr);
+  return 0;
+}
+
+int libhoth_spi_proxy_open_image_cache(struct libhoth_spi_proxy* spi,
+                                       const char* path, size_t flash_size) {
+  uint32_t descr_addr;
+  struct image_descriptor* descr;
+  int status = libhoth_spi_proxy_find_image_descriptor(spi, flash_size,
+                                                       &descr_addr, &descr);
+  if (status != 0) {
+    return status;
+  }
+  if (descr->hash_type != HASH_SHA2_256 ||
+      descr_addr < descr->descriptor_offset) {
+    fprintf(stderr, "The image in flash has no SHA-256 hash to key a cache\n");
+    free(descr);
+    return -1;
+  }
+  struct payload_info info;
+  libhoth_image_descriptor_payload_info(descr, &info);
+  status = libhoth_spi_proxy_open_cache(spi, path, info.image_hash,
+                                        sizeof(info.image_hash));
+  if (status != 0) {
+    free(descr);
+    return status;
+  }
+
+  // Only the static regions, less the descriptor, are covered by the hash.
+  struct libhoth_spi_cache* lines = spi->cache->lines;
+  const uint32_t image_addr = descr_addr - descr->descriptor_offset;
+  libhoth_spi_cache_invalidate(lines, 0, image_addr);
+  for (size_t i = 0; i < descr->region_count; i++) {
+    const struct image_region* region = &descr->image_regions[i];
+    if (!(region->region_attributes & IMAGE_REGION_STATIC)) {
+      libhoth_spi_cache_invalidate(lines, image_addr + region->region_offset,
+                                   region->region_size);
+    }
+  }
+  libhoth_spi_cache_invalidate(lines, descr_addr, descr->descriptor_area_size);
+  const uint64_t image_end = (uint64_t)image_addr + descr->image_size;
+  if (image_end <= UINT32_MAX) {
+    libhoth_spi_cache_invalidate(lines, image_end,
+                                 (uint64_t)UINT32_MAX + 1 - image_end);
+  }
+  free(descr);
+  return 0;
+}
+
+// MOSI bytes of the write enable and erase transactions of spi_erase_generic().
+static size_t spi_erase_mosi_len(const struct libhoth_spi_proxy* spi) {
+  return sizeof(SPI_OP_WRITE_ENABLE) + 1 + spi_address_len(spi);
+}
+
+// MOSI bytes of the write enable and page program transactions of
+// spi_write_page(), not counting the data.
+static size_t spi_write_page_mosi_len(const struct libhoth_spi_proxy* spi) {
+  return sizeof(SPI_OP_WRITE_ENABLE) + sizeof(SPI_OP_PAGE_PROGRAM) +
+         spi_address_len(spi);
+}
+
+// The number of data bytes a spi_write_page() appended to `op` can carry.
+static size_t spi_write_page_room(const struct spi_operation* op,
+                                  const struct libhoth_spi_proxy* spi) {
+  const size_t overhead = 2 * sizeof(struct hoth_spi_operation_request) +
+                          spi_write_page_mosi_len(spi);
+  if (!spi_operation_fits(op, 2, overhead)) {
+    return 0;
+  }
+  return sizeof(op->buf) - op->pos - overhead;
+}
+
+#define SPI_PAGE_SIZE 256
+#define SPI_SECTOR_SIZE 4096
+#define SPI_BLOCK_SIZE 65536
+#define SPI_SECTORS_PER_BLOCK (SPI_BLOCK_SIZE / SPI_SECTOR_SIZE)
+
+// Typical erase and page program times from NOR flash datasheets, in
+// microseconds, used to choose between 4K and 64K erases.
+#define SPI_ERASE_4K_COST_US 45000
+#define SPI_ERASE_64K_COST_US 150000
+#define SPI_PAGE_PROGRAM_COST_US 700
+
+// A page that doesn't fit in the rest of an op is split across two ops, as a
+// page can be programmed in parts, but only if at least this much of it fits;
+// smaller pieces aren't worth another program cycle.
+#define SPI_MIN_PARTIAL_PAGE 64
+
+enum spi_sector_state {
+  // No part of the sector is being written.
+  SPI_SECTOR_UNTOUCHED,
+  // The flash already holds the data.
+  SPI_SECTOR_UNCHANGED,
+  // The data can be programmed over what's in the flash.
+  SPI_SECTOR_PROGRAM,
+  SPI_SECTOR_ERASE,
+};
+
+static int spi_plan_append(struct libhoth_spi_proxy_plan* plan,
+                           enum libhoth_spi_proxy_step_type type,
+                           uint32_t addr, uint32_t len) {
+  if (type == LIBHOTH_SPI_PROXY_STEP_PROGRAM && plan->num_steps > 0) {
+    struct libhoth_spi_proxy_step* last = &plan->steps[plan->num_steps - 1];
+    if (last->type == LIBHOTH_SPI_PROXY_STEP_PROGRAM &&
+        last->addr + last->len == addr) {
+      last->len += len;
+      return 0;
+    }
+  }
+  if (plan->num_steps == plan->capacity) {
+    const size_t capacity = MAX(plan->capacity * 2, 64);
+    struct libhoth_spi_proxy_step* steps =
+        realloc(plan->steps, capacity * sizeof(*steps));
+    if (steps == NULL) {
+      return -1;
+    }
+    plan->steps = steps;
+    plan->capacity = capacity;
+  }
+  plan->steps[plan->num_steps++] = (struct libhoth_spi_proxy_step){
+      .type = type,
+      .addr = addr,
+      .len = len,
+  };
+  return 0;
+}
+
+// The end of the part of [addr, end) that lies in the same page as `addr`.
+static uint32_t spi_page_end(uint32_t addr, uint32_t end) {
+  return MIN((addr / SPI_PAGE_SIZE + 1) * SPI_PAGE_SIZE, end);
+}
+
+// Whether the piece of data `data` needs to be programmed. `flash` holds what
+// is currently in the flash there, or is NULL if it has just been erased.
+static bool spi_page_needs_program(const uint8_t* data, const uint8_t* flash,
+                                   size_t len) {
+  if (flash == NULL) {
+    return libhoth_erased_prefix_len(data, len) != len;
+  }
+  return memcmp(data, flash, len) != 0;
+}
+
+static int spi_plan_copy_chunk(void* ctx, uint32_t addr, const uint8_t* data,
+                               size_t len) {
+  uint8_t* dest = (uint8_t*)ctx;
+  memcpy(dest + (addr % SPI_BLOCK_SIZE), data, len);
+  return 0;
+}
+
+// Plans the update of [start, end), which lies in the 64K block at
+// `block_addr`, to `data`. If `flash` isn't NULL, the range is read into it
+// (at its offset in the block) first, so that only what differs is written.
+static int spi_plan_block(const struct libhoth_spi_proxy* spi,
+                          uint32_t block_addr, uint32_t start, uint32_t end,
+                          const uint8_t* data, uint8_t* flash,
+                          struct libhoth_spi_proxy_plan* plan) {
+  if (flash != NULL) {
+    int status = spi_read_pipelined(spi, start, end - start,
+                                    spi_plan_copy_chunk, flash);
+    if (status != 0) {
+      return status;
+    }
+  }
+  // Where the data and flash contents for an address are.
+#define DATA(addr) (&data[(addr) - start])
+#define FLASH(addr) (&flash[(addr) - block_addr])
+
+  enum spi_sector_state states[SPI_SECTORS_PER_BLOCK];
+  size_t num_erases = 0;
+  bool block_erasable = true;
+  uint64_t cost_4k = 0;
+  uint64_t cost_64k = SPI_ERASE_64K_COST_US;
+  for (size_t i = 0; i < SPI_SECTORS_PER_BLOCK; i++) {
+    const uint32_t sector_addr = block_addr + i * SPI_SECTOR_SIZE;
+    const uint32_t sector_start = MAX(sector_addr, start);
+    const uint32_t sector_end = MIN(sector_addr + SPI_SECTOR_SIZE, end);
+    if (sector_start >= sector_end) {
+      states[i] = SPI_SECTOR_UNTOUCHED;
+      // Erasing the block would lose data that isn't being rewritten.
+      block_erasable = false;
+      continue;
+    }
+    const size_t len = sector_end - sector_start;
+    if (flash == NULL) {
+      states[i] = SPI_SECTOR_ERASE;
+    } else if (memcmp(DATA(sector_start), FLASH(sector_start), len) == 0) {
+      states[i] = SPI_SECTOR_UNCHANGED;
+    } else {
+      states[i] = SPI_SECTOR_PROGRAM;
+      // Programming can only clear bits.
+      for (uint32_t addr = sector_start; addr < sector_end; addr++) {
+        if ((*DATA(addr) & *FLASH(addr)) != *DATA(addr)) {
+          states[i] = SPI_SECTOR_ERASE;
+          break;
+        }
+      }
+    }
+    if (states[i] != SPI_SECTOR_ERASE && len != SPI_SECTOR_SIZE) {
+      // The sector holds data that isn't being rewritten.
+      block_erasable = false;
+    }
+
+    for (uint32_t page_addr = sector_start; page_addr < sector_end;
+         page_addr = spi_page_end(page_addr, sector_end)) {
+      const size_t page_len = spi_page_end(page_addr, sector_end) - page_addr;
+      const bool erased = states[i] == SPI_SECTOR_ERASE;
+      if (spi_page_needs_program(DATA(page_addr), NULL, page_len)) {
+        cost_64k += SPI_PAGE_PROGRAM_COST_US;
+      }
+      if (states[i] != SPI_SECTOR_UNCHANGED &&
+          spi_page_needs_program(DATA(page_addr),
+                                 erased ? NULL : FLASH(page_addr), page_len)) {
+        cost_4k += SPI_PAGE_PROGRAM_COST_US;
+      }
+    }
+    if (states[i] == SPI_SECTOR_ERASE) {
+      num_erases++;
+      cost_4k += SPI_ERASE_4K_COST_US;
+    }
+  }
+
+  const bool erase_block =
+      block_erasable && num_erases > 0 && cost_64k <= cost_4k;
+  if (erase_block && spi_plan_append(plan, LIBHOTH_SPI_PROXY_STEP_ERASE_64K,
+                                     block_addr, SPI_BLOCK_SIZE) != 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < SPI_SECTORS_PER_BLOCK; i++) {
+    const uint32_t sector_addr = block_addr + i * SPI_SECTOR_SIZE;
+    if (states[i] == SPI_SECTOR_UNTOUCHED ||
+        (states[i] == SPI_SECTOR_UNCHANGED && !erase_block)) {
+      continue;
+    }
+    const bool erased = erase_block || states[i] == SPI_SECTOR_ERASE;
+    if (states[i] == SPI_SECTOR_ERASE && !erase_block &&
+        spi_plan_append(plan, LIBHOTH_SPI_PROXY_STEP_ERASE_4K, sector_addr,
+                        SPI_SECTOR_SIZE) != 0) {
+      return -1;
+    }
+    const uint32_t sector_start = MAX(sector_addr, start);
+    const uint32_t sector_end = MIN(sector_addr + SPI_SECTOR_SIZE, end);
+    for (uint32_t page_addr = sector_start; page_addr < sector_end;
+         page_addr = spi_page_end(page_addr, sector_end)) {
+      const size_t page_len = spi_page_end(page_addr, sector_end) - page_addr;
+      if (spi_page_needs_program(DATA(page_addr),
+                                 erased ? NULL : FLASH(page_addr), page_len) &&
+          spi_plan_append(plan, LIBHOTH_SPI_PROXY_STEP_PROGRAM, page_addr,
+                          page_len) != 0) {
+        return -1;
       }
     }
-    size_t write_len = MIN(page_end - addr, len_remaining);
-    spi_write_page(&op, spi, addr, cbuf, write_len);
-    len_remaining -= write_len;
-    addr += write_len;
-    cbuf += write_len;
+  }
+  return 0;
+#undef DATA
+#undef FLASH
+}
+
+int libhoth_spi_proxy_plan_update(const struct libhoth_spi_proxy* spi,
+                                  uint32_t addr, const void* buf, size_t len,
+                                  bool read_flash,
+                                  struct libhoth_spi_proxy_plan* plan) {
+  *plan = (struct libhoth_spi_proxy_plan){
+      .addr = addr,
+      .len = len,
+  };
+  if (len > UINT32_MAX - addr) {
+    fprintf(stderr, "SPI update beyond the 4 GiB address space\n");
+    return -1;
+  }
+  uint8_t* flash = NULL;
+  if (read_flash) {
+    flash = malloc(SPI_BLOCK_SIZE);
+    if (flash == NULL) {
+      return -1;
+    }
+  }
+
+  const uint8_t* cbuf = (const uint8_t*)buf;
+  const uint32_t end = addr + len;
+  int status = 0;
+  for (uint32_t start = addr; start < end && status == 0;) {
+    const uint32_t block_addr = (start / SPI_BLOCK_SIZE) * SPI_BLOCK_SIZE;
+    const uint32_t block_end =
+        (uint32_t)MIN((uint64_t)block_addr + SPI_BLOCK_SIZE, end);
+    status = spi_plan_block(spi, block_addr, start, block_end,
+                            cbuf + (start - addr), flash, plan);
+    start = block_end;
+  }
+  free(flash);
+  if (status != 0) {
+    libhoth_spi_proxy_plan_destroy(plan);
+  }
+  return status;
+}
+
+void libhoth_spi_proxy_plan_destroy(struct libhoth_spi_proxy_plan* plan) {
+  free(plan->steps);
+  plan->steps = NULL;
+  plan->num_steps = 0;
+  plan->capacity = 0;
+}
+
+void libhoth_spi_proxy_plan_print(FILE* out,
+                                  const struct libhoth_spi_proxy_plan* plan) {
+  size_t erases_4k = 0;
+  size_t erases_64k = 0;
+  size_t program_bytes = 0;
+  for (size_t i = 0; i < plan->num_steps; i++) {
+    const struct libhoth_spi_proxy_step* step = &plan->steps[i];
+    switch (step->type) {
+      case LIBHOTH_SPI_PROXY_STEP_ERASE_4K:
+        erases_4k++;
+        fprintf(out, "erase 4K   0x%08lx\n", (unsigned long)step->addr);
+        break;
+      case LIBHOTH_SPI_PROXY_STEP_ERASE_64K:
+        erases_64k++;
+        fprintf(out, "erase 64K  0x%08lx\n", (unsigned long)step->addr);
+        break;
+      case LIBHOTH_SPI_PROXY_STEP_PROGRAM:
+        program_bytes += step->len;
+        fprintf(out, "program    0x%08lx-0x%08lx\n",
+                (unsigned long)step->addr,
+                (unsigned long)(step->addr + step->len - 1));
+        break;
+    }
+  }
+  fprintf(out,
+          "%zu 64K erases, %zu 4K erases, %zu of %zu bytes programmed\n",
+          erases_64k, erases_4k, program_bytes, plan->len);
+}
+
+// Sends `op`, and reports progress up to `addr`.
+static int spi_apply_flush(const struct libhoth_spi_proxy* spi,
+                           struct spi_operation* op,
+                           const struct libhoth_spi_proxy_plan* plan,
+                           uint32_t addr, uint32_t* last_progress_addr,
+                           const struct libhoth_progress* progress) {
+  int status = spi_operation_execute(op, spi->dev);
+  if (status) {
+    return status;
+  }
+  spi_operation_init(op);
+  if (progress && addr >= *last_progress_addr + 65536) {
+    *last_progress_addr = addr;
+    progress->func(progress->param, addr - plan->addr, plan->len);
+  }
+  return 0;
+}
+
+int libhoth_spi_proxy_apply_plan(const struct libhoth_spi_proxy* spi,
+                                 const struct libhoth_spi_proxy_plan* plan,
+                                 const void* buf,
+                                 const struct libhoth_progress* progress) {
+  struct spi_operation op;
+  spi_operation_init(&op);
 
-    pages_in_op++;
+  const uint8_t* cbuf = (const uint8_t*)buf;
+  uint32_t last_progress_addr = plan->addr;
+  int status;
 
-    if (pages_in_op >= MAX_PAGES_PER_OP || len_remaining == 0) {
-      pages_in_op = 0;
+  // Drop what is about to change up front, so that a failure part way
+  // through doesn't leave stale lines behind.
+  if (spi->cache != NULL) {
+    spi->cache->updated = true;
+    for (size_t i = 0; i < plan->num_steps; i++) {
+      libhoth_spi_cache_invalidate(spi->cache->lines, plan->steps[i].addr,
+                                   plan->steps[i].len);
+    }
+  }
 
-      int status = spi_operation_execute(&op, spi->dev);
-      if (status) {
-        return status;
+  for (size_t i = 0; i < plan->num_steps; i++) {
+    const struct libhoth_spi_proxy_step* step = &plan->steps[i];
+    // Progress is counted from where the data of the step starts.
+    const uint32_t done_addr = MAX(step->addr, plan->addr);
+    if (step->type != LIBHOTH_SPI_PROXY_STEP_PROGRAM) {
+      if (!spi_operation_fits(&op, 2, spi_erase_mosi_len(spi))) {
+        status = spi_apply_flush(spi, &op, plan, done_addr,
+                                 &last_progress_addr, progress);
+        if (status) {
+          return status;
+        }
       }
-      if (progress &&
-          (len_remaining == 0 || addr >= last_progress_addr + 65536)) {
-        last_progress_addr = addr;
-        progress->func(progress->param, len - len_remaining, len);
+      spi_erase_generic(&op, spi, step->addr,
+                        step->type == LIBHOTH_SPI_PROXY_STEP_ERASE_64K
+                            ? SPI_OP_ERASE_64K
+                            : SPI_OP_ERASE_4K);
+      continue;
+    }
+
+    uint32_t addr = step->addr;
+    const uint32_t end = step->addr + step->len;
+    while (addr < end) {
+      size_t write_len = spi_page_end(addr, end) - addr;
+      if (!spi_operation_fits(&op, 2,
+                              spi_write_page_mosi_len(spi) +
+                                  MIN(write_len, SPI_MIN_PARTIAL_PAGE))) {
+        status = spi_apply_flush(spi, &op, plan, addr, &last_progress_addr,
+                                 progress);
+        if (status) {
+          return status;
+        }
       }
-      spi_operation_init(&op);
+      // The rest of the page, if any, goes in the next op.
+      write_len = MIN(write_len, spi_write_page_room(&op, spi));
+      spi_write_page(&op, spi, addr, &cbuf[addr - plan->addr], write_len);
+      addr += write_len;
     }
   }
+  if (op.num_transactions > 0) {
+    status = spi_operation_execute(&op, spi->dev);
+    if (status) {
+      return status;
+    }
+  }
+  if (progress && plan->len > 0) {
+    progress->func(progress->param, plan->len, plan->len);
+  }
   return 0;
 }
+
+int libhoth_spi_proxy_update(const struct libhoth_spi_proxy* spi, uint32_t addr,
+                             const void* buf, size_t len,
+                             const struct libhoth_progress* progress) {
+  struct libhoth_spi_proxy_plan plan;
+  int status = libhoth_spi_proxy_plan_update(spi, addr, buf, len,
+                                             /*read_flash=*/false, &plan);
+  if (status != 0) {
+    return status;
+  }
+  status = libhoth_spi_proxy_apply_plan(spi, &plan, buf, progress);
+  libhoth_spi_proxy_plan_destroy(&plan);
+  return status;
+}
+
+int libhoth_spi_proxy_update_stream(const struct libhoth_spi_proxy* spi,
+                                    uint32_t addr,
+                                    const struct libhoth_payload_reader* reader,
+                                    size_t size, bool verify,
+                                    const struct libhoth_progress* progress) {
+  const uint32_t BLOCK_SIZE = 65536;
+
+  uint8_t* block = malloc(BLOCK_SIZE);
+  if (block == NULL) {
+    return -1;
+  }
+  int status = 0;
+  size_t done = 0;
+  while (true) {
+    // Blocks are aligned to flash blocks, so the erases are the same as if
+    // the data were written in one go.
+    size_t block_len = BLOCK_SIZE - (addr % BLOCK_SIZE);
+    ssize_t len = libhoth_payload_read_full(reader, block, block_len);
+    if (len < 0) {
+      status = -1;
+      break;
+    }
+    if (len == 0) {
+      break;
+    }
+    status = libhoth_spi_proxy_update(spi, addr, block, len, NULL);
+    if (status == 0 && verify) {
+      status = libhoth_spi_proxy_verify(spi, addr, block, len, NULL);
+    }
+    if (status) {
+      break;
+    }
+    addr += len;
+    done += len;
+    if (progress && size > 0) {
+      progress->func(progress->param, done, size);
+    }
+    if ((size_t)len < block_len) {
+      break;
+    }
+  }
+  free(block);
+  return status;
+}
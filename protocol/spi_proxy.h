@@ -15,9 +15,13 @@
 #ifndef LIBHOTH_PROTOCOL_SPI_PROXY_H_
 #define LIBHOTH_PROTOCOL_SPI_PROXY_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
+#include "protocol/payload_info.h"
+#include "protocol/payload_reader.h"
 #include "protocol/progress.h"
 #include "transports/libhoth_device.h"
 
@@ -25,9 +29,21 @@
 extern "C" {
 #endif
 
+// Upper limit of `libhoth_spi_proxy::window`.
+#define LIBHOTH_SPI_PROXY_MAX_WINDOW 8
+
+struct libhoth_spi_proxy_cache;
+
 struct libhoth_spi_proxy {
   struct libhoth_device* dev;
   bool is_4_byte;
+  // How many SPI_OPERATION reads to keep in flight when reading the flash,
+  // whether to read it out, verify it or plan an update. Limited to what the
+  // transport can queue (see `fifo_pipeline_depth` in libhoth_usb.h).
+  // libhoth_spi_proxy_init() sets it to 1; 0 also means 1.
+  size_t window;
+  // Set by libhoth_spi_proxy_open_cache(); NULL if reads aren't cached.
+  struct libhoth_spi_proxy_cache* cache;
 };
 
 int libhoth_spi_proxy_init(struct libhoth_spi_proxy* spi,
@@ -37,14 +53,127 @@ int libhoth_spi_proxy_init(struct libhoth_spi_proxy* spi,
 int libhoth_spi_proxy_read(const struct libhoth_spi_proxy* spi, uint32_t addr,
                            void* buf, size_t len);
 
+// Makes libhoth_spi_proxy_read() and libhoth_spi_proxy_readv() read through a
+// cache of the flash contents, so that reading the same regions again doesn't
+// go over the SPI bus. Updates through `spi` drop the lines they erase or
+// program; verifying and planning updates always read the flash itself.
+//
+// If `path` isn't NULL, the cache is loaded from it, if it was saved there
+// with the same flash JEDEC ID and `key`, and saved back to it by
+// libhoth_spi_proxy_close_cache(). `key` must identify the flash contents
+// (for example, the hash from the image descriptor), as nothing else tells a
+// stale file apart.
+int libhoth_spi_proxy_open_cache(struct libhoth_spi_proxy* spi,
+                                 const char* path, const void* key,
+                                 size_t key_len);
+
+// Saves the cache, if it was opened with a path, and stops caching.
+int libhoth_spi_proxy_close_cache(struct libhoth_spi_proxy* spi);
+
+// Finds the image descriptor in the first `flash_size` bytes of the flash
+// without reading all of it: only the magic at each
+// TITAN_IMAGE_DESCRIPTOR_ALIGNMENT boundary is read, in one
+// libhoth_spi_proxy_readv(), and then the descriptor with its regions and
+// hash. On success, `*descr` is set to a copy of those, which the caller must
+// free(), and `*descr_addr` to where the descriptor is in the flash.
+int libhoth_spi_proxy_find_image_descriptor(
+    const struct libhoth_spi_proxy* spi, size_t flash_size,
+    uint32_t* descr_addr, struct image_descriptor** descr);
+
+// Same as libhoth_payload_info() for the image in the flash, found with
+// libhoth_spi_proxy_find_image_descriptor().
+int libhoth_spi_proxy_payload_info(const struct libhoth_spi_proxy* spi,
+                                   size_t flash_size,
+                                   struct payload_info* payload_info);
+
+// libhoth_spi_proxy_open_cache() with the SHA-256 hash of the image in the
+// flash as the key. As the hash only covers the static regions of the image,
+// lines loaded from `path` for anything else are dropped.
+int libhoth_spi_proxy_open_image_cache(struct libhoth_spi_proxy* spi,
+                                       const char* path, size_t flash_size);
+
+struct libhoth_spi_proxy_segment {
+  uint32_t addr;
+  size_t len;
+  void* buf;
+};
+
+// Reads each of `segs` into its buffer. The reads are packed together into as
+// few SPI_OPERATION host commands as possible, which saves round trips when
+// reading many small structures.
+int libhoth_spi_proxy_readv(const struct libhoth_spi_proxy* spi,
+                            const struct libhoth_spi_proxy_segment* segs,
+                            size_t num_segs);
+
+// Plans the update with libhoth_spi_proxy_plan_update() (without reading the
+// flash) and applies the plan.
 int libhoth_spi_proxy_update(const struct libhoth_spi_proxy* spi, uint32_t addr,
                              const void* buf, size_t len,
                              const struct libhoth_progress* progress);
 
+enum libhoth_spi_proxy_step_type {
+  LIBHOTH_SPI_PROXY_STEP_ERASE_4K,
+  LIBHOTH_SPI_PROXY_STEP_ERASE_64K,
+  LIBHOTH_SPI_PROXY_STEP_PROGRAM,
+};
+
+struct libhoth_spi_proxy_step {
+  enum libhoth_spi_proxy_step_type type;
+  uint32_t addr;
+  uint32_t len;
+};
+
+// The erases and page programs that write `len` bytes at `addr`, in the order
+// they are to be done. Program steps may span several pages.
+struct libhoth_spi_proxy_plan {
+  uint32_t addr;
+  size_t len;
+  struct libhoth_spi_proxy_step* steps;
+  size_t num_steps;
+  size_t capacity;
+};
+
+// Plans writing `buf` to `len` bytes of flash at `addr`. Every 4K sector
+// holding part of the range is erased (in 64K blocks where that is quicker)
+// and the pages that aren't all 0xFF are programmed. If `read_flash` is set,
+// the range is read first, and sectors that already hold the data, or that
+// only need bits cleared, aren't erased; only the pages that differ are
+// programmed. Free the plan with libhoth_spi_proxy_plan_destroy().
+int libhoth_spi_proxy_plan_update(const struct libhoth_spi_proxy* spi,
+                                  uint32_t addr, const void* buf, size_t len,
+                                  bool read_flash,
+                                  struct libhoth_spi_proxy_plan* plan);
+
+// Carries out `plan`, which was made for the same `buf`.
+int libhoth_spi_proxy_apply_plan(const struct libhoth_spi_proxy* spi,
+                                 const struct libhoth_spi_proxy_plan* plan,
+                                 const void* buf,
+                                 const struct libhoth_progress* progress);
+
+// Prints the steps of `plan` and a summary of them.
+void libhoth_spi_proxy_plan_print(FILE* out,
+                                  const struct libhoth_spi_proxy_plan* plan);
+
+void libhoth_spi_proxy_plan_destroy(struct libhoth_spi_proxy_plan* plan);
+
+// Reads back `len` bytes at `addr` and compares them with `buf`. On a
+// mismatch, the first range of differing bytes is reported on stderr and -1
+// is returned.
 int libhoth_spi_proxy_verify(const struct libhoth_spi_proxy* spi, uint32_t addr,
                              const void* buf, size_t len,
                              const struct libhoth_progress* progress);
 
+// Same as libhoth_spi_proxy_update() (followed by libhoth_spi_proxy_verify()
+// if `verify` is set), but pulls the data from `reader` one 64 KiB flash
+// block at a time, so it is never all held in memory. Each block is verified
+// right after it is written. `size` is the expected data size, used only for
+// progress; pass 0 if it isn't known.
+int libhoth_spi_proxy_update_stream(const struct libhoth_spi_proxy* spi,
+                                    uint32_t addr,
+                                    const struct libhoth_payload_reader* reader,
+                                    size_t size, bool verify,
+                                    const struct libhoth_progress* progress);
+
 struct hoth_spi_operation_request {
   // The number of MOSI bytes we're sending
   uint16_t mosi_len;
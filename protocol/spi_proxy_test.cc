@@ -16,8 +16,16 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <string>
 #include <vector>
 
 #include "test/libhoth_device_mock.h"
@@ -26,6 +34,147 @@ using ::testing::_;
 using ::testing::DoAll;
 using ::testing::Return;
 
+// A SPI NOR flash behind the SPI_OPERATION host command. Programming only
+// clears bits, requires a preceding write enable, and must stay within a page.
+// Responses are queued, so several requests may be in flight.
+class FakeSpiFlash {
+ public:
+  static constexpr size_t kPageSize = 256;
+  static constexpr uint8_t kJedecId[] = {0xef, 0x40, 0x19};
+
+  explicit FakeSpiFlash(size_t size, bool is_4_byte = false)
+      : flash_(size, 0xFF), address_len_(is_4_byte ? 4 : 3) {}
+
+  int Send(struct libhoth_device* dev, const void* request,
+           size_t request_size) {
+    struct hoth_host_request header;
+    std::memcpy(&header, request, sizeof(header));
+    const uint8_t* payload =
+        static_cast<const uint8_t*>(request) + sizeof(header);
+    std::vector<uint8_t> response;
+    EXPECT_EQ(header.command,
+              HOTH_CMD_BOARD_SPECIFIC_BASE + HOTH_PRV_CMD_HOTH_SPI_OPERATION);
+    EXPECT_EQ(sizeof(header) + header.data_len, request_size);
+    ops_++;
+    // The transport would overwrite a request it hasn't answered yet.
+    EXPECT_LT(responses_.size(),
+              static_cast<size_t>(libhoth_device_queue_depth(dev)));
+
+    size_t pos = 0;
+    while (pos < header.data_len) {
+      struct hoth_spi_operation_request transaction;
+      std::memcpy(&transaction, payload + pos, sizeof(transaction));
+      pos += sizeof(transaction);
+      EXPECT_LE(pos + transaction.mosi_len, header.data_len);
+      Transaction(payload + pos, transaction.mosi_len, transaction.miso_len,
+                  &response);
+      pos += transaction.mosi_len;
+    }
+    responses_.push_back(std::move(response));
+    return LIBHOTH_OK;
+  }
+
+  int Receive(struct libhoth_device* dev, void* response,
+              size_t max_response_size, size_t* actual_size, int timeout_ms) {
+    EXPECT_FALSE(responses_.empty());
+    if (responses_.empty()) {
+      return LIBHOTH_ERR_FAIL;
+    }
+    const std::vector<uint8_t> data = std::move(responses_.front());
+    responses_.pop_front();
+    struct hoth_host_response header = {};
+    header.struct_version = HOTH_HOST_RESPONSE_VERSION;
+    header.data_len = data.size();
+    header.checksum = libhoth_calculate_checksum(&header, sizeof(header),
+                                                 data.data(), data.size());
+    EXPECT_LE(sizeof(header) + data.size(), max_response_size);
+    std::memcpy(response, &header, sizeof(header));
+    std::memcpy(static_cast<uint8_t*>(response) + sizeof(header), data.data(),
+                data.size());
+    *actual_size = sizeof(header) + data.size();
+    return LIBHOTH_OK;
+  }
+
+  std::vector<uint8_t>& flash() { return flash_; }
+  int ops() const { return ops_; }
+  int page_programs() const { return page_programs_; }
+
+ private:
+  uint32_t Address(const uint8_t* mosi) const {
+    uint32_t addr = 0;
+    for (size_t i = 0; i < address_len_; ++i) {
+      addr = (addr << 8) | mosi[1 + i];
+    }
+    return addr;
+  }
+
+  void Transaction(const uint8_t* mosi, size_t mosi_len, size_t miso_len,
+                   std::vector<uint8_t>* response) {
+    ASSERT_GE(mosi_len, 1u);
+    const uint8_t opcode = mosi[0];
+    std::vector<uint8_t> miso(miso_len, 0);
+    switch (opcode) {
+      case 0x06:  // Write enable
+        write_enabled_ = true;
+        break;
+      case 0x02: {  // Page program
+        ASSERT_TRUE(write_enabled_);
+        ASSERT_GE(mosi_len, 1 + address_len_);
+        const uint32_t addr = Address(mosi);
+        const size_t len = mosi_len - 1 - address_len_;
+        ASSERT_LE(addr % kPageSize + len, kPageSize);
+        ASSERT_LE(addr + len, flash_.size());
+        for (size_t i = 0; i < len; ++i) {
+          flash_[addr + i] &= mosi[1 + address_len_ + i];
+        }
+        write_enabled_ = false;
+        page_programs_++;
+        break;
+      }
+      case 0x20:    // Erase 4K
+      case 0xd8: {  // Erase 64K
+        ASSERT_TRUE(write_enabled_);
+        const size_t size = opcode == 0x20 ? 4096 : 65536;
+        const uint32_t addr = Address(mosi);
+        ASSERT_EQ(addr % size, 0u);
+        ASSERT_LE(addr + size, flash_.size());
+        std::fill_n(flash_.begin() + addr, size, 0xFF);
+        write_enabled_ = false;
+        break;
+      }
+      case 0x03: {  // Read
+        const uint32_t addr = Address(mosi);
+        const size_t skip = 1 + address_len_;
+        for (size_t i = skip; i < miso_len; ++i) {
+          miso[i] = flash_.at(addr + i - skip);
+        }
+        break;
+      }
+      case 0x9f:  // Read JEDEC ID
+        for (size_t i = 1; i < miso_len && i <= sizeof(kJedecId); ++i) {
+          miso[i] = kJedecId[i - 1];
+        }
+        break;
+    }
+    response->insert(response->end(), miso.begin(), miso.end());
+  }
+
+  std::vector<uint8_t> flash_;
+  const size_t address_len_;
+  std::deque<std::vector<uint8_t>> responses_;
+  bool write_enabled_ = false;
+  int ops_ = 0;
+  int page_programs_ = 0;
+};
+
+static std::vector<uint8_t> MakeImage(size_t size) {
+  std::vector<uint8_t> image(size);
+  for (size_t i = 0; i < size; ++i) {
+    image[i] = static_cast<uint8_t>(i * 7 + i / 251);
+  }
+  return image;
+}
+
 TEST_F(LibHothTest, spi_proxy_init) {
   EXPECT_CALL(mock_, send(_,
                           UsesCommand(HOTH_CMD_BOARD_SPECIFIC_BASE +
@@ -40,3 +189,407 @@ TEST_F(LibHothTest, spi_proxy_init) {
 
   EXPECT_EQ(libhoth_spi_proxy_init(&spi, &hoth_dev_, false, false), LIBHOTH_OK);
 }
+
+TEST_F(LibHothTest, spi_proxy_update_fills_mailbox) {
+  constexpr size_t kSize = 64 * 1024;
+  FakeSpiFlash fake(kSize);
+  fake.flash().assign(kSize, 0x00);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  struct libhoth_spi_proxy spi = {.dev = &hoth_dev_, .is_4_byte = false};
+  const std::vector<uint8_t> image = MakeImage(kSize);
+  EXPECT_EQ(libhoth_spi_proxy_update(&spi, 0, image.data(), image.size(),
+                                     nullptr),
+            0);
+  EXPECT_EQ(fake.flash(), image);
+
+  // Each SPI_OPERATION carries well over three pages, splitting pages at the
+  // end of the mailbox where needed.
+  const size_t data_per_op = kSize / fake.ops();
+  EXPECT_GT(data_per_op, 3 * FakeSpiFlash::kPageSize + 128);
+  EXPECT_GT(fake.page_programs(), kSize / FakeSpiFlash::kPageSize);
+}
+
+TEST_F(LibHothTest, spi_proxy_update_unaligned_4_byte) {
+  constexpr size_t kSize = 3 * 64 * 1024;
+  FakeSpiFlash fake(kSize, /*is_4_byte=*/true);
+  fake.flash().assign(kSize, 0x5A);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  struct libhoth_spi_proxy spi = {.dev = &hoth_dev_, .is_4_byte = true};
+  std::vector<uint8_t> image = MakeImage(70000);
+  // Erased pages aren't programmed, but still erased.
+  std::fill_n(image.begin() + 5000, 3000, 0xFF);
+  constexpr uint32_t kAddr = 4096 + 100;
+  EXPECT_EQ(libhoth_spi_proxy_update(&spi, kAddr, image.data(), image.size(),
+                                     nullptr),
+            0);
+  EXPECT_TRUE(std::equal(image.begin(), image.end(),
+                         fake.flash().begin() + kAddr));
+  // Only whole 4K sectors holding the data were erased.
+  EXPECT_EQ(fake.flash()[4095], 0x5A);
+  EXPECT_EQ(fake.flash()[kAddr - 1], 0xFF);
+  const size_t end = kAddr + image.size();
+  EXPECT_EQ(fake.flash()[end], 0xFF);
+  EXPECT_EQ(fake.flash()[(end + 4095) / 4096 * 4096], 0x5A);
+}
+
+TEST_F(LibHothTest, spi_proxy_verify_window) {
+  constexpr size_t kSize = 64 * 1024;
+  FakeSpiFlash fake(kSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  std::vector<uint8_t> image = MakeImage(20000);
+  std::copy(image.begin(), image.end(), fake.flash().begin() + 300);
+  struct libhoth_spi_proxy spi = {
+      .dev = &hoth_dev_, .is_4_byte = false, .window = 4};
+  hoth_dev_.queue_depth = 4;
+  EXPECT_EQ(libhoth_spi_proxy_verify(&spi, 300, image.data(), image.size(),
+                                     nullptr),
+            0);
+
+  fake.flash()[300 + 12345] ^= 0x10;
+  EXPECT_EQ(libhoth_spi_proxy_verify(&spi, 300, image.data(), image.size(),
+                                     nullptr),
+            -1);
+
+  spi.window = LIBHOTH_SPI_PROXY_MAX_WINDOW + 1;
+  EXPECT_EQ(libhoth_spi_proxy_verify(&spi, 300, image.data(), image.size(),
+                                     nullptr),
+            -1);
+}
+
+TEST_F(LibHothTest, spi_proxy_plan_update) {
+  constexpr size_t kSize = 4 * 64 * 1024;
+  FakeSpiFlash fake(kSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  const std::vector<uint8_t> old_image = MakeImage(kSize);
+  fake.flash() = old_image;
+  std::vector<uint8_t> image = old_image;
+  // Only clears bits: programmed without an erase.
+  image[100] &= 0x0F;
+  // Needs an erase of one sector.
+  image[5 * 4096 + 10] = ~image[5 * 4096 + 10];
+  // Most of the third block changes: one 64K erase.
+  for (size_t i = 2 * 65536; i < 2 * 65536 + 60000; ++i) {
+    image[i] = ~image[i];
+  }
+
+  struct libhoth_spi_proxy spi = {.dev = &hoth_dev_, .is_4_byte = false};
+  struct libhoth_spi_proxy_plan plan;
+  ASSERT_EQ(libhoth_spi_proxy_plan_update(&spi, 0, image.data(), image.size(),
+                                          /*read_flash=*/true, &plan),
+            0);
+  ASSERT_EQ(plan.num_steps, 5u);
+  EXPECT_EQ(plan.steps[0].type, LIBHOTH_SPI_PROXY_STEP_PROGRAM);
+  EXPECT_EQ(plan.steps[0].addr, 0u);
+  EXPECT_EQ(plan.steps[0].len, 256u);
+  EXPECT_EQ(plan.steps[1].type, LIBHOTH_SPI_PROXY_STEP_ERASE_4K);
+  EXPECT_EQ(plan.steps[1].addr, 5u * 4096);
+  EXPECT_EQ(plan.steps[2].type, LIBHOTH_SPI_PROXY_STEP_PROGRAM);
+  EXPECT_EQ(plan.steps[2].addr, 5u * 4096);
+  EXPECT_EQ(plan.steps[2].len, 4096u);
+  EXPECT_EQ(plan.steps[3].type, LIBHOTH_SPI_PROXY_STEP_ERASE_64K);
+  EXPECT_EQ(plan.steps[3].addr, 2u * 65536);
+  EXPECT_EQ(plan.steps[4].type, LIBHOTH_SPI_PROXY_STEP_PROGRAM);
+  EXPECT_EQ(plan.steps[4].addr, 2u * 65536);
+  EXPECT_EQ(plan.steps[4].len, 65536u);
+
+  EXPECT_EQ(libhoth_spi_proxy_apply_plan(&spi, &plan, image.data(), nullptr),
+            0);
+  libhoth_spi_proxy_plan_destroy(&plan);
+  EXPECT_EQ(fake.flash(), image);
+
+  // Nothing left to do.
+  ASSERT_EQ(libhoth_spi_proxy_plan_update(&spi, 0, image.data(), image.size(),
+                                          /*read_flash=*/true, &plan),
+            0);
+  EXPECT_EQ(plan.num_steps, 0u);
+  libhoth_spi_proxy_plan_destroy(&plan);
+}
+
+TEST_F(LibHothTest, spi_proxy_plan_keeps_data_around_range) {
+  constexpr size_t kSize = 64 * 1024;
+  FakeSpiFlash fake(kSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  fake.flash() = MakeImage(kSize);
+  std::vector<uint8_t> image(kSize - 2 * 4096, 0x00);
+  struct libhoth_spi_proxy spi = {.dev = &hoth_dev_, .is_4_byte = false};
+  struct libhoth_spi_proxy_plan plan;
+  ASSERT_EQ(libhoth_spi_proxy_plan_update(&spi, 4096, image.data(),
+                                          image.size(), /*read_flash=*/true,
+                                          &plan),
+            0);
+  // The range only needs bits cleared, and the first and last sectors aren't
+  // part of it, so nothing is erased.
+  for (size_t i = 0; i < plan.num_steps; ++i) {
+    EXPECT_EQ(plan.steps[i].type, LIBHOTH_SPI_PROXY_STEP_PROGRAM);
+  }
+  const std::vector<uint8_t> old_image = fake.flash();
+  EXPECT_EQ(libhoth_spi_proxy_apply_plan(&spi, &plan, image.data(), nullptr),
+            0);
+  libhoth_spi_proxy_plan_destroy(&plan);
+  EXPECT_TRUE(std::equal(old_image.begin(), old_image.begin() + 4096,
+                         fake.flash().begin()));
+  EXPECT_TRUE(std::equal(image.begin(), image.end(),
+                         fake.flash().begin() + 4096));
+  EXPECT_TRUE(std::equal(old_image.end() - 4096, old_image.end(),
+                         fake.flash().end() - 4096));
+}
+
+TEST_F(LibHothTest, spi_proxy_read_window) {
+  constexpr size_t kSize = 64 * 1024;
+  FakeSpiFlash fake(kSize, /*is_4_byte=*/true);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  fake.flash() = MakeImage(kSize);
+  struct libhoth_spi_proxy spi = {
+      .dev = &hoth_dev_, .is_4_byte = true, .window = 3};
+  hoth_dev_.queue_depth = 3;
+  std::vector<uint8_t> buf(kSize - 1000);
+  EXPECT_EQ(libhoth_spi_proxy_read(&spi, 1000, buf.data(), buf.size()), 0);
+  EXPECT_TRUE(
+      std::equal(buf.begin(), buf.end(), fake.flash().begin() + 1000));
+
+  // A transport that holds a single request limits the window to 1.
+  hoth_dev_.queue_depth = 1;
+  std::fill(buf.begin(), buf.end(), 0);
+  EXPECT_EQ(libhoth_spi_proxy_read(&spi, 1000, buf.data(), buf.size()), 0);
+  EXPECT_TRUE(
+      std::equal(buf.begin(), buf.end(), fake.flash().begin() + 1000));
+}
+
+TEST_F(LibHothTest, spi_proxy_readv) {
+  constexpr size_t kSize = 64 * 1024;
+  FakeSpiFlash fake(kSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  fake.flash() = MakeImage(kSize);
+  struct libhoth_spi_proxy spi = {.dev = &hoth_dev_, .is_4_byte = false};
+
+  // Small scattered reads share one SPI_OPERATION.
+  std::vector<std::vector<uint8_t>> bufs(20, std::vector<uint8_t>(32));
+  std::vector<struct libhoth_spi_proxy_segment> segs;
+  for (size_t i = 0; i < bufs.size(); ++i) {
+    segs.push_back({.addr = static_cast<uint32_t>(i * 3000 + 7),
+                    .len = bufs[i].size(),
+                    .buf = bufs[i].data()});
+  }
+  EXPECT_EQ(libhoth_spi_proxy_readv(&spi, segs.data(), segs.size()), 0);
+  EXPECT_EQ(fake.ops(), 1);
+  for (size_t i = 0; i < bufs.size(); ++i) {
+    EXPECT_TRUE(std::equal(bufs[i].begin(), bufs[i].end(),
+                           fake.flash().begin() + segs[i].addr));
+  }
+
+  // Large segments are split across as many as needed.
+  std::vector<uint8_t> big(5000);
+  std::vector<uint8_t> small(10);
+  const struct libhoth_spi_proxy_segment more[] = {
+      {.addr = 100, .len = big.size(), .buf = big.data()},
+      {.addr = 60000, .len = small.size(), .buf = small.data()},
+  };
+  EXPECT_EQ(libhoth_spi_proxy_readv(&spi, more, 2), 0);
+  EXPECT_EQ(fake.ops(), 1 + 5);
+  EXPECT_TRUE(std::equal(big.begin(), big.end(), fake.flash().begin() + 100));
+  EXPECT_TRUE(
+      std::equal(small.begin(), small.end(), fake.flash().begin() + 60000));
+}
+
+TEST_F(LibHothTest, spi_proxy_cache) {
+  constexpr size_t kSize = 256 * 1024;
+  FakeSpiFlash fake(kSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  fake.flash() = MakeImage(kSize);
+  const std::string path = testing::TempDir() + "/spi_proxy_cache";
+  const std::string key = "image-hash";
+  std::remove(path.c_str());
+  struct libhoth_spi_proxy spi = {.dev = &hoth_dev_, .is_4_byte = false};
+  ASSERT_EQ(libhoth_spi_proxy_open_cache(&spi, path.c_str(), key.data(),
+                                         key.size()),
+            0);
+  const int open_ops = fake.ops();
+
+  // The second read of a range is served from the cache.
+  std::vector<uint8_t> buf(10000);
+  ASSERT_EQ(libhoth_spi_proxy_read(&spi, 1000, buf.data(), buf.size()), 0);
+  EXPECT_TRUE(std::equal(buf.begin(), buf.end(), fake.flash().begin() + 1000));
+  const int read_ops = fake.ops();
+  EXPECT_GT(read_ops, open_ops);
+  std::vector<uint8_t> again(buf.size());
+  ASSERT_EQ(libhoth_spi_proxy_read(&spi, 1000, again.data(), again.size()), 0);
+  EXPECT_EQ(again, buf);
+  EXPECT_EQ(fake.ops(), read_ops);
+
+  // As are vectored reads within it, while the rest is read in one go.
+  std::vector<uint8_t> inside(32);
+  std::vector<uint8_t> outside(32);
+  const struct libhoth_spi_proxy_segment segs[] = {
+      {.addr = 2000, .len = inside.size(), .buf = inside.data()},
+      {.addr = 100000, .len = outside.size(), .buf = outside.data()},
+  };
+  ASSERT_EQ(libhoth_spi_proxy_readv(&spi, segs, 2), 0);
+  EXPECT_EQ(fake.ops(), read_ops + 1);
+  EXPECT_TRUE(
+      std::equal(inside.begin(), inside.end(), fake.flash().begin() + 2000));
+  EXPECT_TRUE(std::equal(outside.begin(), outside.end(),
+                         fake.flash().begin() + 100000));
+  ASSERT_EQ(libhoth_spi_proxy_close_cache(&spi), 0);
+
+  // The cache is saved, and used by the next run.
+  ASSERT_EQ(libhoth_spi_proxy_open_cache(&spi, path.c_str(), key.data(),
+                                         key.size()),
+            0);
+  int ops = fake.ops();
+  ASSERT_EQ(libhoth_spi_proxy_read(&spi, 1000, again.data(), again.size()), 0);
+  EXPECT_EQ(again, buf);
+  EXPECT_EQ(fake.ops(), ops);
+
+  // Updates drop what they change.
+  const std::vector<uint8_t> update(4096, 0x5a);
+  ASSERT_EQ(libhoth_spi_proxy_update(&spi, 4096, update.data(), update.size(),
+                                     nullptr),
+            0);
+  ops = fake.ops();
+  ASSERT_EQ(libhoth_spi_proxy_read(&spi, 1000, again.data(), again.size()), 0);
+  EXPECT_GT(fake.ops(), ops);
+  EXPECT_TRUE(
+      std::equal(again.begin(), again.end(), fake.flash().begin() + 1000));
+  EXPECT_EQ(again[4096 - 1000], 0x5a);
+
+  // After which the saved cache no longer matches its key.
+  ASSERT_EQ(libhoth_spi_proxy_close_cache(&spi), 0);
+  EXPECT_NE(access(path.c_str(), F_OK), 0);
+}
+
+constexpr char kTestPayload[] = "protocol/test/test_payload.bin";
+// Where the test payload is put in the flash, and where its descriptor is.
+constexpr uint32_t kPayloadAddr = 0x400000;
+constexpr uint32_t kPayloadDescriptorAddr = kPayloadAddr + 0x20000;
+
+static std::vector<uint8_t> ReadTestPayload() {
+  std::ifstream file(kTestPayload, std::ios::binary);
+  EXPECT_TRUE(file.good());
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+TEST_F(LibHothTest, spi_proxy_payload_info) {
+  constexpr size_t kSize = 8 * 1024 * 1024;
+  FakeSpiFlash fake(kSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  const std::vector<uint8_t> payload = ReadTestPayload();
+  ASSERT_FALSE(payload.empty());
+  std::copy(payload.begin(), payload.end(),
+            fake.flash().begin() + kPayloadAddr);
+  struct libhoth_spi_proxy spi = {.dev = &hoth_dev_, .is_4_byte = false};
+
+  uint32_t descr_addr;
+  struct image_descriptor* descr;
+  ASSERT_EQ(libhoth_spi_proxy_find_image_descriptor(&spi, kSize, &descr_addr,
+                                                    &descr),
+            0);
+  EXPECT_EQ(descr_addr, kPayloadDescriptorAddr);
+  EXPECT_EQ(descr->region_count, 8);
+  free(descr);
+  // The magics in two ops, then the descriptor and the rest.
+  EXPECT_EQ(fake.ops(), 4);
+
+  struct payload_info expected;
+  ASSERT_TRUE(libhoth_payload_info(payload.data(), payload.size(), &expected));
+  struct payload_info info;
+  ASSERT_EQ(libhoth_spi_proxy_payload_info(&spi, kSize, &info), 0);
+  EXPECT_STREQ(info.image_name, expected.image_name);
+  EXPECT_EQ(info.image_family, expected.image_family);
+  EXPECT_EQ(info.image_version.major, expected.image_version.major);
+  EXPECT_EQ(info.image_type, expected.image_type);
+  EXPECT_EQ(0, std::memcmp(info.image_hash, expected.image_hash,
+                           sizeof(info.image_hash)));
+
+  // A descriptor that runs off the end of the flash isn't used.
+  EXPECT_NE(libhoth_spi_proxy_payload_info(
+                &spi, kPayloadDescriptorAddr + 0x10000, &info),
+            0);
+  // Nor is anything without the magic.
+  fake.flash()[kPayloadDescriptorAddr] ^= 1;
+  EXPECT_NE(libhoth_spi_proxy_payload_info(&spi, kSize, &info), 0);
+}
+
+TEST_F(LibHothTest, spi_proxy_image_cache) {
+  constexpr size_t kSize = 8 * 1024 * 1024;
+  FakeSpiFlash fake(kSize);
+  EXPECT_CALL(mock_, send)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Send));
+  EXPECT_CALL(mock_, receive)
+      .WillRepeatedly(testing::Invoke(&fake, &FakeSpiFlash::Receive));
+
+  const std::vector<uint8_t> payload = ReadTestPayload();
+  ASSERT_FALSE(payload.empty());
+  std::copy(payload.begin(), payload.end(),
+            fake.flash().begin() + kPayloadAddr);
+  const std::string path = testing::TempDir() + "/spi_proxy_image_cache";
+  std::remove(path.c_str());
+  struct libhoth_spi_proxy spi = {.dev = &hoth_dev_, .is_4_byte = false};
+
+  ASSERT_EQ(libhoth_spi_proxy_open_image_cache(&spi, path.c_str(), kSize), 0);
+  std::vector<uint8_t> buf(0x80000 + 0x1000);
+  ASSERT_EQ(libhoth_spi_proxy_read(&spi, kPayloadAddr - 0x1000, buf.data(),
+                                   buf.size()),
+            0);
+  ASSERT_EQ(libhoth_spi_proxy_close_cache(&spi), 0);
+
+  ASSERT_EQ(libhoth_spi_proxy_open_image_cache(&spi, path.c_str(), kSize), 0);
+  // The static "bootcode" and "readable" regions come from the file.
+  const int ops = fake.ops();
+  std::vector<uint8_t> region(0x1000);
+  ASSERT_EQ(libhoth_spi_proxy_read(&spi, kPayloadAddr, region.data(),
+                                   region.size()),
+            0);
+  ASSERT_EQ(libhoth_spi_proxy_read(&spi, kPayloadAddr + 0x40000,
+                                   region.data(), region.size()),
+            0);
+  EXPECT_EQ(fake.ops(), ops);
+  EXPECT_TRUE(std::equal(region.begin(), region.end(),
+                         fake.flash().begin() + kPayloadAddr + 0x40000));
+
+  // The hash doesn't cover the "writeable" region, the descriptor, or what
+  // comes before the image.
+  for (uint32_t addr : {kPayloadAddr + 0x60000, kPayloadDescriptorAddr,
+                        kPayloadAddr - 0x1000}) {
+    const int before = fake.ops();
+    ASSERT_EQ(
+        libhoth_spi_proxy_read(&spi, addr, region.data(), region.size()), 0);
+    EXPECT_GT(fake.ops(), before) << std::hex << addr;
+  }
+  ASSERT_EQ(libhoth_spi_proxy_close_cache(&spi), 0);
+}
@@ -19,6 +19,13 @@ LibHothTest::LibHothTest() {
   hoth_dev_.send = send;
   hoth_dev_.receive = receive;
 
+  // Exercise the generic scatter/gather fallbacks in libhoth_device.c
+  hoth_dev_.sendv = nullptr;
+  hoth_dev_.receivev = nullptr;
+
+  // One request at a time, unless a test queues more.
+  hoth_dev_.queue_depth = 0;
+
   // protocol operations should never touch these
   hoth_dev_.close = nullptr;
   hoth_dev_.claim = nullptr;
@@ -0,0 +1,229 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "transports/libhoth_broker.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "transports/libhoth_device.h"
+#include "transports/libhoth_ec.h"
+
+struct libhoth_broker_device {
+  int fd;
+
+  // The response to the last request, as far as it has been received. Kept
+  // across receive calls so a timed-out receive can be resumed.
+  uint8_t response[LIBHOTH_MAILBOX_SIZE];
+  size_t response_len;
+};
+
+static int64_t monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int libhoth_broker_send_request(struct libhoth_device* dev,
+                                       const void* request,
+                                       size_t request_size) {
+  if (dev == NULL || request == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  struct libhoth_broker_device* broker_dev =
+      (struct libhoth_broker_device*)dev->user_ctx;
+
+  broker_dev->response_len = 0;
+  const uint8_t* buf = (const uint8_t*)request;
+  while (request_size > 0) {
+    ssize_t rc = send(broker_dev->fd, buf, request_size, MSG_NOSIGNAL);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("Failed to send request to broker");
+      return LIBHOTH_ERR_FAIL;
+    }
+    buf += rc;
+    request_size -= rc;
+  }
+  return LIBHOTH_OK;
+}
+
+static int libhoth_broker_receive_response(struct libhoth_device* dev,
+                                           void* response,
+                                           size_t max_response_size,
+                                           size_t* actual_size,
+                                           int timeout_ms) {
+  if (dev == NULL || response == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  struct libhoth_broker_device* broker_dev =
+      (struct libhoth_broker_device*)dev->user_ctx;
+
+  const int64_t deadline = monotonic_ms() + timeout_ms;
+  while (true) {
+    // Until the header is in, only ask for the header.
+    size_t expected_len = sizeof(struct hoth_host_response);
+    if (broker_dev->response_len >= sizeof(struct hoth_host_response)) {
+      struct hoth_host_response header;
+      memcpy(&header, broker_dev->response, sizeof(header));
+      expected_len += header.data_len;
+      if (expected_len > sizeof(broker_dev->response)) {
+        fprintf(stderr, "Broker response too large: %zu bytes\n",
+                expected_len);
+        return LIBHOTH_ERR_FAIL;
+      }
+    }
+    if (broker_dev->response_len == expected_len) {
+      break;
+    }
+
+    struct pollfd pfd = {.fd = broker_dev->fd, .events = POLLIN};
+    int wait_ms = -1;
+    if (timeout_ms >= 0) {
+      const int64_t remaining = deadline - monotonic_ms();
+      wait_ms = remaining > 0 ? (int)remaining : 0;
+    }
+    int rc = poll(&pfd, 1, wait_ms);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return LIBHOTH_ERR_FAIL;
+    }
+    if (rc == 0) {
+      return LIBHOTH_ERR_TIMEOUT;
+    }
+
+    ssize_t bytes_read =
+        read(broker_dev->fd, broker_dev->response + broker_dev->response_len,
+             expected_len - broker_dev->response_len);
+    if (bytes_read < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      perror("Failed to read response from broker");
+      return LIBHOTH_ERR_FAIL;
+    }
+    if (bytes_read == 0) {
+      fprintf(stderr, "Broker closed the connection\n");
+      return LIBHOTH_ERR_FAIL;
+    }
+    broker_dev->response_len += bytes_read;
+  }
+
+  const size_t response_len = broker_dev->response_len;
+  broker_dev->response_len = 0;
+  if (response_len > max_response_size) {
+    return LIBHOTH_ERR_RESPONSE_BUFFER_OVERFLOW;
+  }
+  memcpy(response, broker_dev->response, response_len);
+  if (actual_size) {
+    *actual_size = response_len;
+  }
+  return LIBHOTH_OK;
+}
+
+static int libhoth_broker_close(struct libhoth_device* dev) {
+  if (dev == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  struct libhoth_broker_device* broker_dev =
+      (struct libhoth_broker_device*)dev->user_ctx;
+  close(broker_dev->fd);
+  free(dev->user_ctx);
+  return LIBHOTH_OK;
+}
+
+static int libhoth_broker_claim(struct libhoth_device* dev) {
+  // no-op; the broker holds the device.
+  return LIBHOTH_OK;
+}
+
+static int libhoth_broker_release(struct libhoth_device* dev) {
+  // no-op
+  return LIBHOTH_OK;
+}
+
+int libhoth_broker_open_fd(int fd, struct libhoth_device** out) {
+  if (out == NULL || fd < 0) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+
+  struct libhoth_device* dev = calloc(1, sizeof(struct libhoth_device));
+  struct libhoth_broker_device* broker_dev =
+      calloc(1, sizeof(struct libhoth_broker_device));
+  if (dev == NULL || broker_dev == NULL) {
+    free(dev);
+    free(broker_dev);
+    return LIBHOTH_ERR_MALLOC_FAILED;
+  }
+
+  broker_dev->fd = fd;
+
+  dev->send = libhoth_broker_send_request;
+  dev->receive = libhoth_broker_receive_response;
+  dev->close = libhoth_broker_close;
+  dev->claim = libhoth_broker_claim;
+  dev->release = libhoth_broker_release;
+  dev->user_ctx = broker_dev;
+
+  *out = dev;
+  return LIBHOTH_OK;
+}
+
+int libhoth_broker_open(
+    const struct libhoth_broker_device_init_options* options,
+    struct libhoth_device** out) {
+  if (out == NULL || options == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+
+  const char* socket_path = options->socket_path;
+  if (socket_path == NULL || strlen(socket_path) == 0) {
+    socket_path = LIBHOTH_BROKER_DEFAULT_SOCKET;
+  }
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  strcpy(addr.sun_path, socket_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return LIBHOTH_ERR_FAIL;
+  }
+  if (connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    fprintf(stderr, "Failed to connect to broker at %s: %s\n", socket_path,
+            strerror(errno));
+    close(fd);
+    return LIBHOTH_ERR_INTERFACE_NOT_FOUND;
+  }
+
+  int status = libhoth_broker_open_fd(fd, out);
+  if (status != LIBHOTH_OK) {
+    close(fd);
+  }
+  return status;
+}
@@ -0,0 +1,55 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LIBHOTH_LIBHOTH_BROKER_H_
+#define _LIBHOTH_LIBHOTH_BROKER_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIBHOTH_BROKER_DEFAULT_SOCKET "/run/libhoth_broker.sock"
+
+struct libhoth_device;
+
+// A broker is a long-lived process that keeps a RoT open and forwards host
+// commands to it on behalf of its clients, saving each client the cost of
+// finding, opening and claiming the device. Clients connect to the broker's
+// UNIX stream socket and write raw host command requests (struct
+// hoth_host_request followed by its payload); the broker replies with the
+// raw response (struct hoth_host_response followed by its payload). This is
+// the same framing as `htool raw_host_command`.
+struct libhoth_broker_device_init_options {
+  // Path of the broker's socket. Defaults to LIBHOTH_BROKER_DEFAULT_SOCKET.
+  const char* socket_path;
+};
+
+// Note that the options struct only needs to to live for the duration of
+// this function call. It can be destroyed once libhoth_broker_open returns.
+int libhoth_broker_open(
+    const struct libhoth_broker_device_init_options* options,
+    struct libhoth_device** out);
+
+// Same as libhoth_broker_open(), but talks to the broker over `fd`, a stream
+// socket that is already connected. The device owns `fd` from then on, and
+// closes it in libhoth_device_close(), unless opening fails.
+int libhoth_broker_open_fd(int fd, struct libhoth_device** out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _LIBHOTH_LIBHOTH_BROKER_H_
@@ -0,0 +1,228 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "transports/libhoth_broker.h"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "transports/libhoth_device.h"
+#include "transports/libhoth_ec.h"
+
+namespace {
+
+// Talks to a broker device over a socketpair, playing the broker's side on
+// `broker_fd_`.
+class LibHothBrokerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+    broker_fd_ = fds[0];
+    ASSERT_EQ(libhoth_broker_open_fd(fds[1], &dev_), LIBHOTH_OK);
+  }
+
+  void TearDown() override {
+    if (dev_ != nullptr) {
+      EXPECT_EQ(libhoth_device_close(dev_), LIBHOTH_OK);
+    }
+    if (broker_fd_ >= 0) {
+      close(broker_fd_);
+    }
+  }
+
+  void BrokerWrite(const void* buf, size_t len) {
+    ASSERT_EQ(write(broker_fd_, buf, len), static_cast<ssize_t>(len));
+  }
+
+  std::vector<uint8_t> BrokerRead(size_t len) {
+    std::vector<uint8_t> buf(len);
+    size_t pos = 0;
+    while (pos < len) {
+      ssize_t n = read(broker_fd_, buf.data() + pos, len - pos);
+      EXPECT_GT(n, 0);
+      if (n <= 0) {
+        break;
+      }
+      pos += n;
+    }
+    return buf;
+  }
+
+  struct libhoth_device* dev_ = nullptr;
+  int broker_fd_ = -1;
+};
+
+std::vector<uint8_t> MakeResponse(size_t payload_len) {
+  struct hoth_host_response header = {};
+  header.struct_version = 3;
+  header.data_len = payload_len;
+  std::vector<uint8_t> response(sizeof(header) + payload_len);
+  std::memcpy(response.data(), &header, sizeof(header));
+  for (size_t i = 0; i < payload_len; ++i) {
+    response[sizeof(header) + i] = static_cast<uint8_t>(i * 7);
+  }
+  return response;
+}
+
+TEST_F(LibHothBrokerTest, RequestIsForwardedAsIs) {
+  std::vector<uint8_t> request(100);
+  for (size_t i = 0; i < request.size(); ++i) {
+    request[i] = static_cast<uint8_t>(i);
+  }
+  ASSERT_EQ(libhoth_send_request(dev_, request.data(), request.size()),
+            LIBHOTH_OK);
+  EXPECT_EQ(BrokerRead(request.size()), request);
+}
+
+TEST_F(LibHothBrokerTest, ResponseIsFramedByItsHeader) {
+  // Two responses back to back; each receive takes exactly one.
+  const std::vector<uint8_t> first = MakeResponse(20);
+  const std::vector<uint8_t> second = MakeResponse(0);
+  BrokerWrite(first.data(), first.size());
+  BrokerWrite(second.data(), second.size());
+
+  uint8_t response[LIBHOTH_MAILBOX_SIZE];
+  size_t actual_size = 0;
+  ASSERT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 1000),
+            LIBHOTH_OK);
+  ASSERT_EQ(actual_size, first.size());
+  EXPECT_EQ(std::memcmp(response, first.data(), first.size()), 0);
+
+  ASSERT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 1000),
+            LIBHOTH_OK);
+  ASSERT_EQ(actual_size, second.size());
+  EXPECT_EQ(std::memcmp(response, second.data(), second.size()), 0);
+}
+
+TEST_F(LibHothBrokerTest, PartialResponseCanBeResumed) {
+  const std::vector<uint8_t> expected = MakeResponse(50);
+  uint8_t response[LIBHOTH_MAILBOX_SIZE];
+  size_t actual_size = 0;
+
+  EXPECT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 0),
+            LIBHOTH_ERR_TIMEOUT);
+  // Part of the header, then part of the payload.
+  BrokerWrite(expected.data(), 3);
+  EXPECT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 0),
+            LIBHOTH_ERR_TIMEOUT);
+  BrokerWrite(expected.data() + 3, 20);
+  EXPECT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 10),
+            LIBHOTH_ERR_TIMEOUT);
+  BrokerWrite(expected.data() + 23, expected.size() - 23);
+  ASSERT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 1000),
+            LIBHOTH_OK);
+  ASSERT_EQ(actual_size, expected.size());
+  EXPECT_EQ(std::memcmp(response, expected.data(), expected.size()), 0);
+}
+
+TEST_F(LibHothBrokerTest, NewRequestDiscardsPartialResponse) {
+  const std::vector<uint8_t> expected = MakeResponse(10);
+  BrokerWrite(expected.data(), 5);
+  uint8_t response[LIBHOTH_MAILBOX_SIZE];
+  size_t actual_size = 0;
+  EXPECT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 0),
+            LIBHOTH_ERR_TIMEOUT);
+
+  const uint8_t request[8] = {};
+  ASSERT_EQ(libhoth_send_request(dev_, request, sizeof(request)), LIBHOTH_OK);
+  BrokerRead(sizeof(request));
+  BrokerWrite(expected.data(), expected.size());
+  // Framing restarts with the new response.
+  ASSERT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 1000),
+            LIBHOTH_OK);
+  EXPECT_EQ(actual_size, expected.size());
+}
+
+TEST_F(LibHothBrokerTest, OversizedResponseIsRejected) {
+  struct hoth_host_response header = {};
+  header.data_len = LIBHOTH_MAILBOX_SIZE;
+  BrokerWrite(&header, sizeof(header));
+
+  uint8_t response[LIBHOTH_MAILBOX_SIZE];
+  size_t actual_size = 0;
+  EXPECT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 1000),
+            LIBHOTH_ERR_FAIL);
+}
+
+TEST_F(LibHothBrokerTest, ResponseLargerThanBuffer) {
+  const std::vector<uint8_t> expected = MakeResponse(100);
+  BrokerWrite(expected.data(), expected.size());
+
+  uint8_t response[50];
+  size_t actual_size = 0;
+  EXPECT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 1000),
+            LIBHOTH_ERR_RESPONSE_BUFFER_OVERFLOW);
+}
+
+TEST_F(LibHothBrokerTest, BrokerHangsUp) {
+  const std::vector<uint8_t> expected = MakeResponse(100);
+  BrokerWrite(expected.data(), 10);
+  close(broker_fd_);
+  broker_fd_ = -1;
+
+  uint8_t response[LIBHOTH_MAILBOX_SIZE];
+  size_t actual_size = 0;
+  EXPECT_EQ(libhoth_receive_response(dev_, response, sizeof(response),
+                                     &actual_size, 1000),
+            LIBHOTH_ERR_FAIL);
+  // Doesn't raise SIGPIPE.
+  const uint8_t request[8] = {};
+  EXPECT_EQ(libhoth_send_request(dev_, request, sizeof(request)),
+            LIBHOTH_ERR_FAIL);
+}
+
+TEST(LibHothBrokerOpenTest, NoBroker) {
+  char dir[] = "/tmp/libhoth_broker_test.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string path = std::string(dir) + "/broker.sock";
+  const struct libhoth_broker_device_init_options options = {
+      .socket_path = path.c_str(),
+  };
+  struct libhoth_device* dev = nullptr;
+  EXPECT_EQ(libhoth_broker_open(&options, &dev),
+            LIBHOTH_ERR_INTERFACE_NOT_FOUND);
+  EXPECT_EQ(dev, nullptr);
+  rmdir(dir);
+}
+
+TEST(LibHothBrokerOpenTest, InvalidParameters) {
+  struct libhoth_device* dev = nullptr;
+  EXPECT_EQ(libhoth_broker_open_fd(-1, &dev), LIBHOTH_ERR_INVALID_PARAMETER);
+  const std::string long_path(200, 'x');
+  const struct libhoth_broker_device_init_options options = {
+      .socket_path = long_path.c_str(),
+  };
+  EXPECT_EQ(libhoth_broker_open(&options, &dev),
+            LIBHOTH_ERR_INVALID_PARAMETER);
+}
+
+}  // namespace
@@ -14,7 +14,10 @@
 
 #include "transports/libhoth_device.h"
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
 
 int libhoth_send_request(struct libhoth_device* dev, const void* request,
                          size_t request_size) {
@@ -34,6 +37,52 @@ int libhoth_receive_response(struct libhoth_device* dev, void* response,
                       timeout_ms);
 }
 
+int libhoth_send_requestv(struct libhoth_device* dev, const struct iovec* iov,
+                          int iovcnt) {
+  if (dev == NULL || iov == NULL || iovcnt < 0 || iovcnt > LIBHOTH_IOV_MAX) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  if (dev->sendv != NULL) {
+    return dev->sendv(dev, iov, iovcnt);
+  }
+
+  uint8_t buf[LIBHOTH_MAILBOX_SIZE];
+  size_t request_size = libhoth_iov_length(iov, iovcnt);
+  if (request_size > sizeof(buf)) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  libhoth_iov_gather(buf, sizeof(buf), iov, iovcnt);
+  return dev->send(dev, buf, request_size);
+}
+
+int libhoth_receive_responsev(struct libhoth_device* dev,
+                              const struct iovec* iov, int iovcnt,
+                              size_t* actual_size, int timeout_ms) {
+  if (dev == NULL || iov == NULL || iovcnt < 0 || iovcnt > LIBHOTH_IOV_MAX) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  if (dev->receivev != NULL) {
+    return dev->receivev(dev, iov, iovcnt, actual_size, timeout_ms);
+  }
+
+  uint8_t buf[LIBHOTH_MAILBOX_SIZE];
+  size_t max_response_size = MIN(libhoth_iov_length(iov, iovcnt), sizeof(buf));
+  size_t response_size = 0;
+  int status = dev->receive(dev, buf, max_response_size, &response_size,
+                            timeout_ms);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
+  if (response_size > max_response_size) {
+    return LIBHOTH_ERR_RESPONSE_BUFFER_OVERFLOW;
+  }
+  libhoth_iov_scatter(iov, iovcnt, buf, response_size);
+  if (actual_size) {
+    *actual_size = response_size;
+  }
+  return LIBHOTH_OK;
+}
+
 int libhoth_device_close(struct libhoth_device* dev) {
   if (dev == NULL) {
     return LIBHOTH_ERR_INVALID_PARAMETER;
@@ -43,3 +92,43 @@ int libhoth_device_close(struct libhoth_device* dev) {
   free(dev);
   return status;
 }
+
+int libhoth_device_queue_depth(const struct libhoth_device* dev) {
+  return MAX(dev->queue_depth, 1);
+}
+
+size_t libhoth_iov_length(const struct iovec* iov, int iovcnt) {
+  size_t len = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    len += iov[i].iov_len;
+  }
+  return len;
+}
+
+size_t libhoth_iov_gather(void* buf, size_t len, const struct iovec* iov,
+                          int iovcnt) {
+  uint8_t* dst = (uint8_t*)buf;
+  size_t copied = 0;
+  for (int i = 0; i < iovcnt && copied < len; i++) {
+    size_t n = MIN(iov[i].iov_len, len - copied);
+    if (n > 0) {
+      memcpy(dst + copied, iov[i].iov_base, n);
+    }
+    copied += n;
+  }
+  return copied;
+}
+
+size_t libhoth_iov_scatter(const struct iovec* iov, int iovcnt,
+                           const void* buf, size_t len) {
+  const uint8_t* src = (const uint8_t*)buf;
+  size_t copied = 0;
+  for (int i = 0; i < iovcnt && copied < len; i++) {
+    size_t n = MIN(iov[i].iov_len, len - copied);
+    if (n > 0) {
+      memcpy(iov[i].iov_base, src + copied, n);
+    }
+    copied += n;
+  }
+  return copied;
+}
@@ -16,6 +16,7 @@
 #define _LIBHOTH_TRANSPORTS_LIBHOTH_DEVICE_H_
 
 #include <stddef.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +24,10 @@ extern "C" {
 
 #define LIBHOTH_MAILBOX_SIZE 1024
 
+// Maximum number of iovec elements accepted by libhoth_send_requestv() and
+// libhoth_receive_responsev().
+#define LIBHOTH_IOV_MAX 16
+
 typedef enum {
   LIBHOTH_OK = 0,
   LIBHOTH_ERR_UNKNOWN_VENDOR = 1,
@@ -47,6 +52,18 @@ struct libhoth_device {
   int (*claim)(struct libhoth_device *dev);
   int (*release)(struct libhoth_device *dev);
 
+  // Optional scatter/gather variants of send and receive. Transports that
+  // leave these NULL get a generic implementation that stages the data
+  // through a bounce buffer and calls send/receive.
+  int (*sendv)(struct libhoth_device *dev, const struct iovec *iov,
+               int iovcnt);
+  int (*receivev)(struct libhoth_device *dev, const struct iovec *iov,
+                  int iovcnt, size_t *actual_size, int timeout_ms);
+
+  // Number of requests the transport can have outstanding at once. Most
+  // transports hold a single request, and leave this 0.
+  int queue_depth;
+
   void *user_ctx;
 };
 
@@ -69,8 +86,37 @@ int libhoth_receive_response(struct libhoth_device *dev, void *response,
                              size_t max_response_size, size_t *actual_size,
                              int timeout_ms);
 
+// Same as libhoth_send_request(), but the request is the concatenation of
+// the `iovcnt` buffers described by `iov`.
+int libhoth_send_requestv(struct libhoth_device *dev, const struct iovec *iov,
+                          int iovcnt);
+
+// Same as libhoth_receive_response(), but the response is scattered across
+// the `iovcnt` buffers described by `iov`, filling each one before moving on
+// to the next. `actual_size` is the total number of bytes received.
+int libhoth_receive_responsev(struct libhoth_device *dev,
+                              const struct iovec *iov, int iovcnt,
+                              size_t *actual_size, int timeout_ms);
+
 int libhoth_device_close(struct libhoth_device *dev);
 
+// Returns how many requests can be sent to `dev` before their responses are
+// received; at least 1.
+int libhoth_device_queue_depth(const struct libhoth_device *dev);
+
+// Returns the sum of the lengths of the buffers described by `iov`.
+size_t libhoth_iov_length(const struct iovec *iov, int iovcnt);
+
+// Copies up to `len` bytes from the buffers described by `iov` into `buf`.
+// Returns the number of bytes copied.
+size_t libhoth_iov_gather(void *buf, size_t len, const struct iovec *iov,
+                          int iovcnt);
+
+// Copies up to `len` bytes from `buf` into the buffers described by `iov`.
+// Returns the number of bytes copied.
+size_t libhoth_iov_scatter(const struct iovec *iov, int iovcnt,
+                           const void *buf, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "transports/libhoth_device.h"
@@ -30,6 +31,11 @@
 struct libhoth_mtd_device {
   int fd;
   unsigned int mailbox_address;
+
+  // Mapping containing the mailbox, or NULL to use read()/write().
+  void* map;
+  size_t map_size;
+  volatile uint8_t* mailbox;
 };
 
 int libhoth_mtd_send_request(struct libhoth_device* dev, const void* request,
@@ -98,6 +104,71 @@ static int mtd_write(int fd, unsigned int address, const void* data,
   return LIBHOTH_OK;
 }
 
+// Copies into the mapped mailbox with volatile accesses, 32 bits at a time
+// where alignment allows, so the compiler can't merge, split or drop them.
+static void mtd_mmio_write(volatile uint8_t* dst, const uint8_t* src,
+                           size_t len) {
+  while (len > 0 && ((uintptr_t)dst & 3)) {
+    *dst++ = *src++;
+    len--;
+  }
+  for (; len >= 4; len -= 4, dst += 4, src += 4) {
+    uint32_t word;
+    memcpy(&word, src, sizeof(word));
+    *(volatile uint32_t*)dst = word;
+  }
+  while (len-- > 0) {
+    *dst++ = *src++;
+  }
+}
+
+static void mtd_mmio_read(uint8_t* dst, const volatile uint8_t* src,
+                          size_t len) {
+  while (len > 0 && ((uintptr_t)src & 3)) {
+    *dst++ = *src++;
+    len--;
+  }
+  for (; len >= 4; len -= 4, dst += 4, src += 4) {
+    uint32_t word = *(const volatile uint32_t*)src;
+    memcpy(dst, &word, sizeof(word));
+  }
+  while (len-- > 0) {
+    *dst++ = *src++;
+  }
+}
+
+// Maps the mailbox at `offset` in `fd`. mmap() needs a page-aligned offset,
+// so the mapping may start a little before the mailbox.
+static int mtd_map_mailbox(struct libhoth_mtd_device* mtd_dev, int fd,
+                           off_t offset) {
+  const off_t page_mask = ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+  const off_t map_offset = offset & page_mask;
+  const size_t map_size = (offset - map_offset) + LIBHOTH_MAILBOX_SIZE;
+
+  void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                   map_offset);
+  if (map == MAP_FAILED) {
+    return LIBHOTH_ERR_FAIL;
+  }
+  mtd_dev->map = map;
+  mtd_dev->map_size = map_size;
+  mtd_dev->mailbox = (volatile uint8_t*)map + (offset - map_offset);
+  return LIBHOTH_OK;
+}
+
+static int mtd_map_mailbox_path(struct libhoth_mtd_device* mtd_dev,
+                                const char* path, off_t offset) {
+  // O_SYNC makes /dev/mem mappings uncached.
+  int fd = open(path, O_RDWR | O_SYNC | O_CLOEXEC);
+  if (fd < 0) {
+    return LIBHOTH_ERR_FAIL;
+  }
+  int status = mtd_map_mailbox(mtd_dev, fd, offset);
+  // The mapping stays valid after the fd is closed.
+  close(fd);
+  return status;
+}
+
 static int libhoth_mtd_claim(struct libhoth_device* dev) {
   // no-op
   return LIBHOTH_OK;
@@ -186,6 +257,19 @@ int libhoth_mtd_open(const struct libhoth_mtd_device_init_options* options,
   mtd_dev->fd = fd;
   mtd_dev->mailbox_address = options->mailbox;
 
+  if (options->use_mmap) {
+    if (options->mmap_path != NULL && strlen(options->mmap_path) > 0) {
+      status = mtd_map_mailbox_path(mtd_dev, options->mmap_path,
+                                    options->mmap_offset);
+    } else {
+      status = mtd_map_mailbox(mtd_dev, fd, options->mailbox);
+    }
+    if (status != LIBHOTH_OK) {
+      fprintf(stderr,
+              "Failed to map the MTD mailbox; falling back to read/write\n");
+    }
+  }
+
   dev->send = libhoth_mtd_send_request;
   dev->receive = libhoth_mtd_receive_response;
   dev->close = libhoth_mtd_close;
@@ -218,6 +302,18 @@ int libhoth_mtd_send_request(struct libhoth_device* dev, const void* request,
   struct libhoth_mtd_device* mtd_dev =
       (struct libhoth_mtd_device*)dev->user_ctx;
 
+  if (mtd_dev->mailbox != NULL) {
+    if (request == NULL || request_size == 0 ||
+        request_size > LIBHOTH_MAILBOX_SIZE) {
+      return LIBHOTH_ERR_INVALID_PARAMETER;
+    }
+    mtd_mmio_write(mtd_dev->mailbox, request, request_size);
+    // The request must be in the mailbox before anything that follows,
+    // like reading back the response.
+    __sync_synchronize();
+    return LIBHOTH_OK;
+  }
+
   return mtd_write(mtd_dev->fd, mtd_dev->mailbox_address, request,
                    request_size);
 }
@@ -240,9 +336,14 @@ int libhoth_mtd_receive_response(struct libhoth_device* dev, void* response,
       (struct libhoth_mtd_device*)dev->user_ctx;
 
   // Read Header From Mailbox
-  status = mtd_read(mtd_dev->fd, mtd_dev->mailbox_address, response, 8);
-  if (status != LIBHOTH_OK) {
-    return status;
+  if (mtd_dev->mailbox != NULL) {
+    __sync_synchronize();
+    mtd_mmio_read(response, mtd_dev->mailbox, 8);
+  } else {
+    status = mtd_read(mtd_dev->fd, mtd_dev->mailbox_address, response, 8);
+    if (status != LIBHOTH_OK) {
+      return status;
+    }
   }
 
   total_bytes = 8;
@@ -257,10 +358,18 @@ int libhoth_mtd_receive_response(struct libhoth_device* dev, void* response,
 
   // Read remainder of data based on header length
   uint8_t* const data_start = (uint8_t*)response + total_bytes;
-  status = mtd_read(mtd_dev->fd, mtd_dev->mailbox_address + total_bytes,
-                    data_start, host_response.data_len);
-  if (status != LIBHOTH_OK) {
-    return status;
+  if (mtd_dev->mailbox != NULL) {
+    if (total_bytes + host_response.data_len > LIBHOTH_MAILBOX_SIZE) {
+      return LIBHOTH_ERR_RESPONSE_BUFFER_OVERFLOW;
+    }
+    mtd_mmio_read(data_start, mtd_dev->mailbox + total_bytes,
+                  host_response.data_len);
+  } else {
+    status = mtd_read(mtd_dev->fd, mtd_dev->mailbox_address + total_bytes,
+                      data_start, host_response.data_len);
+    if (status != LIBHOTH_OK) {
+      return status;
+    }
   }
 
   if (actual_size) {
@@ -276,6 +385,9 @@ int libhoth_mtd_close(struct libhoth_device* dev) {
   }
   struct libhoth_mtd_device* mtd_dev =
       (struct libhoth_mtd_device*)dev->user_ctx;
+  if (mtd_dev->map != NULL) {
+    munmap(mtd_dev->map, mtd_dev->map_size);
+  }
   close(mtd_dev->fd);
   free(dev->user_ctx);
   return LIBHOTH_OK;
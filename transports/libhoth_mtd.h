@@ -30,6 +30,14 @@ struct libhoth_mtd_device_init_options {
   const char* name;
   // Address where mailbox is located
   unsigned int mailbox;
+  // If non-zero, map the mailbox into memory and access it directly instead
+  // of with lseek()/read()/write(). Falls back to those if the mailbox can't
+  // be mapped.
+  int use_mmap;
+  // Optional file to map the mailbox from instead of the MTD device, such as
+  // a UIO device or /dev/mem, and the offset of the mailbox within it.
+  const char* mmap_path;
+  unsigned long mmap_offset;
 };
 
 // Note that the options struct only needs to to live for the duration of
@@ -0,0 +1,280 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "transports/libhoth_mux.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "transports/libhoth_device.h"
+
+struct libhoth_mux {
+  struct libhoth_device* dev;
+  int drain_timeout_ms;
+
+  pthread_mutex_t lock;
+  pthread_cond_t turn_changed;
+  // Ticket lock: each send takes the next ticket and waits until it is being
+  // served, which gives clients their turns in the order they asked.
+  uint64_t next_ticket;
+  uint64_t now_serving;
+  size_t num_clients;
+  // Set while the response to an abandoned request is still due: one whose
+  // client was closed, or whose blocking receive timed out. Whoever takes the
+  // next turn drains it before sending. Only touched by the client holding
+  // the turn.
+  bool draining;
+};
+
+struct libhoth_mux_client {
+  struct libhoth_mux* mux;
+  // Whether this client has a request in flight, and so holds the turn.
+  bool pending;
+};
+
+static void mux_end_turn(struct libhoth_mux_client* client) {
+  struct libhoth_mux* mux = client->mux;
+  pthread_mutex_lock(&mux->lock);
+  client->pending = false;
+  mux->now_serving++;
+  pthread_cond_broadcast(&mux->turn_changed);
+  pthread_mutex_unlock(&mux->lock);
+}
+
+// Receives and throws away the response to an abandoned request. If it
+// times out, the response may still turn up, so `draining` stays set and the
+// next turn tries again. Other errors mean the transport has given up on the
+// response.
+static int mux_drain(struct libhoth_mux* mux) {
+  uint8_t response[LIBHOTH_MAILBOX_SIZE];
+  size_t response_size;
+  int status = libhoth_receive_response(mux->dev, response, sizeof(response),
+                                        &response_size, mux->drain_timeout_ms);
+  if (status != LIBHOTH_OK) {
+    fprintf(stderr, "Failed to drain abandoned response: %d\n", status);
+  }
+  mux->draining = status == LIBHOTH_ERR_TIMEOUT;
+  return status;
+}
+
+// Waits for the client's turn. Fails with LIBHOTH_ERR_INTERFACE_BUSY, having
+// passed the turn on, if an abandoned response is still due.
+static int mux_take_turn(struct libhoth_mux_client* client) {
+  struct libhoth_mux* mux = client->mux;
+  pthread_mutex_lock(&mux->lock);
+  const uint64_t ticket = mux->next_ticket++;
+  while (mux->now_serving != ticket) {
+    pthread_cond_wait(&mux->turn_changed, &mux->lock);
+  }
+  pthread_mutex_unlock(&mux->lock);
+
+  if (mux->draining && mux_drain(mux) == LIBHOTH_ERR_TIMEOUT) {
+    mux_end_turn(client);
+    return LIBHOTH_ERR_INTERFACE_BUSY;
+  }
+  return LIBHOTH_OK;
+}
+
+static int mux_check_send(struct libhoth_mux_client* client) {
+  if (client->pending) {
+    fprintf(stderr,
+            "Can't send a request while the previous one is in flight.\n");
+    return LIBHOTH_ERR_INTERFACE_BUSY;
+  }
+  return LIBHOTH_OK;
+}
+
+static int mux_check_receive(struct libhoth_mux_client* client) {
+  if (!client->pending) {
+    fprintf(stderr,
+            "Can't receive a response because there's no pending request.\n");
+    return LIBHOTH_ERR_FAIL;
+  }
+  return LIBHOTH_OK;
+}
+
+// Ends the turn unless a poll (`timeout_ms` == 0) found the response not yet
+// there, in which case the caller may try again. A blocking receive that
+// times out abandons the request, as the caller (e.g. libhoth_hostcmd_exec())
+// won't retry it, so the next turn drains its response if it turns up late.
+static int mux_finish_receive(struct libhoth_mux_client* client, int status,
+                              int timeout_ms) {
+  if (status == LIBHOTH_ERR_TIMEOUT) {
+    if (timeout_ms == 0) {
+      return status;
+    }
+    client->mux->draining = true;
+  }
+  mux_end_turn(client);
+  return status;
+}
+
+static int mux_send(struct libhoth_device* dev, const void* request,
+                    size_t request_size) {
+  struct libhoth_mux_client* client = dev->user_ctx;
+  int status = mux_check_send(client);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
+  status = mux_take_turn(client);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
+  status = libhoth_send_request(client->mux->dev, request, request_size);
+  if (status != LIBHOTH_OK) {
+    mux_end_turn(client);
+    return status;
+  }
+  client->pending = true;
+  return LIBHOTH_OK;
+}
+
+static int mux_sendv(struct libhoth_device* dev, const struct iovec* iov,
+                     int iovcnt) {
+  struct libhoth_mux_client* client = dev->user_ctx;
+  int status = mux_check_send(client);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
+  status = mux_take_turn(client);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
+  status = libhoth_send_requestv(client->mux->dev, iov, iovcnt);
+  if (status != LIBHOTH_OK) {
+    mux_end_turn(client);
+    return status;
+  }
+  client->pending = true;
+  return LIBHOTH_OK;
+}
+
+static int mux_receive(struct libhoth_device* dev, void* response,
+                       size_t max_response_size, size_t* actual_size,
+                       int timeout_ms) {
+  struct libhoth_mux_client* client = dev->user_ctx;
+  int status = mux_check_receive(client);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
+  status = libhoth_receive_response(client->mux->dev, response,
+                                    max_response_size, actual_size, timeout_ms);
+  return mux_finish_receive(client, status, timeout_ms);
+}
+
+static int mux_receivev(struct libhoth_device* dev, const struct iovec* iov,
+                        int iovcnt, size_t* actual_size, int timeout_ms) {
+  struct libhoth_mux_client* client = dev->user_ctx;
+  int status = mux_check_receive(client);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
+  status = libhoth_receive_responsev(client->mux->dev, iov, iovcnt,
+                                     actual_size, timeout_ms);
+  return mux_finish_receive(client, status, timeout_ms);
+}
+
+static int mux_close(struct libhoth_device* dev) {
+  struct libhoth_mux_client* client = dev->user_ctx;
+  struct libhoth_mux* mux = client->mux;
+  if (client->pending) {
+    // Don't let the next client receive this client's response.
+    mux_drain(mux);
+    mux_end_turn(client);
+  }
+
+  pthread_mutex_lock(&mux->lock);
+  mux->num_clients--;
+  pthread_mutex_unlock(&mux->lock);
+  free(client);
+  dev->user_ctx = NULL;
+  return LIBHOTH_OK;
+}
+
+static int mux_claim(struct libhoth_device* dev) {
+  // no-op; turns are handed out by the mux.
+  return LIBHOTH_OK;
+}
+
+static int mux_release(struct libhoth_device* dev) {
+  // no-op
+  return LIBHOTH_OK;
+}
+
+int libhoth_mux_create(const struct libhoth_mux_init_options* options,
+                       struct libhoth_mux** out) {
+  if (options == NULL || options->dev == NULL || out == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  struct libhoth_mux* mux = calloc(1, sizeof(struct libhoth_mux));
+  if (mux == NULL) {
+    return LIBHOTH_ERR_MALLOC_FAILED;
+  }
+  mux->dev = options->dev;
+  mux->drain_timeout_ms = options->drain_timeout_ms > 0
+                              ? options->drain_timeout_ms
+                              : LIBHOTH_MUX_DEFAULT_DRAIN_TIMEOUT_MS;
+  pthread_mutex_init(&mux->lock, NULL);
+  pthread_cond_init(&mux->turn_changed, NULL);
+  *out = mux;
+  return LIBHOTH_OK;
+}
+
+int libhoth_mux_destroy(struct libhoth_mux* mux) {
+  if (mux == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  if (mux->num_clients > 0) {
+    return LIBHOTH_ERR_INTERFACE_BUSY;
+  }
+  pthread_cond_destroy(&mux->turn_changed);
+  pthread_mutex_destroy(&mux->lock);
+  free(mux);
+  return LIBHOTH_OK;
+}
+
+int libhoth_mux_open_client(struct libhoth_mux* mux,
+                            struct libhoth_device** out) {
+  if (mux == NULL || out == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  struct libhoth_device* dev = calloc(1, sizeof(struct libhoth_device));
+  struct libhoth_mux_client* client =
+      calloc(1, sizeof(struct libhoth_mux_client));
+  if (dev == NULL || client == NULL) {
+    free(dev);
+    free(client);
+    return LIBHOTH_ERR_MALLOC_FAILED;
+  }
+  client->mux = mux;
+
+  dev->send = mux_send;
+  dev->receive = mux_receive;
+  dev->sendv = mux_sendv;
+  dev->receivev = mux_receivev;
+  dev->close = mux_close;
+  dev->claim = mux_claim;
+  dev->release = mux_release;
+  dev->user_ctx = client;
+
+  pthread_mutex_lock(&mux->lock);
+  mux->num_clients++;
+  pthread_mutex_unlock(&mux->lock);
+
+  *out = dev;
+  return LIBHOTH_OK;
+}
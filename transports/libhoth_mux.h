@@ -0,0 +1,71 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LIBHOTH_LIBHOTH_MUX_H_
+#define _LIBHOTH_LIBHOTH_MUX_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// How long a client's abandoned response is waited for at a time.
+#define LIBHOTH_MUX_DEFAULT_DRAIN_TIMEOUT_MS 180000
+
+struct libhoth_device;
+struct libhoth_mux;
+
+// A mux shares one device between threads. Each thread opens its own client,
+// which is a `struct libhoth_device` that can be used with any of the usual
+// host command APIs, including the asynchronous ones.
+//
+// A client's send waits for its turn, in the order the sends were made, and
+// the turn lasts until the response to that request has been received. A
+// receive with a zero timeout that finds no response yet keeps the turn so it
+// can be retried. A receive that times out after waiting, or closing a client
+// with a request in flight, abandons the request: the mux drains its response
+// so that it is never delivered to the next client. If the response doesn't
+// arrive within `drain_timeout_ms`, each following send tries again to drain
+// it before sending, and fails with LIBHOTH_ERR_INTERFACE_BUSY if it still
+// hasn't arrived. A thread with a request in flight on one client must not
+// send on another client of the same mux, as that send would wait for a turn
+// that never ends.
+//
+// Client claim and release calls are no-ops, so the device is never given up
+// between commands. To share a device between processes, run a broker (see
+// libhoth_broker.h) instead.
+struct libhoth_mux_init_options {
+  // The device to share. The mux doesn't take ownership of it; it must
+  // outlive the mux.
+  struct libhoth_device* dev;
+  // Defaults to LIBHOTH_MUX_DEFAULT_DRAIN_TIMEOUT_MS.
+  int drain_timeout_ms;
+};
+
+int libhoth_mux_create(const struct libhoth_mux_init_options* options,
+                       struct libhoth_mux** out);
+
+// All clients must be closed (with libhoth_device_close()) first.
+int libhoth_mux_destroy(struct libhoth_mux* mux);
+
+// Opens a new client of `mux`. Close it with libhoth_device_close().
+int libhoth_mux_open_client(struct libhoth_mux* mux,
+                            struct libhoth_device** out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _LIBHOTH_LIBHOTH_MUX_H_
@@ -0,0 +1,277 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "transports/libhoth_mux.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "protocol/host_cmd.h"
+#include "transports/libhoth_device.h"
+
+namespace {
+
+// A device with a single mailbox that answers each request with a copy of
+// it. It fails the test if a request is sent while another is outstanding,
+// or if two threads use it at once.
+class EchoDevice {
+ public:
+  EchoDevice() {
+    dev_.send = Send;
+    dev_.receive = Receive;
+    dev_.user_ctx = this;
+  }
+
+  struct libhoth_device* dev() { return &dev_; }
+
+  // While set, receives time out.
+  void set_holding(bool holding) { holding_ = holding; }
+  int sends() const { return sends_; }
+
+ private:
+  // Checks that nobody else is inside the device.
+  class Guard {
+   public:
+    explicit Guard(EchoDevice* device) : device_(device) {
+      EXPECT_FALSE(device_->busy_.exchange(true));
+    }
+    ~Guard() { device_->busy_ = false; }
+
+   private:
+    EchoDevice* device_;
+  };
+
+  static int Send(struct libhoth_device* dev, const void* request,
+                  size_t request_size) {
+    auto* self = static_cast<EchoDevice*>(dev->user_ctx);
+    Guard guard(self);
+    EXPECT_FALSE(self->outstanding_);
+    self->outstanding_ = true;
+    self->sends_++;
+    const uint8_t* bytes = static_cast<const uint8_t*>(request);
+    self->mailbox_.assign(bytes, bytes + request_size);
+    // Give other threads a chance to barge in.
+    std::this_thread::yield();
+    return LIBHOTH_OK;
+  }
+
+  static int Receive(struct libhoth_device* dev, void* response,
+                     size_t max_response_size, size_t* actual_size,
+                     int timeout_ms) {
+    auto* self = static_cast<EchoDevice*>(dev->user_ctx);
+    Guard guard(self);
+    if (self->holding_) {
+      return LIBHOTH_ERR_TIMEOUT;
+    }
+    if (!self->outstanding_) {
+      return LIBHOTH_ERR_FAIL;
+    }
+    self->outstanding_ = false;
+    if (self->mailbox_.size() > max_response_size) {
+      return LIBHOTH_ERR_RESPONSE_BUFFER_OVERFLOW;
+    }
+    std::memcpy(response, self->mailbox_.data(), self->mailbox_.size());
+    *actual_size = self->mailbox_.size();
+    return LIBHOTH_OK;
+  }
+
+  struct libhoth_device dev_ = {};
+  std::atomic<bool> busy_{false};
+  std::atomic<bool> holding_{false};
+  bool outstanding_ = false;
+  int sends_ = 0;
+  std::vector<uint8_t> mailbox_;
+};
+
+class LibHothMuxTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    const struct libhoth_mux_init_options options = {
+        .dev = device_.dev(),
+        .drain_timeout_ms = 10,
+    };
+    ASSERT_EQ(libhoth_mux_create(&options, &mux_), LIBHOTH_OK);
+  }
+
+  void TearDown() override { EXPECT_EQ(libhoth_mux_destroy(mux_), LIBHOTH_OK); }
+
+  struct libhoth_device* OpenClient() {
+    struct libhoth_device* client = nullptr;
+    EXPECT_EQ(libhoth_mux_open_client(mux_, &client), LIBHOTH_OK);
+    return client;
+  }
+
+  EchoDevice device_;
+  struct libhoth_mux* mux_ = nullptr;
+};
+
+// Sends `request` on `client` and returns the response, or an empty string
+// on error.
+std::string Exchange(struct libhoth_device* client,
+                     const std::string& request) {
+  if (libhoth_send_request(client, request.data(), request.size()) !=
+      LIBHOTH_OK) {
+    return "";
+  }
+  char response[LIBHOTH_MAILBOX_SIZE];
+  size_t response_size = 0;
+  if (libhoth_receive_response(client, response, sizeof(response),
+                               &response_size, 1000) != LIBHOTH_OK) {
+    return "";
+  }
+  return std::string(response, response_size);
+}
+
+TEST_F(LibHothMuxTest, ClientsOnlyGetTheirOwnResponses) {
+  constexpr int kThreads = 8;
+  constexpr int kRequests = 200;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([this, t] {
+      struct libhoth_device* client = OpenClient();
+      for (int i = 0; i < kRequests; ++i) {
+        const std::string request =
+            "client " + std::to_string(t) + " request " + std::to_string(i);
+        EXPECT_EQ(Exchange(client, request), request);
+      }
+      EXPECT_EQ(libhoth_device_close(client), LIBHOTH_OK);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(device_.sends(), kThreads * kRequests);
+}
+
+TEST_F(LibHothMuxTest, SendWhilePendingIsRejected) {
+  struct libhoth_device* client = OpenClient();
+  const std::string request = "first";
+  ASSERT_EQ(libhoth_send_request(client, request.data(), request.size()),
+            LIBHOTH_OK);
+  EXPECT_EQ(libhoth_send_request(client, request.data(), request.size()),
+            LIBHOTH_ERR_INTERFACE_BUSY);
+  char response[LIBHOTH_MAILBOX_SIZE];
+  size_t response_size = 0;
+  EXPECT_EQ(libhoth_receive_response(client, response, sizeof(response),
+                                     &response_size, 1000),
+            LIBHOTH_OK);
+  // Nothing is pending any more.
+  EXPECT_EQ(libhoth_receive_response(client, response, sizeof(response),
+                                     &response_size, 1000),
+            LIBHOTH_ERR_FAIL);
+  EXPECT_EQ(libhoth_device_close(client), LIBHOTH_OK);
+}
+
+TEST_F(LibHothMuxTest, TimedOutReceiveKeepsTheTurn) {
+  struct libhoth_device* first = OpenClient();
+  struct libhoth_device* second = OpenClient();
+  const std::string request = "first";
+  ASSERT_EQ(libhoth_send_request(first, request.data(), request.size()),
+            LIBHOTH_OK);
+  device_.set_holding(true);
+  char response[LIBHOTH_MAILBOX_SIZE];
+  size_t response_size = 0;
+  EXPECT_EQ(libhoth_receive_response(first, response, sizeof(response),
+                                     &response_size, 0),
+            LIBHOTH_ERR_TIMEOUT);
+
+  // The second client waits for its turn until the first is answered.
+  std::string second_response;
+  std::thread thread(
+      [&] { second_response = Exchange(second, "second"); });
+  device_.set_holding(false);
+  ASSERT_EQ(libhoth_receive_response(first, response, sizeof(response),
+                                     &response_size, 1000),
+            LIBHOTH_OK);
+  EXPECT_EQ(std::string(response, response_size), request);
+  thread.join();
+  EXPECT_EQ(second_response, "second");
+
+  EXPECT_EQ(libhoth_device_close(first), LIBHOTH_OK);
+  EXPECT_EQ(libhoth_device_close(second), LIBHOTH_OK);
+}
+
+TEST_F(LibHothMuxTest, AbandonedResponseIsDrained) {
+  struct libhoth_device* first = OpenClient();
+  struct libhoth_device* second = OpenClient();
+  const std::string request = "abandoned";
+  ASSERT_EQ(libhoth_send_request(first, request.data(), request.size()),
+            LIBHOTH_OK);
+  EXPECT_EQ(libhoth_device_close(first), LIBHOTH_OK);
+
+  EXPECT_EQ(Exchange(second, "second"), "second");
+  EXPECT_EQ(libhoth_device_close(second), LIBHOTH_OK);
+}
+
+TEST_F(LibHothMuxTest, LateAbandonedResponseKeepsDeviceOutOfRotation) {
+  struct libhoth_device* first = OpenClient();
+  struct libhoth_device* second = OpenClient();
+  const std::string request = "abandoned";
+  ASSERT_EQ(libhoth_send_request(first, request.data(), request.size()),
+            LIBHOTH_OK);
+  device_.set_holding(true);
+  // The drain times out.
+  EXPECT_EQ(libhoth_device_close(first), LIBHOTH_OK);
+
+  // Sends fail without reaching the device while the response is still due.
+  const std::string second_request = "second";
+  EXPECT_EQ(libhoth_send_request(second, second_request.data(),
+                                 second_request.size()),
+            LIBHOTH_ERR_INTERFACE_BUSY);
+  EXPECT_EQ(device_.sends(), 1);
+
+  // Once it turns up, it is drained rather than handed to the second client.
+  device_.set_holding(false);
+  EXPECT_EQ(Exchange(second, second_request), second_request);
+  EXPECT_EQ(device_.sends(), 2);
+  EXPECT_EQ(libhoth_device_close(second), LIBHOTH_OK);
+}
+
+TEST_F(LibHothMuxTest, BlockingReceiveTimeoutPassesTheTurnOn) {
+  struct libhoth_device* first = OpenClient();
+  struct libhoth_device* second = OpenClient();
+  device_.set_holding(true);
+  // The exec gives up on its response without receiving again.
+  const uint8_t request[4] = {1, 2, 3, 4};
+  EXPECT_EQ(libhoth_hostcmd_exec(first, 0, 0, request, sizeof(request),
+                                 nullptr, 0, nullptr),
+            -1);
+  EXPECT_EQ(device_.sends(), 1);
+
+  // The second client gets its turn, and not the first client's response.
+  device_.set_holding(false);
+  EXPECT_EQ(Exchange(second, "second"), "second");
+  EXPECT_EQ(device_.sends(), 2);
+
+  // The first client can carry on too.
+  EXPECT_EQ(Exchange(first, "first"), "first");
+  EXPECT_EQ(libhoth_device_close(first), LIBHOTH_OK);
+  EXPECT_EQ(libhoth_device_close(second), LIBHOTH_OK);
+}
+
+TEST_F(LibHothMuxTest, DestroyWithOpenClientsFails) {
+  struct libhoth_device* client = OpenClient();
+  EXPECT_EQ(libhoth_mux_destroy(mux_), LIBHOTH_ERR_INTERFACE_BUSY);
+  EXPECT_EQ(libhoth_device_close(client), LIBHOTH_OK);
+}
+
+}  // namespace
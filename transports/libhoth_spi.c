@@ -16,8 +16,10 @@
 
 #include <assert.h>
 #include <fcntl.h>
+#include <linux/gpio.h>
 #include <linux/spi/spidev.h>
 #include <linux/types.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -44,6 +46,19 @@ struct libhoth_spi_device {
   size_t buffered_request_size;
   uint32_t device_busy_wait_timeout;
   uint32_t device_busy_wait_check_interval;
+
+  // Mailbox read command, as chosen by the read mode.
+  uint8_t read_opcode;
+  uint8_t read_dummy_bytes;
+  // Number of lines the read data is clocked in on (1, 2 or 4).
+  uint8_t read_nbits;
+  size_t speculative_read_size;
+
+  // Line fd of the RoT's ready GPIO, or -1 if there isn't one.
+  int ready_gpio_fd;
+  bool adaptive_busy_wait;
+  // Learned page program time, used by adaptive busy-wait.
+  uint32_t busy_estimate_us;
 };
 
 int libhoth_spi_send_request(struct libhoth_device* dev, const void* request,
@@ -61,6 +76,12 @@ int libhoth_spi_send_and_receive_response(struct libhoth_device* dev,
                                           size_t max_response_size,
                                           size_t* actual_size, int timeout_ms);
 
+int libhoth_spi_sendv(struct libhoth_device* dev, const struct iovec* iov,
+                      int iovcnt);
+
+int libhoth_spi_receivev(struct libhoth_device* dev, const struct iovec* iov,
+                         int iovcnt, size_t* actual_size, int timeout_ms);
+
 int libhoth_spi_close(struct libhoth_device* dev);
 
 enum {
@@ -69,6 +90,13 @@ enum {
   SPI_NOR_OPCODE_WRITE_ENABLE = 0x06,
   SPI_NOR_OPCODE_PAGE_PROGRAM = 0x02,
   SPI_NOR_OPCODE_SLOW_READ = 0x03,
+  SPI_NOR_OPCODE_FAST_READ = 0x0B,
+  SPI_NOR_OPCODE_DUAL_OUTPUT_READ = 0x3B,
+  SPI_NOR_OPCODE_QUAD_OUTPUT_READ = 0x6B,
+  // Fast reads need 8 dummy clocks between the address and the data.
+  SPI_NOR_FAST_READ_DUMMY_BYTES = 1,
+  // Opcode, 4 address bytes and dummy bytes.
+  SPI_NOR_READ_COMMAND_MAX_SIZE = 6,
   SPI_NOR_FLASH_PAGE_SIZE = 256,  // in bytes
 };
 
@@ -88,62 +116,154 @@ static int spi_nor_address(uint8_t* buf, uint32_t address,
   }
 }
 
-// Helper function to get current monotonic time in milliseconds
-static int get_monotonic_ms(uint64_t* time_ms) {
+// Writes the mailbox read command for `address` into `buf`, which must hold
+// SPI_NOR_READ_COMMAND_MAX_SIZE bytes. Returns the command length.
+static int spi_nor_read_command(const struct libhoth_spi_device* spi_dev,
+                                uint8_t* buf, uint32_t address) {
+  buf[0] = spi_dev->read_opcode;
+  int len = 1 + spi_nor_address(&buf[1], address, spi_dev->address_mode_4b);
+  memset(&buf[len], 0, spi_dev->read_dummy_bytes);
+  return len + spi_dev->read_dummy_bytes;
+}
+
+// Helper function to get current monotonic time in microseconds
+static int get_monotonic_us(uint64_t* time_us) {
   struct timespec ts;
   if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
     perror("clock_gettime failed");
     return -1;
   }
-  *time_ms = (((uint64_t)ts.tv_sec * 1000) + ((uint64_t)ts.tv_nsec / 1000000));
+  *time_us = (((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000));
   return 0;
 }
 
-static libhoth_status spi_nor_busy_wait(const int fd, uint32_t timeout_us,
-                                        uint32_t check_interval_us) {
+// Requests `line` on `chip_path` as an input reporting ready (active) edges.
+// Returns the line fd, or -1 on failure.
+static int spi_ready_gpio_open(const char* chip_path, uint32_t line,
+                               bool active_low) {
+  int chip_fd = open(chip_path, O_RDONLY | O_CLOEXEC);
+  if (chip_fd < 0) {
+    return -1;
+  }
+  struct gpio_v2_line_request req = {
+      .offsets = {line},
+      .num_lines = 1,
+      .config =
+          {
+              .flags = GPIO_V2_LINE_FLAG_INPUT |
+                       GPIO_V2_LINE_FLAG_EDGE_RISING |
+                       (active_low ? GPIO_V2_LINE_FLAG_ACTIVE_LOW : 0),
+          },
+  };
+  strncpy(req.consumer, "libhoth", sizeof(req.consumer) - 1);
+  int status = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
+  close(chip_fd);
+  if (status < 0) {
+    return -1;
+  }
+  return req.fd;
+}
+
+// Discards ready edges left over from earlier operations, so the next wait
+// only sees the edge for the operation about to be started.
+static void spi_ready_gpio_drain(int gpio_fd) {
+  struct pollfd pfd = {.fd = gpio_fd, .events = POLLIN};
+  struct gpio_v2_line_event event;
+  while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+    if (read(gpio_fd, &event, sizeof(event)) != sizeof(event)) {
+      return;
+    }
+  }
+}
+
+// Blocks until the ready line reports an edge or `timeout_us` passes.
+static void spi_ready_gpio_wait(int gpio_fd, uint32_t timeout_us) {
+  struct pollfd pfd = {.fd = gpio_fd, .events = POLLIN};
+  const int timeout_ms = ((uint64_t)timeout_us + 999) / 1000;
+  if (poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+    // The caller re-reads the status register, so a failed read is harmless.
+    struct gpio_v2_line_event event;
+    if (read(gpio_fd, &event, sizeof(event)) < 0) {
+      perror("Failed to read ready GPIO event");
+    }
+  }
+}
+
+// Folds the time a page program took into the adaptive busy-wait estimate.
+// If the first status read already found the device idle, the estimate may
+// be too long, so it is nudged down; otherwise it moves towards the
+// measured time.
+static void spi_update_busy_estimate(struct libhoth_spi_device* spi_dev,
+                                     uint64_t elapsed_us, int num_polls) {
+  if (num_polls == 1) {
+    spi_dev->busy_estimate_us -= spi_dev->busy_estimate_us / 16;
+  } else {
+    spi_dev->busy_estimate_us =
+        (3 * (uint64_t)spi_dev->busy_estimate_us + elapsed_us) / 4;
+  }
+}
+
+// Waits for the WIP bit to clear. With a ready GPIO, the first busy status
+// read is followed by a poll() on the line instead of fixed sleeps; the edge
+// can't be missed since pending edges are drained before each program. With
+// adaptive busy-wait, the first status read is delayed by the learned page
+// program time. Either way the status register has the final say.
+static libhoth_status spi_nor_busy_wait(struct libhoth_spi_device* spi_dev) {
+  const uint32_t timeout_us = spi_dev->device_busy_wait_timeout;
   uint8_t tx_buf[2];
   uint8_t rx_buf[2];
   static_assert(sizeof(tx_buf) == sizeof(rx_buf),
                 "Tx and Rx buffers must have the same size");
 
-  uint64_t start_time_ms;
-  if (get_monotonic_ms(&start_time_ms) != 0) {
+  uint64_t start_time_us;
+  if (get_monotonic_us(&start_time_us) != 0) {
     return LIBHOTH_ERR_FAIL;
   }
+  if (spi_dev->ready_gpio_fd < 0 && spi_dev->adaptive_busy_wait &&
+      spi_dev->busy_estimate_us > 0) {
+    usleep(spi_dev->busy_estimate_us);
+  }
+
+  bool waited_for_gpio = false;
+  int num_polls = 0;
   while (true) {
     struct spi_ioc_transfer xfer = {0};
     tx_buf[0] = SPI_NOR_OPCODE_READ_STATUS;
     xfer.tx_buf = (uint64_t)tx_buf;
     xfer.rx_buf = (uint64_t)rx_buf;
     xfer.len = sizeof(rx_buf);
-    const int status = ioctl(fd, SPI_IOC_MESSAGE(1), xfer);
+    const int status = ioctl(spi_dev->fd, SPI_IOC_MESSAGE(1), &xfer);
     if (status < 0) {
       return LIBHOTH_ERR_FAIL;
     }
+    num_polls++;
+
+    uint64_t current_time_us;
+    if (get_monotonic_us(&current_time_us) != 0) {
+      return LIBHOTH_ERR_FAIL;
+    }
+    const uint64_t time_elapsed_us = current_time_us - start_time_us;
 
     static_assert(sizeof(rx_buf) >= 2,
                   "Rx buffer must have at least 2 entries");
     const bool is_spi_device_busy = (rx_buf[1] & SPI_NOR_DEVICE_STATUS_WIP_BIT);
     if (!is_spi_device_busy) {
+      if (spi_dev->adaptive_busy_wait) {
+        spi_update_busy_estimate(spi_dev, time_elapsed_us, num_polls);
+      }
       return LIBHOTH_OK;
     }
 
-    uint64_t current_time_ms;
-    if (get_monotonic_ms(&current_time_ms) != 0) {
-      return LIBHOTH_ERR_FAIL;
-    }
-    uint64_t time_elapsed_ms = 0;
-    if (current_time_ms < start_time_ms) {
-      // Wrap around
-      time_elapsed_ms = (UINT64_MAX - start_time_ms) + current_time_ms;
-    } else {
-      time_elapsed_ms = current_time_ms - start_time_ms;
-    }
-
-    if (time_elapsed_ms > (timeout_us / 1000)) {
+    if (time_elapsed_us > timeout_us) {
       return LIBHOTH_ERR_TIMEOUT;
     }
-    usleep(check_interval_us);
+    if (spi_dev->ready_gpio_fd >= 0 && !waited_for_gpio) {
+      waited_for_gpio = true;
+      spi_ready_gpio_wait(spi_dev->ready_gpio_fd,
+                          timeout_us - time_elapsed_us);
+      continue;
+    }
+    usleep(spi_dev->device_busy_wait_check_interval);
   }
 }
 
@@ -165,11 +285,41 @@ static int spi_nor_write_enable(const int fd) {
   return LIBHOTH_OK;
 }
 
-static int spi_nor_write(int fd, bool address_mode_4b, unsigned int address,
-                         const void* data, size_t data_len,
-                         uint32_t device_busy_wait_timeout,
-                         uint32_t device_busy_wait_check_interval) {
-  if (fd < 0 || !data || !data_len) return LIBHOTH_ERR_INVALID_PARAMETER;
+// Fills `xfer` with one transfer per iovec segment covering `len` bytes of the
+// logical buffer described by `iov`, starting `offset` bytes in. Returns the
+// number of transfers used, or -1 if more than `max_xfers` would be required.
+static int spi_iov_xfers(const struct iovec* iov, int iovcnt, size_t offset,
+                         size_t len, bool tx, struct spi_ioc_transfer* xfer,
+                         int max_xfers) {
+  int n = 0;
+  for (int i = 0; i < iovcnt && len > 0; ++i) {
+    if (offset >= iov[i].iov_len) {
+      offset -= iov[i].iov_len;
+      continue;
+    }
+    if (n >= max_xfers) {
+      return -1;
+    }
+    const size_t chunk = MIN(iov[i].iov_len - offset, len);
+    const unsigned long buf = (unsigned long)iov[i].iov_base + offset;
+    xfer[n] = (struct spi_ioc_transfer){
+        .tx_buf = tx ? buf : 0,
+        .rx_buf = tx ? 0 : buf,
+        .len = chunk,
+    };
+    n++;
+    len -= chunk;
+    offset = 0;
+  }
+  return n;
+}
+
+static int spi_nor_writev(struct libhoth_spi_device* spi_dev,
+                          unsigned int address, const struct iovec* iov,
+                          int iovcnt) {
+  const int fd = spi_dev->fd;
+  const size_t data_len = libhoth_iov_length(iov, iovcnt);
+  if (fd < 0 || !iov || !data_len) return LIBHOTH_ERR_INVALID_PARAMETER;
 
   // Page program operations
   size_t bytes_sent = 0;
@@ -180,12 +330,13 @@ static int spi_nor_write(int fd, bool address_mode_4b, unsigned int address,
       return status;
     }
 
-    struct spi_ioc_transfer xfer[2] = {};
+    struct spi_ioc_transfer xfer[1 + LIBHOTH_IOV_MAX] = {};
     uint8_t rq_buf[5] = {};  // 1 for command opcode, 4 (max) for address
 
     // Page Program OPCODE + Address
     rq_buf[0] = SPI_NOR_OPCODE_PAGE_PROGRAM;
-    int address_len = spi_nor_address(&rq_buf[1], address, address_mode_4b);
+    int address_len =
+        spi_nor_address(&rq_buf[1], address, spi_dev->address_mode_4b);
     xfer[0] = (struct spi_ioc_transfer){
         .tx_buf = (unsigned long)rq_buf,
         .len = 1 + address_len,
@@ -194,13 +345,19 @@ static int spi_nor_write(int fd, bool address_mode_4b, unsigned int address,
 
     const size_t chunk_send_size =
         MIN(SPI_NOR_FLASH_PAGE_SIZE, (data_len - bytes_sent));
-    // Write Data at mailbox address
-    xfer[1] = (struct spi_ioc_transfer){
-        .tx_buf = ((unsigned long)(data) + bytes_sent),
-        .len = chunk_send_size,
-    };
+    // Write Data at mailbox address, one transfer per source segment so the
+    // data never needs to be gathered into a staging buffer.
+    int num_data_xfers =
+        spi_iov_xfers(iov, iovcnt, bytes_sent, chunk_send_size, /*tx=*/true,
+                      &xfer[1], LIBHOTH_IOV_MAX);
+    if (num_data_xfers < 0) {
+      return LIBHOTH_ERR_INVALID_PARAMETER;
+    }
 
-    status = ioctl(fd, SPI_IOC_MESSAGE(2), xfer);
+    if (spi_dev->ready_gpio_fd >= 0) {
+      spi_ready_gpio_drain(spi_dev->ready_gpio_fd);
+    }
+    status = ioctl(fd, SPI_IOC_MESSAGE(1 + num_data_xfers), xfer);
     if (status < 0) {
       return LIBHOTH_ERR_FAIL;
     }
@@ -208,8 +365,7 @@ static int spi_nor_write(int fd, bool address_mode_4b, unsigned int address,
     address += chunk_send_size;
 
     // Wait for each page program operation to be handled
-    libhoth_status busy_wait_status = spi_nor_busy_wait(
-        fd, device_busy_wait_timeout, device_busy_wait_check_interval);
+    libhoth_status busy_wait_status = spi_nor_busy_wait(spi_dev);
     if (busy_wait_status != LIBHOTH_OK) {
       return busy_wait_status;
     }
@@ -217,28 +373,43 @@ static int spi_nor_write(int fd, bool address_mode_4b, unsigned int address,
   return LIBHOTH_OK;
 }
 
-static int spi_nor_read(int fd, bool address_mode_4b, unsigned int address,
-                        void* data, size_t data_len) {
-  if (fd < 0 || !data || !data_len) return LIBHOTH_ERR_INVALID_PARAMETER;
+static int spi_nor_write(struct libhoth_spi_device* spi_dev,
+                         unsigned int address, const void* data,
+                         size_t data_len) {
+  if (!data) return LIBHOTH_ERR_INVALID_PARAMETER;
+  const struct iovec iov = {.iov_base = (void*)data, .iov_len = data_len};
+  return spi_nor_writev(spi_dev, address, &iov, 1);
+}
+
+// Reads `data_len` bytes from `address` into the logical buffer described by
+// `iov`, starting `offset` bytes in.
+static int spi_nor_readv(const struct libhoth_spi_device* spi_dev,
+                         unsigned int address, const struct iovec* iov,
+                         int iovcnt, size_t offset, size_t data_len) {
+  if (spi_dev->fd < 0 || !iov || !data_len) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
 
-  uint8_t rd_request[5];
-  struct spi_ioc_transfer xfer[2] = {};
+  uint8_t rd_request[SPI_NOR_READ_COMMAND_MAX_SIZE];
+  struct spi_ioc_transfer xfer[1 + LIBHOTH_IOV_MAX] = {};
 
   // Read OPCODE and mailbox address
-  rd_request[0] = SPI_NOR_OPCODE_SLOW_READ;
-  int address_len = spi_nor_address(&rd_request[1], address, address_mode_4b);
   xfer[0] = (struct spi_ioc_transfer){
       .tx_buf = (unsigned long)rd_request,
-      .len = 1 + address_len,
+      .len = spi_nor_read_command(spi_dev, rd_request, address),
   };
 
   // Read in data
-  xfer[1] = (struct spi_ioc_transfer){
-      .rx_buf = (unsigned long)data,
-      .len = data_len,
-  };
+  int num_data_xfers = spi_iov_xfers(iov, iovcnt, offset, data_len,
+                                     /*tx=*/false, &xfer[1], LIBHOTH_IOV_MAX);
+  if (num_data_xfers < 0) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  for (int i = 1; i <= num_data_xfers; i++) {
+    xfer[i].rx_nbits = spi_dev->read_nbits;
+  }
 
-  int status = ioctl(fd, SPI_IOC_MESSAGE(2), xfer);
+  int status = ioctl(spi_dev->fd, SPI_IOC_MESSAGE(1 + num_data_xfers), xfer);
   if (status < 0) {
     return LIBHOTH_ERR_FAIL;
   }
@@ -246,6 +417,68 @@ static int spi_nor_read(int fd, bool address_mode_4b, unsigned int address,
   return LIBHOTH_OK;
 }
 
+static int spi_nor_read(const struct libhoth_spi_device* spi_dev,
+                        unsigned int address, void* data, size_t data_len) {
+  const struct iovec iov = {.iov_base = data, .iov_len = data_len};
+  if (!data) return LIBHOTH_ERR_INVALID_PARAMETER;
+  return spi_nor_readv(spi_dev, address, &iov, 1, 0, data_len);
+}
+
+// Picks the mailbox read command for `read_mode`. Dual and quad reads are
+// only used if the controller keeps the matching SPI_RX_* mode bit set;
+// spi_setup() quietly drops the bits the controller doesn't support.
+static int spi_configure_read_mode(int fd, int read_mode,
+                                   struct libhoth_spi_device* spi_dev) {
+  spi_dev->read_opcode = SPI_NOR_OPCODE_SLOW_READ;
+  spi_dev->read_dummy_bytes = 0;
+  spi_dev->read_nbits = 1;
+
+  uint32_t rx_mode_bit = 0;
+  switch (read_mode) {
+    case LIBHOTH_SPI_READ_MODE_SLOW:
+      return LIBHOTH_OK;
+    case LIBHOTH_SPI_READ_MODE_FAST:
+      break;
+    case LIBHOTH_SPI_READ_MODE_DUAL:
+      rx_mode_bit = SPI_RX_DUAL;
+      break;
+    case LIBHOTH_SPI_READ_MODE_QUAD:
+      rx_mode_bit = SPI_RX_QUAD;
+      break;
+    default:
+      return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+  spi_dev->read_opcode = SPI_NOR_OPCODE_FAST_READ;
+  spi_dev->read_dummy_bytes = SPI_NOR_FAST_READ_DUMMY_BYTES;
+  if (rx_mode_bit == 0) {
+    return LIBHOTH_OK;
+  }
+
+  uint32_t mode;
+  if (ioctl(fd, SPI_IOC_RD_MODE32, &mode) < 0) {
+    return LIBHOTH_ERR_FAIL;
+  }
+  mode |= rx_mode_bit;
+  if (ioctl(fd, SPI_IOC_WR_MODE32, &mode) < 0 ||
+      ioctl(fd, SPI_IOC_RD_MODE32, &mode) < 0) {
+    return LIBHOTH_ERR_FAIL;
+  }
+  if ((mode & rx_mode_bit) == 0) {
+    fprintf(stderr,
+            "SPI controller does not support %s reads; using fast read\n",
+            rx_mode_bit == SPI_RX_DUAL ? "dual" : "quad");
+    return LIBHOTH_OK;
+  }
+  if (rx_mode_bit == SPI_RX_DUAL) {
+    spi_dev->read_opcode = SPI_NOR_OPCODE_DUAL_OUTPUT_READ;
+    spi_dev->read_nbits = 2;
+  } else {
+    spi_dev->read_opcode = SPI_NOR_OPCODE_QUAD_OUTPUT_READ;
+    spi_dev->read_nbits = 4;
+  }
+  return LIBHOTH_OK;
+}
+
 static int libhoth_spi_claim(struct libhoth_device* dev) {
   // no-op
   return LIBHOTH_OK;
@@ -303,6 +536,7 @@ int libhoth_spi_open(const struct libhoth_spi_device_init_options* options,
     status = LIBHOTH_ERR_MALLOC_FAILED;
     goto err_out;
   }
+  spi_dev->ready_gpio_fd = -1;
 
   if (options->bits) {
     const uint8_t bits = (uint8_t)options->bits;
@@ -328,12 +562,31 @@ int libhoth_spi_open(const struct libhoth_spi_device_init_options* options,
     }
   }
 
+  status = spi_configure_read_mode(fd, options->read_mode, spi_dev);
+  if (status != LIBHOTH_OK) {
+    goto err_out;
+  }
+
   spi_dev->fd = fd;
   spi_dev->mailbox_address = options->mailbox;
   spi_dev->address_mode_4b = true;
   spi_dev->device_busy_wait_timeout = options->device_busy_wait_timeout;
   spi_dev->device_busy_wait_check_interval =
       options->device_busy_wait_check_interval;
+  spi_dev->speculative_read_size = options->speculative_read_size;
+  spi_dev->adaptive_busy_wait = options->adaptive_busy_wait;
+
+  if (options->ready_gpio_chip != NULL && options->ready_gpio_chip[0]) {
+    spi_dev->ready_gpio_fd =
+        spi_ready_gpio_open(options->ready_gpio_chip, options->ready_gpio_line,
+                            options->ready_gpio_active_low);
+    if (spi_dev->ready_gpio_fd < 0) {
+      fprintf(stderr, "Failed to request ready GPIO %s:%u\n",
+              options->ready_gpio_chip, options->ready_gpio_line);
+      status = LIBHOTH_ERR_INTERFACE_NOT_FOUND;
+      goto err_out;
+    }
+  }
 
   if (options->atomic) {
     dev->send = libhoth_spi_buffer_request;
@@ -341,6 +594,8 @@ int libhoth_spi_open(const struct libhoth_spi_device_init_options* options,
   } else {
     dev->send = libhoth_spi_send_request;
     dev->receive = libhoth_spi_receive_response;
+    dev->sendv = libhoth_spi_sendv;
+    dev->receivev = libhoth_spi_receivev;
   }
   dev->close = libhoth_spi_close;
   dev->claim = libhoth_spi_claim;
@@ -358,6 +613,9 @@ err_out:
     free(dev);
   }
   if (spi_dev != NULL) {
+    if (spi_dev->ready_gpio_fd >= 0) {
+      close(spi_dev->ready_gpio_fd);
+    }
     free(spi_dev);
   }
 
@@ -373,10 +631,8 @@ int libhoth_spi_send_request(struct libhoth_device* dev, const void* request,
   struct libhoth_spi_device* spi_dev =
       (struct libhoth_spi_device*)dev->user_ctx;
 
-  return spi_nor_write(spi_dev->fd, spi_dev->address_mode_4b,
-                       spi_dev->mailbox_address, request, request_size,
-                       spi_dev->device_busy_wait_timeout,
-                       spi_dev->device_busy_wait_check_interval);
+  return spi_nor_write(spi_dev, spi_dev->mailbox_address, request,
+                       request_size);
 }
 
 int libhoth_spi_receive_response(struct libhoth_device* dev, void* response,
@@ -390,43 +646,109 @@ int libhoth_spi_receive_response(struct libhoth_device* dev, void* response,
     return LIBHOTH_ERR_INVALID_PARAMETER;
   }
 
-  size_t total_bytes;
   int status;
   struct hoth_host_response host_response;
   struct libhoth_spi_device* spi_dev =
       (struct libhoth_spi_device*)dev->user_ctx;
 
-  // Read Header From Mailbox
-  status = spi_nor_read(spi_dev->fd, spi_dev->address_mode_4b,
-                        spi_dev->mailbox_address, response,
-                        sizeof(struct hoth_host_response));
+  // Read the header, and speculatively the start of the payload, from the
+  // mailbox.
+  const size_t first_read_size =
+      MIN(max_response_size,
+          sizeof(struct hoth_host_response) + spi_dev->speculative_read_size);
+  status = spi_nor_read(spi_dev, spi_dev->mailbox_address, response,
+                        first_read_size);
   if (status != LIBHOTH_OK) {
     return status;
   }
 
-  total_bytes = sizeof(struct hoth_host_response);
   memcpy(&host_response, response, sizeof(host_response));
+  if (actual_size) {
+    *actual_size = sizeof(host_response);
+  }
+
+  const size_t total_bytes = sizeof(host_response) + host_response.data_len;
+  if (max_response_size < total_bytes) {
+    return LIBHOTH_ERR_RESPONSE_BUFFER_OVERFLOW;
+  }
+
+  if (total_bytes > first_read_size) {
+    // Read remainder of data based on header length
+    uint8_t* const data_start = (uint8_t*)response + first_read_size;
+    status = spi_nor_read(spi_dev, spi_dev->mailbox_address + first_read_size,
+                          data_start, total_bytes - first_read_size);
+    if (status != LIBHOTH_OK) {
+      return status;
+    }
+  }
+
   if (actual_size) {
     *actual_size = total_bytes;
   }
 
-  if (max_response_size < (total_bytes + host_response.data_len)) {
+  return LIBHOTH_OK;
+}
+
+int libhoth_spi_sendv(struct libhoth_device* dev, const struct iovec* iov,
+                      int iovcnt) {
+  if (dev == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+
+  struct libhoth_spi_device* spi_dev =
+      (struct libhoth_spi_device*)dev->user_ctx;
+
+  return spi_nor_writev(spi_dev, spi_dev->mailbox_address, iov, iovcnt);
+}
+
+int libhoth_spi_receivev(struct libhoth_device* dev, const struct iovec* iov,
+                         int iovcnt, size_t* actual_size, int timeout_ms) {
+  if (dev == NULL) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+
+  const size_t max_response_size = libhoth_iov_length(iov, iovcnt);
+  if (max_response_size < sizeof(struct hoth_host_response)) {
+    return LIBHOTH_ERR_INVALID_PARAMETER;
+  }
+
+  int status;
+  struct hoth_host_response host_response;
+  struct libhoth_spi_device* spi_dev =
+      (struct libhoth_spi_device*)dev->user_ctx;
+
+  // Read the header, and speculatively the start of the payload, from the
+  // mailbox directly into the caller's segments.
+  const size_t first_read_size =
+      MIN(max_response_size,
+          sizeof(host_response) + spi_dev->speculative_read_size);
+  status = spi_nor_readv(spi_dev, spi_dev->mailbox_address, iov, iovcnt, 0,
+                         first_read_size);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
+  libhoth_iov_gather(&host_response, sizeof(host_response), iov, iovcnt);
+  if (actual_size) {
+    *actual_size = sizeof(host_response);
+  }
+
+  const size_t total_bytes = sizeof(host_response) + host_response.data_len;
+  if (max_response_size < total_bytes) {
     return LIBHOTH_ERR_RESPONSE_BUFFER_OVERFLOW;
   }
 
-  if (host_response.data_len > 0) {
+  if (total_bytes > first_read_size) {
     // Read remainder of data based on header length
-    uint8_t* const data_start = (uint8_t*)response + total_bytes;
-    status = spi_nor_read(spi_dev->fd, spi_dev->address_mode_4b,
-                          spi_dev->mailbox_address + total_bytes, data_start,
-                          host_response.data_len);
+    status = spi_nor_readv(spi_dev, spi_dev->mailbox_address + first_read_size,
+                           iov, iovcnt, first_read_size,
+                           total_bytes - first_read_size);
     if (status != LIBHOTH_OK) {
       return status;
     }
   }
 
   if (actual_size) {
-    *actual_size += host_response.data_len;
+    *actual_size = total_bytes;
   }
 
   return LIBHOTH_OK;
@@ -504,18 +826,17 @@ int libhoth_spi_send_and_receive_response(struct libhoth_device* dev,
   // Wait for status register is handled by the spidev driver.
 
   // Read opcode + Mailbox Address
-  uint8_t rd_buf[5];
-  rd_buf[0] = SPI_NOR_OPCODE_SLOW_READ;
-  address_len = spi_nor_address(&rd_buf[1], address, address_mode_4b);
+  uint8_t rd_buf[SPI_NOR_READ_COMMAND_MAX_SIZE];
   xfer[3] = (struct spi_ioc_transfer){
       .tx_buf = (unsigned long)rd_buf,
-      .len = 1 + address_len,
+      .len = spi_nor_read_command(spi_dev, rd_buf, address),
   };
 
   // Read entire expected response buffer
   xfer[4] = (struct spi_ioc_transfer){
       .rx_buf = (unsigned long)response,
       .len = max_response_size,
+      .rx_nbits = spi_dev->read_nbits,
   };
 
   int rc = LIBHOTH_OK;
@@ -582,6 +903,9 @@ int libhoth_spi_close(struct libhoth_device* dev) {
   struct libhoth_spi_device* spi_dev =
       (struct libhoth_spi_device*)dev->user_ctx;
   close(spi_dev->fd);
+  if (spi_dev->ready_gpio_fd >= 0) {
+    close(spi_dev->ready_gpio_fd);
+  }
   free(dev->user_ctx);
   return LIBHOTH_OK;
 }
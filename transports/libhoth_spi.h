@@ -24,6 +24,20 @@ extern "C" {
 
 struct libhoth_device;
 
+// Opcode used to read responses out of the mailbox.
+enum libhoth_spi_read_mode {
+  // 0x03 READ. Limited to lower clock rates on most parts.
+  LIBHOTH_SPI_READ_MODE_SLOW = 0,
+  // 0x0B FAST_READ, with 8 dummy clocks.
+  LIBHOTH_SPI_READ_MODE_FAST,
+  // 0x3B DUAL OUTPUT FAST READ. Falls back to FAST if the controller can't
+  // receive on two lines.
+  LIBHOTH_SPI_READ_MODE_DUAL,
+  // 0x6B QUAD OUTPUT FAST READ. Falls back to FAST if the controller can't
+  // receive on four lines.
+  LIBHOTH_SPI_READ_MODE_QUAD,
+};
+
 struct libhoth_spi_device_init_options {
   // The device filepath to open
   const char* path;
@@ -35,6 +49,21 @@ struct libhoth_spi_device_init_options {
   int atomic;
   uint32_t device_busy_wait_timeout;
   uint32_t device_busy_wait_check_interval;
+  // One of enum libhoth_spi_read_mode.
+  int read_mode;
+  // If non-zero, responses are read with a single transaction covering the
+  // header and up to this many bytes of payload. Only responses with longer
+  // payloads need a second read.
+  size_t speculative_read_size;
+  // If set, the GPIO chip (e.g. "/dev/gpiochip0") and line the RoT asserts
+  // when it's ready for the next SPI operation. Writes sleep until the line
+  // asserts instead of polling the status register.
+  const char* ready_gpio_chip;
+  uint32_t ready_gpio_line;
+  int ready_gpio_active_low;
+  // If set (and there is no ready GPIO), learn how long page programs take
+  // and sleep for about that long before the first status read.
+  int adaptive_busy_wait;
 };
 
 // Note that the options struct only needs to to live for the duration of
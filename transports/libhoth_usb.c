@@ -32,6 +32,13 @@ int libhoth_usb_receive_response(struct libhoth_device* dev, void* response,
                                  size_t max_response_size, size_t* actual_size,
                                  int timeout_ms);
 
+static int libhoth_usb_sendv(struct libhoth_device* dev,
+                             const struct iovec* iov, int iovcnt);
+
+static int libhoth_usb_receivev(struct libhoth_device* dev,
+                                const struct iovec* iov, int iovcnt,
+                                size_t* actual_size, int timeout_ms);
+
 static struct libhoth_usb_interface_info libhoth_usb_find_interface(
     const struct libusb_config_descriptor* configuration) {
   struct libhoth_usb_interface_info info = {
@@ -147,8 +154,9 @@ int libhoth_usb_open(const struct libhoth_usb_device_init_options* options,
       status = libhoth_usb_mailbox_open(usb_dev, config_descriptor);
       break;
     case LIBHOTH_USB_INTERFACE_TYPE_FIFO:
-      status =
-          libhoth_usb_fifo_open(usb_dev, config_descriptor, options->prng_seed);
+      status = libhoth_usb_fifo_open(usb_dev, config_descriptor,
+                                     options->prng_seed,
+                                     options->fifo_pipeline_depth);
       break;
     default:
       status = LIBHOTH_ERR_INTERFACE_NOT_FOUND;
@@ -162,6 +170,13 @@ int libhoth_usb_open(const struct libhoth_usb_device_init_options* options,
   dev->close = libhoth_usb_close;
   dev->claim = libhoth_usb_claim;
   dev->release = libhoth_usb_release;
+  if (usb_dev->info.type == LIBHOTH_USB_INTERFACE_TYPE_FIFO) {
+    // The FIFO interface stages every transfer through its own buffers, so it
+    // can gather/scatter directly into them.
+    dev->sendv = libhoth_usb_sendv;
+    dev->receivev = libhoth_usb_receivev;
+    dev->queue_depth = options->fifo_pipeline_depth;
+  }
   dev->user_ctx = usb_dev;
 
   *out = dev;
@@ -224,6 +239,40 @@ int libhoth_usb_receive_response(struct libhoth_device* dev, void* response,
   return LIBUSB_ERROR_NOT_SUPPORTED;
 }
 
+static int libhoth_usb_sendv(struct libhoth_device* dev,
+                             const struct iovec* iov, int iovcnt) {
+  if (dev->user_ctx == NULL) {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+
+  struct libhoth_usb_device* usb_dev =
+      (struct libhoth_usb_device*)dev->user_ctx;
+  switch (usb_dev->info.type) {
+    case LIBHOTH_USB_INTERFACE_TYPE_FIFO:
+      return libhoth_usb_fifo_send_requestv(usb_dev, iov, iovcnt);
+    default:
+      return LIBHOTH_ERR_INTERFACE_NOT_FOUND;
+  }
+}
+
+static int libhoth_usb_receivev(struct libhoth_device* dev,
+                                const struct iovec* iov, int iovcnt,
+                                size_t* actual_size, int timeout_ms) {
+  if (dev->user_ctx == NULL) {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+
+  struct libhoth_usb_device* usb_dev =
+      (struct libhoth_usb_device*)dev->user_ctx;
+  switch (usb_dev->info.type) {
+    case LIBHOTH_USB_INTERFACE_TYPE_FIFO:
+      return libhoth_usb_fifo_receive_responsev(usb_dev, iov, iovcnt,
+                                                actual_size, timeout_ms);
+    default:
+      return LIBHOTH_ERR_INTERFACE_NOT_FOUND;
+  }
+}
+
 int libhoth_usb_close(struct libhoth_device* dev) {
   int status;
   if (dev->user_ctx == NULL) {
@@ -348,3 +397,66 @@ int libhoth_usb_get_device(libusb_context* ctx,
   libusb_free_device_list(device, /*unref_devices=*/1);
   return found_device ? LIBHOTH_OK : LIBHOTH_ERR_INTERFACE_NOT_FOUND;
 }
+
+int libhoth_usb_open_all(libusb_context* ctx, uint32_t prng_seed,
+                         struct libhoth_device*** out, size_t* num_opened,
+                         struct libhoth_usb_open_failure** failures,
+                         size_t* num_failed) {
+  if (out == NULL || num_opened == NULL || failures == NULL ||
+      num_failed == NULL || prng_seed == 0) {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+
+  libusb_device** device;
+  ssize_t num_devices = libusb_get_device_list(ctx, &device);
+  if (num_devices < 0) {
+    return num_devices;
+  }
+
+  const size_t max_devices = num_devices > 0 ? num_devices : 1;
+  struct libhoth_device** devs = calloc(max_devices, sizeof(*devs));
+  struct libhoth_usb_open_failure* failed =
+      calloc(max_devices, sizeof(*failed));
+  if (devs == NULL || failed == NULL) {
+    free(devs);
+    free(failed);
+    libusb_free_device_list(device, /*unref_devices=*/1);
+    return LIBHOTH_ERR_MALLOC_FAILED;
+  }
+
+  size_t count = 0;
+  size_t failed_count = 0;
+  for (ssize_t i = 0; i < num_devices; i++) {
+    struct libusb_device_descriptor device_descriptor;
+    int rv = libusb_get_device_descriptor(device[i], &device_descriptor);
+    if (rv != LIBUSB_SUCCESS || !libhoth_device_is_hoth(&device_descriptor)) {
+      continue;
+    }
+
+    // Each device gets its own request-ID stream.
+    struct libhoth_usb_device_init_options opts = {
+        .usb_device = device[i],
+        .usb_ctx = ctx,
+        .prng_seed = prng_seed + (uint32_t)count,
+    };
+    if (opts.prng_seed == 0) {
+      opts.prng_seed = 1;
+    }
+    rv = libhoth_usb_open(&opts, &devs[count]);
+    if (rv != LIBHOTH_OK) {
+      // Most likely claimed by another process; report it to the caller.
+      struct libhoth_usb_open_failure* failure = &failed[failed_count++];
+      libhoth_get_usb_loc(device[i], &failure->loc);
+      failure->status = rv;
+      continue;
+    }
+    count++;
+  }
+
+  libusb_free_device_list(device, /*unref_devices=*/1);
+  *out = devs;
+  *num_opened = count;
+  *failures = failed;
+  *num_failed = failed_count;
+  return LIBHOTH_OK;
+}
@@ -36,6 +36,13 @@ struct libhoth_usb_device_init_options {
   // Seed value to use for Pseudo-random number generator for communicating with
   // RoT over USB FIFO interface. Must be non-zero
   uint32_t prng_seed;
+  // Number of requests that may be queued to the RoT before the first
+  // response is read (USB FIFO interface only, at most
+  // LIBHOTH_USB_FIFO_MAX_PIPELINE_DEPTH). With a depth greater than 1,
+  // libhoth_send_request() may be called that many times in a row, and
+  // libhoth_receive_response() returns the responses in request order. 0 and
+  // 1 keep the default one-request-at-a-time behavior.
+  uint8_t fifo_pipeline_depth;
 };
 
 #define LIBHOTH_NUM_PORTS 16
@@ -63,6 +70,25 @@ int libhoth_usb_get_device(libusb_context* ctx,
                            libusb_device** out);
 int libhoth_get_usb_loc(libusb_device* dev, struct libhoth_usb_loc* result);
 
+// A Hoth device that libhoth_usb_open_all() found but couldn't open.
+struct libhoth_usb_open_failure {
+  struct libhoth_usb_loc loc;
+  // The error from libhoth_usb_open().
+  int status;
+};
+
+// Opens every Hoth device on the bus, e.g. to build a fleet (see
+// protocol/fleet.h). On success `*out` is a malloc()ed array of `*num_opened`
+// devices; the caller closes each with libhoth_device_close() and then frees
+// the array. Devices that can't be opened (usually because another process
+// has claimed them) are listed in `*failures`, a malloc()ed array of
+// `*num_failed` entries that the caller frees, so that they aren't silently
+// left out of a fleet operation.
+int libhoth_usb_open_all(libusb_context* ctx, uint32_t prng_seed,
+                         struct libhoth_device*** out, size_t* num_opened,
+                         struct libhoth_usb_open_failure** failures,
+                         size_t* num_failed);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,6 +18,7 @@
 #include <libusb.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,40 @@ struct libhoth_usb_mailbox {
   uint16_t max_packet_size_out;
   uint8_t ep_in;
   uint8_t ep_out;
+  // One OUT/IN transfer pair (at transfers[2 * i] and transfers[2 * i + 1])
+  // and packet buffer per slice of a maximum-size message, so a whole
+  // request or response can be queued at once.
+  int num_slots;
+  struct libusb_transfer **transfers;
+  uint8_t *out_packets;
+  uint8_t *in_packets;
+};
+
+// Maximum number of requests that can be queued to the RoT at once in
+// pipelined FIFO mode.
+#define LIBHOTH_USB_FIFO_MAX_PIPELINE_DEPTH 8
+
+// One request queued in pipelined FIFO mode, together with one IN transfer
+// from the pool used to collect responses. IN transfers complete in the order
+// they were submitted, which isn't necessarily the order of the slots they
+// belong to (a stale response consumes one), so responses are matched to
+// slots by request ID and copied into `resp_buffer`.
+struct libhoth_usb_fifo_slot {
+  struct libhoth_usb_device *dev;
+  struct libusb_transfer *out_transfer;
+  struct libusb_transfer *in_transfer;
+  uint8_t *out_buffer;
+  uint8_t *in_buffer;
+  uint8_t *resp_buffer;
+  size_t resp_size;
+  int status;
+  bool busy;
+  bool out_done;
+  bool responded;
+  bool in_pending;
+  // Set once both `out_done` and `responded` are; passed to
+  // libusb_handle_events_timeout_completed().
+  int ready;
 };
 
 struct libhoth_usb_fifo {
@@ -60,6 +95,19 @@ struct libhoth_usb_fifo {
   bool in_transfer_completed;
   bool out_transfer_completed;
   uint32_t prng_state;
+  // Non-pipelined mode: set while the transfers of a request are running
+  // across receives that polled (zero timeout) before the response arrived.
+  bool exchange_pending;
+  int stale_reads;
+  bool halt_cleared;
+
+  // Pipelined mode, used when pipeline_depth > 1. `slots` is a ring of
+  // pipeline_depth entries; `head` is the oldest outstanding request.
+  uint8_t pipeline_depth;
+  struct libhoth_usb_fifo_slot *slots;
+  uint8_t head;
+  uint8_t num_outstanding;
+  int stale_responses;
 };
 
 struct libhoth_usb_interface_info {
@@ -80,12 +128,17 @@ struct libhoth_usb_device {
 
 int libhoth_usb_fifo_open(struct libhoth_usb_device *dev,
                           const struct libusb_config_descriptor *descriptor,
-                          uint32_t prng_seed);
+                          uint32_t prng_seed, uint8_t pipeline_depth);
 int libhoth_usb_fifo_send_request(struct libhoth_usb_device *dev,
                                   const void *request, size_t request_size);
 int libhoth_usb_fifo_receive_response(struct libhoth_usb_device *dev,
                                       void *response, size_t response_size,
                                       size_t *actual_size, int timeout_ms);
+int libhoth_usb_fifo_send_requestv(struct libhoth_usb_device *dev,
+                                   const struct iovec *iov, int iovcnt);
+int libhoth_usb_fifo_receive_responsev(struct libhoth_usb_device *dev,
+                                       const struct iovec *iov, int iovcnt,
+                                       size_t *actual_size, int timeout_ms);
 int libhoth_usb_fifo_close(struct libhoth_usb_device *dev);
 
 int libhoth_usb_mailbox_open(struct libhoth_usb_device *dev,
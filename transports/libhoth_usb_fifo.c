@@ -18,6 +18,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include "transports/libhoth_device.h"
 #include "transports/libhoth_usb_device.h"
@@ -27,8 +29,20 @@
 #define LIBHOTH_USB_FIFO_MTU \
   (LIBHOTH_USB_FIFO_REQUEST_ID_SIZE + LIBHOTH_USB_FIFO_MAX_REQUEST_SIZE)
 
-static int libhoth_usb_fifo_run_transfers(struct libhoth_usb_device *dev,
-                                          bool out, bool in) {
+static int libhoth_usb_fifo_wait_transfers(struct libhoth_usb_device *dev) {
+  struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
+  while (drvdata->all_transfers_completed == 0) {
+    int status = libusb_handle_events_completed(
+        dev->ctx, &drvdata->all_transfers_completed);
+    if (status == LIBUSB_ERROR_INTERRUPTED) {
+      return status;
+    }
+  }
+  return LIBHOTH_OK;
+}
+
+static int libhoth_usb_fifo_submit_transfers(struct libhoth_usb_device *dev,
+                                             bool out, bool in) {
   struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
   drvdata->all_transfers_completed = 0;
   drvdata->out_transfer_completed = !out;
@@ -43,13 +57,12 @@ static int libhoth_usb_fifo_run_transfers(struct libhoth_usb_device *dev,
   if (out) {
     int status = libusb_submit_transfer(drvdata->out_transfer);
     if (status != LIBUSB_SUCCESS) {
-      return status;
-    }
-  }
-  while (drvdata->all_transfers_completed == 0) {
-    int status = libusb_handle_events_completed(
-        dev->ctx, &drvdata->all_transfers_completed);
-    if (status == LIBUSB_ERROR_INTERRUPTED) {
+      if (in) {
+        // Don't leave the IN transfer running on its own.
+        drvdata->out_transfer_completed = true;
+        libusb_cancel_transfer(drvdata->in_transfer);
+        libhoth_usb_fifo_wait_transfers(dev);
+      }
       return status;
     }
   }
@@ -94,15 +107,57 @@ static uint32_t libhoth_generate_pseudorandom_u32(uint32_t *seed) {
   return *seed;
 }
 
+static void fifo_free_slots(struct libhoth_usb_fifo *drvdata) {
+  if (drvdata->slots == NULL) {
+    return;
+  }
+  for (int i = 0; i < drvdata->pipeline_depth; i++) {
+    struct libhoth_usb_fifo_slot *slot = &drvdata->slots[i];
+    libusb_free_transfer(slot->out_transfer);
+    libusb_free_transfer(slot->in_transfer);
+    free(slot->out_buffer);
+    free(slot->in_buffer);
+    free(slot->resp_buffer);
+  }
+  free(drvdata->slots);
+  drvdata->slots = NULL;
+}
+
+static int fifo_alloc_slots(struct libhoth_usb_device *dev) {
+  struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
+  drvdata->slots = (struct libhoth_usb_fifo_slot *)calloc(
+      drvdata->pipeline_depth, sizeof(struct libhoth_usb_fifo_slot));
+  if (drvdata->slots == NULL) {
+    return LIBHOTH_ERR_MALLOC_FAILED;
+  }
+  for (int i = 0; i < drvdata->pipeline_depth; i++) {
+    struct libhoth_usb_fifo_slot *slot = &drvdata->slots[i];
+    slot->dev = dev;
+    slot->out_transfer = libusb_alloc_transfer(0);
+    slot->in_transfer = libusb_alloc_transfer(0);
+    slot->out_buffer = (uint8_t *)malloc(LIBHOTH_USB_FIFO_MTU);
+    slot->in_buffer = (uint8_t *)malloc(LIBHOTH_USB_FIFO_MTU);
+    slot->resp_buffer = (uint8_t *)malloc(LIBHOTH_USB_FIFO_MAX_REQUEST_SIZE);
+    if (slot->out_transfer == NULL || slot->in_transfer == NULL ||
+        slot->out_buffer == NULL || slot->in_buffer == NULL ||
+        slot->resp_buffer == NULL) {
+      fifo_free_slots(drvdata);
+      return LIBHOTH_ERR_MALLOC_FAILED;
+    }
+  }
+  return LIBHOTH_OK;
+}
+
 int libhoth_usb_fifo_open(struct libhoth_usb_device *dev,
                           const struct libusb_config_descriptor *descriptor,
-                          uint32_t prng_seed) {
+                          uint32_t prng_seed, uint8_t pipeline_depth) {
   int status = LIBHOTH_OK;
   if (dev == NULL || descriptor == NULL ||
       dev->info.type != LIBHOTH_USB_INTERFACE_TYPE_FIFO ||
       // XORShift PRNG must be seeded with non-zero value, otherwise it will
       // produce a stream of only zeroes
-      (prng_seed == 0)) {
+      (prng_seed == 0) ||
+      pipeline_depth > LIBHOTH_USB_FIFO_MAX_PIPELINE_DEPTH) {
     return LIBUSB_ERROR_INVALID_PARAM;
   }
   const struct libusb_interface *interface_settings =
@@ -159,6 +214,13 @@ int libhoth_usb_fifo_open(struct libhoth_usb_device *dev,
     goto err_out;
   }
   drvdata->prng_state = prng_seed;
+  drvdata->pipeline_depth = pipeline_depth;
+  if (pipeline_depth > 1) {
+    status = fifo_alloc_slots(dev);
+    if (status != LIBHOTH_OK) {
+      goto err_out;
+    }
+  }
   return LIBHOTH_OK;
 err_out:
   if (drvdata->in_buffer != NULL) free(drvdata->in_buffer);
@@ -168,12 +230,336 @@ err_out:
   return status;
 }
 
+static struct libhoth_usb_fifo_slot *fifo_slot_at(
+    struct libhoth_usb_fifo *drvdata, int n) {
+  return &drvdata->slots[(drvdata->head + n) % drvdata->pipeline_depth];
+}
+
+static void fifo_slot_update_ready(struct libhoth_usb_fifo_slot *slot) {
+  slot->ready = slot->out_done && slot->responded;
+}
+
+// Oldest outstanding request that hasn't been matched to a response yet.
+static struct libhoth_usb_fifo_slot *fifo_oldest_unanswered(
+    struct libhoth_usb_fifo *drvdata) {
+  for (int i = 0; i < drvdata->num_outstanding; i++) {
+    struct libhoth_usb_fifo_slot *slot = fifo_slot_at(drvdata, i);
+    if (!slot->responded) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+static void fifo_slot_fail(struct libhoth_usb_fifo_slot *slot, int status) {
+  if (slot == NULL) {
+    return;
+  }
+  slot->status = status;
+  slot->responded = true;
+  fifo_slot_update_ready(slot);
+}
+
+static void fifo_pipelined_out_callback(struct libusb_transfer *transfer) {
+  struct libhoth_usb_fifo_slot *slot =
+      (struct libhoth_usb_fifo_slot *)transfer->user_data;
+  slot->out_done = true;
+  if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+    fifo_slot_fail(slot, transfer_status_to_error(transfer->status));
+  } else if (transfer->actual_length != transfer->length) {
+    fifo_slot_fail(slot, LIBHOTH_ERR_OUT_UNDERFLOW);
+  }
+  fifo_slot_update_ready(slot);
+}
+
+static void fifo_pipelined_in_callback(struct libusb_transfer *transfer) {
+  struct libhoth_usb_fifo_slot *owner =
+      (struct libhoth_usb_fifo_slot *)transfer->user_data;
+  struct libhoth_usb_fifo *drvdata = &owner->dev->driver_data.fifo;
+  owner->in_pending = false;
+
+  // Only close cancels IN transfers, and it fails the outstanding requests
+  // itself.
+  if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
+    return;
+  }
+  // Transfer-level errors can't be attributed by request ID; charge them to
+  // the request that was next in line for a response.
+  if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+    fifo_slot_fail(fifo_oldest_unanswered(drvdata),
+                   transfer_status_to_error(transfer->status));
+    return;
+  }
+  if (transfer->actual_length < LIBHOTH_USB_FIFO_REQUEST_ID_SIZE) {
+    fifo_slot_fail(fifo_oldest_unanswered(drvdata), LIBUSB_ERROR_IO);
+    return;
+  }
+
+  for (int i = 0; i < drvdata->num_outstanding; i++) {
+    struct libhoth_usb_fifo_slot *slot = fifo_slot_at(drvdata, i);
+    if (slot->responded ||
+        memcmp(slot->out_buffer, transfer->buffer,
+               LIBHOTH_USB_FIFO_REQUEST_ID_SIZE) != 0) {
+      continue;
+    }
+    slot->resp_size =
+        transfer->actual_length - LIBHOTH_USB_FIFO_REQUEST_ID_SIZE;
+    memcpy(slot->resp_buffer,
+           transfer->buffer + LIBHOTH_USB_FIFO_REQUEST_ID_SIZE,
+           slot->resp_size);
+    slot->status = LIBHOTH_OK;
+    slot->responded = true;
+    fifo_slot_update_ready(slot);
+    return;
+  }
+
+  // Stale response, left behind by another process or by a request that timed
+  // out; read again in place of the response this transfer consumed.
+  if (++drvdata->stale_responses > 10 ||
+      libusb_submit_transfer(transfer) != LIBUSB_SUCCESS) {
+    fifo_slot_fail(fifo_oldest_unanswered(drvdata), LIBUSB_ERROR_IO);
+    return;
+  }
+  owner->in_pending = true;
+}
+
+// Runs libusb events until `*completed` is set or `timeout_ms` elapses. A
+// zero timeout only processes events that are already pending.
+static int fifo_handle_events_until(struct libhoth_usb_device *dev,
+                                    int *completed, int timeout_ms) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (!*completed) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
+                         (now.tv_nsec - start.tv_nsec) / 1000000;
+    int64_t remaining_ms = timeout_ms - elapsed_ms;
+    if (remaining_ms < 0) {
+      remaining_ms = 0;
+    }
+    struct timeval tv = {
+        .tv_sec = remaining_ms / 1000,
+        .tv_usec = (remaining_ms % 1000) * 1000,
+    };
+    int status =
+        libusb_handle_events_timeout_completed(dev->ctx, &tv, completed);
+    if (status != LIBUSB_SUCCESS) {
+      return status;
+    }
+    if (remaining_ms == 0) {
+      break;
+    }
+  }
+  return *completed ? LIBHOTH_OK : LIBHOTH_ERR_TIMEOUT;
+}
+
+// Waits up to `timeout_ms` for the transfers of a non-pipelined exchange. A
+// zero timeout polls, leaving the transfers running if they haven't
+// completed, and a negative one waits indefinitely. Transfers started by a
+// poll have no timeout of their own, so on a timed-out wait they are
+// cancelled here.
+static int fifo_wait_exchange(struct libhoth_usb_device *dev, int timeout_ms) {
+  struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
+  if (timeout_ms < 0) {
+    return libhoth_usb_fifo_wait_transfers(dev);
+  }
+  int status = fifo_handle_events_until(
+      dev, &drvdata->all_transfers_completed, timeout_ms);
+  if (status != LIBHOTH_ERR_TIMEOUT || timeout_ms == 0) {
+    return status;
+  }
+  if (!drvdata->in_transfer_completed) {
+    libusb_cancel_transfer(drvdata->in_transfer);
+  }
+  if (!drvdata->out_transfer_completed) {
+    libusb_cancel_transfer(drvdata->out_transfer);
+  }
+  libhoth_usb_fifo_wait_transfers(dev);
+  return LIBHOTH_ERR_TIMEOUT;
+}
+
+static void fifo_pop_slot(struct libhoth_usb_fifo *drvdata) {
+  fifo_slot_at(drvdata, 0)->busy = false;
+  drvdata->head = (drvdata->head + 1) % drvdata->pipeline_depth;
+  drvdata->num_outstanding--;
+}
+
+static int fifo_pipelined_send(struct libhoth_usb_device *dev,
+                               const struct iovec *iov, int iovcnt) {
+  struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
+  if (drvdata->num_outstanding >= drvdata->pipeline_depth) {
+    return LIBUSB_ERROR_BUSY;
+  }
+  struct libhoth_usb_fifo_slot *slot =
+      fifo_slot_at(drvdata, drvdata->num_outstanding);
+
+  // Every unanswered request needs an IN transfer pending to collect its
+  // response. There can already be one to spare: abandoned requests and
+  // failed sends leave theirs armed, and it will take this response instead.
+  int in_pending = 0;
+  int unanswered = 1;
+  for (int i = 0; i < drvdata->pipeline_depth; i++) {
+    if (drvdata->slots[i].in_pending) {
+      in_pending++;
+    }
+  }
+  for (int i = 0; i < drvdata->num_outstanding; i++) {
+    if (!fifo_slot_at(drvdata, i)->responded) {
+      unanswered++;
+    }
+  }
+  struct libhoth_usb_fifo_slot *in_slot = NULL;
+  if (in_pending < unanswered) {
+    for (int i = 0; i < drvdata->pipeline_depth; i++) {
+      if (!drvdata->slots[i].in_pending) {
+        in_slot = &drvdata->slots[i];
+        break;
+      }
+    }
+    if (in_slot == NULL) {
+      return LIBUSB_ERROR_BUSY;
+    }
+  }
+
+  for (int i = 0; i < LIBHOTH_USB_FIFO_REQUEST_ID_SIZE; i++) {
+    slot->out_buffer[i] =
+        (uint8_t)libhoth_generate_pseudorandom_u32(&drvdata->prng_state);
+  }
+  size_t request_size =
+      libhoth_iov_gather(slot->out_buffer + LIBHOTH_USB_FIFO_REQUEST_ID_SIZE,
+                         LIBHOTH_USB_FIFO_MAX_REQUEST_SIZE, iov, iovcnt);
+  // Timeouts are enforced by libhoth_usb_fifo_receive_responsev() rather than
+  // libusb so that a slow response doesn't cancel the requests queued behind
+  // it.
+  libusb_fill_bulk_transfer(slot->out_transfer, dev->handle, drvdata->ep_out,
+                            slot->out_buffer,
+                            LIBHOTH_USB_FIFO_REQUEST_ID_SIZE + request_size,
+                            fifo_pipelined_out_callback, slot, /*timeout=*/0);
+  slot->out_transfer->flags |= LIBUSB_TRANSFER_ADD_ZERO_PACKET;
+
+  slot->busy = true;
+  slot->out_done = false;
+  slot->responded = false;
+  slot->ready = 0;
+  slot->status = LIBHOTH_OK;
+  slot->resp_size = 0;
+
+  if (in_slot != NULL) {
+    libusb_fill_bulk_transfer(in_slot->in_transfer, dev->handle,
+                              drvdata->ep_in, in_slot->in_buffer,
+                              LIBHOTH_USB_FIFO_MTU, fifo_pipelined_in_callback,
+                              in_slot, /*timeout=*/0);
+    int status = libusb_submit_transfer(in_slot->in_transfer);
+    if (status != LIBUSB_SUCCESS) {
+      slot->busy = false;
+      return status;
+    }
+    in_slot->in_pending = true;
+  }
+  int status = libusb_submit_transfer(slot->out_transfer);
+  if (status != LIBUSB_SUCCESS) {
+    // The IN transfer armed above stays pending and is counted as the spare
+    // for the next send, so it isn't lost.
+    slot->busy = false;
+    return status;
+  }
+  drvdata->num_outstanding++;
+  return LIBHOTH_OK;
+}
+
+static int fifo_pipelined_receive(struct libhoth_usb_device *dev,
+                                  const struct iovec *iov, int iovcnt,
+                                  size_t *actual_size, int timeout_ms) {
+  struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
+  if (drvdata->num_outstanding == 0) {
+    // Forgot to call libhoth_usb_fifo_send_request?
+    return LIBUSB_ERROR_IO;
+  }
+  struct libhoth_usb_fifo_slot *slot = fifo_slot_at(drvdata, 0);
+  int status = fifo_handle_events_until(dev, &slot->ready, timeout_ms);
+  if (status == LIBHOTH_ERR_TIMEOUT && timeout_ms > 0) {
+    // The caller has given up on this request. Drop it so the next receive
+    // gets the next request's response; if this response turns up later, it
+    // matches no outstanding request ID and is thrown away as stale.
+    if (!slot->out_done) {
+      libusb_cancel_transfer(slot->out_transfer);
+      while (!slot->out_done &&
+             libusb_handle_events_completed(dev->ctx, NULL) ==
+                 LIBUSB_SUCCESS) {
+      }
+    }
+    fifo_pop_slot(drvdata);
+    return status;
+  }
+  if (status != LIBHOTH_OK) {
+    // A poll (zero timeout) leaves the request queued; call again later.
+    return status;
+  }
+
+  fifo_pop_slot(drvdata);
+  drvdata->stale_responses = 0;
+
+  if (slot->status == LIBUSB_ERROR_PIPE) {
+    libusb_clear_halt(dev->handle, drvdata->ep_in);
+    libusb_clear_halt(dev->handle, drvdata->ep_out);
+  }
+  if (slot->status != LIBHOTH_OK) {
+    return slot->status;
+  }
+  if (slot->resp_size > libhoth_iov_length(iov, iovcnt)) {
+    return LIBHOTH_ERR_IN_OVERFLOW;
+  }
+  libhoth_iov_scatter(iov, iovcnt, slot->resp_buffer, slot->resp_size);
+  *actual_size = slot->resp_size;
+  return LIBHOTH_OK;
+}
+
+// Cancels everything still in flight and waits for libusb to hand the
+// transfers back so they can be freed.
+static void fifo_pipelined_cancel_all(struct libhoth_usb_device *dev) {
+  struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
+  for (int i = 0; i < drvdata->pipeline_depth; i++) {
+    struct libhoth_usb_fifo_slot *slot = &drvdata->slots[i];
+    if (slot->in_pending) {
+      libusb_cancel_transfer(slot->in_transfer);
+    }
+    if (slot->busy && !slot->out_done) {
+      libusb_cancel_transfer(slot->out_transfer);
+    }
+  }
+  for (int i = 0; i < drvdata->pipeline_depth; i++) {
+    struct libhoth_usb_fifo_slot *slot = &drvdata->slots[i];
+    while (slot->in_pending || (slot->busy && !slot->out_done)) {
+      if (libusb_handle_events_completed(dev->ctx, NULL) != LIBUSB_SUCCESS) {
+        break;
+      }
+    }
+  }
+  drvdata->num_outstanding = 0;
+}
+
 int libhoth_usb_fifo_send_request(struct libhoth_usb_device *dev,
                                   const void *request, size_t request_size) {
-  if (dev == NULL || request == NULL ||
-      request_size > LIBHOTH_USB_FIFO_MAX_REQUEST_SIZE) {
+  const struct iovec iov = {
+      .iov_base = (void *)request,
+      .iov_len = request_size,
+  };
+  if (request == NULL) {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+  return libhoth_usb_fifo_send_requestv(dev, &iov, 1);
+}
+
+int libhoth_usb_fifo_send_requestv(struct libhoth_usb_device *dev,
+                                   const struct iovec *iov, int iovcnt) {
+  if (dev == NULL || iov == NULL ||
+      libhoth_iov_length(iov, iovcnt) > LIBHOTH_USB_FIFO_MAX_REQUEST_SIZE) {
     return LIBUSB_ERROR_INVALID_PARAM;
   }
+  if (dev->driver_data.fifo.pipeline_depth > 1) {
+    return fifo_pipelined_send(dev, iov, iovcnt);
+  }
   // TODO: Do something to warn users when doing two send_request() calls
   // without a receive_response() call in between?
   // if (drvdata->out_transfer->length != 0) {
@@ -187,8 +573,11 @@ int libhoth_usb_fifo_send_request(struct libhoth_usb_device *dev,
         (uint8_t)libhoth_generate_pseudorandom_u32(&drvdata->prng_state);
   }
 
-  memcpy(drvdata->out_buffer + LIBHOTH_USB_FIFO_REQUEST_ID_SIZE, request,
-         request_size);
+  // The request pieces are gathered straight into the transfer buffer behind
+  // the request ID.
+  size_t request_size = libhoth_iov_gather(
+      drvdata->out_buffer + LIBHOTH_USB_FIFO_REQUEST_ID_SIZE,
+      LIBHOTH_USB_FIFO_MAX_REQUEST_SIZE, iov, iovcnt);
   // timeout is filled in later
   libusb_fill_bulk_transfer(drvdata->out_transfer, dev->handle, drvdata->ep_out,
                             drvdata->out_buffer,
@@ -201,51 +590,93 @@ int libhoth_usb_fifo_send_request(struct libhoth_usb_device *dev,
 int libhoth_usb_fifo_receive_response(struct libhoth_usb_device *dev,
                                       void *response, size_t max_response_size,
                                       size_t *actual_size, int timeout_ms) {
-  if (dev == NULL || response == NULL ||
-      max_response_size > LIBHOTH_USB_FIFO_MAX_REQUEST_SIZE) {
+  const struct iovec iov = {
+      .iov_base = response,
+      .iov_len = max_response_size,
+  };
+  if (response == NULL) {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+  return libhoth_usb_fifo_receive_responsev(dev, &iov, 1, actual_size,
+                                            timeout_ms);
+}
+
+int libhoth_usb_fifo_receive_responsev(struct libhoth_usb_device *dev,
+                                       const struct iovec *iov, int iovcnt,
+                                       size_t *actual_size, int timeout_ms) {
+  if (dev == NULL || iov == NULL) {
     return LIBUSB_ERROR_INVALID_PARAM;
   }
+  size_t max_response_size = libhoth_iov_length(iov, iovcnt);
+  if (max_response_size > LIBHOTH_USB_FIFO_MAX_REQUEST_SIZE) {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+  if (dev->driver_data.fifo.pipeline_depth > 1) {
+    return fifo_pipelined_receive(dev, iov, iovcnt, actual_size, timeout_ms);
+  }
   size_t max_in_transfer_size =
       LIBHOTH_USB_FIFO_REQUEST_ID_SIZE + max_response_size;
   struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
-  if (drvdata->out_transfer->length == 0) {
-    // OUT transfer not filled in. Forgot to call libhoth_usb_fifo_send_request?
-    return LIBUSB_ERROR_IO;
-  }
-  libusb_fill_bulk_transfer(drvdata->in_transfer, dev->handle, drvdata->ep_in,
-                            drvdata->in_buffer, LIBHOTH_USB_FIFO_MTU,
-                            fifo_transfer_callback, dev, timeout_ms);
-  drvdata->out_transfer->timeout = timeout_ms;
-  int status = libhoth_usb_fifo_run_transfers(dev, /*out=*/true, /*in=*/true);
-  if (status != LIBHOTH_OK) {
-    goto transfer_done;
+  int status;
+  if (!drvdata->exchange_pending) {
+    if (drvdata->out_transfer->length == 0) {
+      // OUT transfer not filled in. Forgot to call
+      // libhoth_usb_fifo_send_request?
+      return LIBUSB_ERROR_IO;
+    }
+    libusb_fill_bulk_transfer(drvdata->in_transfer, dev->handle,
+                              drvdata->ep_in, drvdata->in_buffer,
+                              LIBHOTH_USB_FIFO_MTU, fifo_transfer_callback,
+                              dev, timeout_ms);
+    drvdata->out_transfer->timeout = timeout_ms;
+    drvdata->stale_reads = 0;
+    drvdata->halt_cleared = false;
+    status = libhoth_usb_fifo_submit_transfers(dev, /*out=*/true, /*in=*/true);
+    if (status != LIBHOTH_OK) {
+      goto transfer_done;
+    }
+    drvdata->exchange_pending = true;
   }
 
-  if (drvdata->in_transfer->status == LIBUSB_TRANSFER_STALL ||
-      drvdata->out_transfer->status == LIBUSB_TRANSFER_STALL) {
-    status = libusb_clear_halt(dev->handle, drvdata->ep_in);
-    if (status != LIBUSB_SUCCESS) {
+  while (true) {
+    status = fifo_wait_exchange(dev, timeout_ms);
+    if (status == LIBHOTH_ERR_TIMEOUT && timeout_ms == 0) {
+      // A poll leaves the exchange running; call again later.
+      return status;
+    }
+    if (status != LIBHOTH_OK) {
       goto transfer_done;
     }
-    status = libusb_clear_halt(dev->handle, drvdata->ep_out);
-    if (status != LIBUSB_SUCCESS) {
+
+    if (!drvdata->halt_cleared &&
+        (drvdata->in_transfer->status == LIBUSB_TRANSFER_STALL ||
+         drvdata->out_transfer->status == LIBUSB_TRANSFER_STALL)) {
+      drvdata->halt_cleared = true;
+      status = libusb_clear_halt(dev->handle, drvdata->ep_in);
+      if (status != LIBUSB_SUCCESS) {
+        goto transfer_done;
+      }
+      status = libusb_clear_halt(dev->handle, drvdata->ep_out);
+      if (status != LIBUSB_SUCCESS) {
+        goto transfer_done;
+      }
+      status =
+          libhoth_usb_fifo_submit_transfers(dev, /*out=*/true, /*in=*/true);
+      if (status != LIBUSB_SUCCESS) {
+        goto transfer_done;
+      }
+      continue;
+    }
+
+    if (drvdata->out_transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+      status = transfer_status_to_error(drvdata->out_transfer->status);
       goto transfer_done;
     }
-    status = libhoth_usb_fifo_run_transfers(dev, /*out=*/true, /*in=*/true);
-    if (status != LIBUSB_SUCCESS) {
+    if (drvdata->out_transfer->actual_length !=
+        drvdata->out_transfer->length) {
+      status = LIBHOTH_ERR_OUT_UNDERFLOW;
       goto transfer_done;
     }
-  }
-
-  if (drvdata->out_transfer->status != LIBUSB_TRANSFER_COMPLETED) {
-    status = transfer_status_to_error(drvdata->out_transfer->status);
-    goto transfer_done;
-  }
-
-  if (drvdata->out_transfer->actual_length != drvdata->out_transfer->length) {
-    return LIBHOTH_ERR_OUT_UNDERFLOW;
-  }
-  for (int i = 0;; i++) {
     if (drvdata->in_transfer->status != LIBUSB_TRANSFER_COMPLETED) {
       status = transfer_status_to_error(drvdata->in_transfer->status);
       goto transfer_done;
@@ -263,27 +694,30 @@ int libhoth_usb_fifo_receive_response(struct libhoth_usb_device *dev,
                LIBHOTH_USB_FIFO_REQUEST_ID_SIZE) == 0) {
       *actual_size = drvdata->in_transfer->actual_length -
                      LIBHOTH_USB_FIFO_REQUEST_ID_SIZE;
-      memcpy(response, drvdata->in_buffer + LIBHOTH_USB_FIFO_REQUEST_ID_SIZE,
-             *actual_size);
-      break;
+      libhoth_iov_scatter(iov, iovcnt,
+                          drvdata->in_buffer + LIBHOTH_USB_FIFO_REQUEST_ID_SIZE,
+                          *actual_size);
+      status = LIBHOTH_OK;
+      goto transfer_done;
     }
-    if (i >= 10) {
+    if (drvdata->stale_reads >= 10) {
       // Tried 10 times. Giving up.
       status = LIBUSB_ERROR_IO;
       goto transfer_done;
     }
+    drvdata->stale_reads++;
 
     // The most likely reason for this is that another process died in the
     // middle of a host command, leaving their response in the RoT's TxFIFO.
     // Let's make another transfer and hopefully find our response...
-    status = libhoth_usb_fifo_run_transfers(dev, /*out=*/false, /*in=*/true);
+    status = libhoth_usb_fifo_submit_transfers(dev, /*out=*/false, /*in=*/true);
     if (status != LIBHOTH_OK) {
       goto transfer_done;
     }
   }
-  status = LIBHOTH_OK;
 
 transfer_done:
+  drvdata->exchange_pending = false;
   drvdata->out_transfer->length = 0;
   return status;
 }
@@ -293,6 +727,10 @@ int libhoth_usb_fifo_close(struct libhoth_usb_device *dev) {
     return LIBUSB_ERROR_INVALID_PARAM;
   }
   struct libhoth_usb_fifo *drvdata = &dev->driver_data.fifo;
+  if (drvdata->slots != NULL) {
+    fifo_pipelined_cancel_all(dev);
+    fifo_free_slots(drvdata);
+  }
   if (drvdata->in_buffer != NULL) free(drvdata->in_buffer);
   if (drvdata->out_buffer != NULL) free(drvdata->out_buffer);
   libusb_free_transfer(drvdata->in_transfer);
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 
 #include "transports/libhoth_device.h"
 #include "transports/libhoth_ec.h"
@@ -49,6 +50,120 @@ struct mailbox_response {
   uint8_t rsvd;
 } __attribute__((packed));
 
+// Transfers queued together by mailbox_run_batch(). The first failure
+// cancels the rest so an IN transfer waiting for a status that will never
+// come doesn't hold up the batch.
+struct mailbox_batch {
+  struct libusb_transfer **transfers;
+  int num_transfers;
+  int pending;
+  int status;
+  int all_done;
+};
+
+static void mailbox_transfer_callback(struct libusb_transfer *transfer) {
+  struct mailbox_batch *batch = (struct mailbox_batch *)transfer->user_data;
+  if (transfer->status != LIBUSB_TRANSFER_COMPLETED &&
+      batch->status == LIBUSB_SUCCESS) {
+    batch->status = transfer_status_to_error(transfer->status);
+    for (int i = 0; i < batch->num_transfers; i++) {
+      if (batch->transfers[i] != transfer) {
+        // Fails harmlessly for transfers that already completed.
+        libusb_cancel_transfer(batch->transfers[i]);
+      }
+    }
+  }
+  if (--batch->pending == 0) {
+    batch->all_done = 1;
+  }
+}
+
+// Submits `num_transfers` filled-in transfers at once and waits for all of
+// them to finish. OUT transfers on an endpoint complete in order, as do IN
+// transfers, so the RoT sees the same packet sequence as with synchronous
+// transfers without a host round-trip between packets.
+static int mailbox_run_batch(struct libhoth_usb_device *dev,
+                             struct libusb_transfer **transfers,
+                             int num_transfers) {
+  struct mailbox_batch batch = {
+      .transfers = transfers,
+      .num_transfers = 0,
+      .status = LIBUSB_SUCCESS,
+  };
+  for (int i = 0; i < num_transfers; i++) {
+    transfers[i]->callback = mailbox_transfer_callback;
+    transfers[i]->user_data = &batch;
+    int status = libusb_submit_transfer(transfers[i]);
+    if (status != LIBUSB_SUCCESS) {
+      batch.status = status;
+      for (int j = 0; j < i; j++) {
+        libusb_cancel_transfer(transfers[j]);
+      }
+      break;
+    }
+    batch.num_transfers++;
+    batch.pending++;
+  }
+  while (batch.pending > 0) {
+    int status = libusb_handle_events_completed(dev->ctx, &batch.all_done);
+    if (status != LIBUSB_SUCCESS && status != LIBUSB_ERROR_INTERRUPTED &&
+        batch.status == LIBUSB_SUCCESS) {
+      // The transfers point at `batch`, so cancel them and keep reaping
+      // rather than returning with any still in flight.
+      batch.status = status;
+      for (int i = 0; i < batch.num_transfers; i++) {
+        libusb_cancel_transfer(transfers[i]);
+      }
+    }
+  }
+  return batch.status;
+}
+
+static void mailbox_free_transfers(struct libhoth_usb_mailbox *drvdata) {
+  for (int i = 0; i < drvdata->num_slots; i++) {
+    if (drvdata->transfers != NULL) {
+      libusb_free_transfer(drvdata->transfers[2 * i]);
+      libusb_free_transfer(drvdata->transfers[2 * i + 1]);
+    }
+  }
+  free(drvdata->transfers);
+  free(drvdata->out_packets);
+  free(drvdata->in_packets);
+  drvdata->transfers = NULL;
+  drvdata->out_packets = NULL;
+  drvdata->in_packets = NULL;
+  drvdata->num_slots = 0;
+}
+
+// Pre-allocates one OUT and one IN transfer (and packet buffer) for every
+// slice of a maximum-size mailbox message.
+static int mailbox_alloc_transfers(struct libhoth_usb_mailbox *drvdata) {
+  const size_t min_payload_size =
+      MIN(drvdata->max_packet_size_out - sizeof(struct mailbox_request),
+          drvdata->max_packet_size_in - sizeof(struct mailbox_response));
+  const int num_slots =
+      (LIBHOTH_MAILBOX_SIZE + min_payload_size - 1) / min_payload_size;
+
+  drvdata->transfers = (struct libusb_transfer **)calloc(
+      2 * num_slots, sizeof(struct libusb_transfer *));
+  drvdata->out_packets = (uint8_t *)malloc(num_slots * LIBHOTH_USB_MAILBOX_MTU);
+  drvdata->in_packets = (uint8_t *)malloc(num_slots * LIBHOTH_USB_MAILBOX_MTU);
+  drvdata->num_slots = num_slots;
+  if (drvdata->transfers == NULL || drvdata->out_packets == NULL ||
+      drvdata->in_packets == NULL) {
+    mailbox_free_transfers(drvdata);
+    return LIBHOTH_ERR_MALLOC_FAILED;
+  }
+  for (int i = 0; i < 2 * num_slots; i++) {
+    drvdata->transfers[i] = libusb_alloc_transfer(0);
+    if (drvdata->transfers[i] == NULL) {
+      mailbox_free_transfers(drvdata);
+      return LIBHOTH_ERR_MALLOC_FAILED;
+    }
+  }
+  return LIBHOTH_OK;
+}
+
 int libhoth_usb_mailbox_open(
     struct libhoth_usb_device *dev,
     const struct libusb_config_descriptor *descriptor) {
@@ -95,23 +210,27 @@ int libhoth_usb_mailbox_open(
     return LIBUSB_ERROR_INVALID_PARAM;
   }
 
-  return LIBHOTH_OK;
+  return mailbox_alloc_transfers(drvdata);
 }
 
 int libhoth_usb_mailbox_send_request(struct libhoth_usb_device *dev,
                                      const void *request, size_t request_size) {
-  uint8_t packet[LIBHOTH_USB_MAILBOX_MTU];
   if (dev == NULL || request == NULL) {
     return LIBUSB_ERROR_INVALID_PARAM;
   }
 
   struct libhoth_usb_mailbox *drvdata = &dev->driver_data.mailbox;
   const size_t max_payload_size =
-      drvdata->max_packet_size_in - sizeof(struct mailbox_request);
+      drvdata->max_packet_size_out - sizeof(struct mailbox_request);
 
+  // Queue every write slice and its status read at once; each slot is an
+  // OUT/IN pair.
+  int num_slots = 0;
   uint32_t offset = 0;
   while (offset < request_size) {
-    int transferred;
+    if (num_slots >= drvdata->num_slots) {
+      return LIBUSB_ERROR_INVALID_PARAM;
+    }
     uint8_t length = (request_size - offset) < max_payload_size
                          ? request_size - offset
                          : max_payload_size;
@@ -120,34 +239,94 @@ int libhoth_usb_mailbox_send_request(struct libhoth_usb_device *dev,
         .offset = offset,
         .length = length,
     };
-    struct mailbox_response response;
+    uint8_t *packet = &drvdata->out_packets[num_slots * LIBHOTH_USB_MAILBOX_MTU];
     memcpy(&packet[0], &request_header, sizeof(request_header));
     memcpy(&packet[sizeof(request_header)], (const uint8_t *)request + offset,
            length);
 
-    int status = libusb_bulk_transfer(dev->handle, drvdata->ep_out, packet,
-                                      sizeof(request_header) + length,
-                                      &transferred, /*timeout=*/0);
-    if (status != LIBUSB_SUCCESS) {
-      return status;
+    libusb_fill_bulk_transfer(drvdata->transfers[2 * num_slots], dev->handle,
+                              drvdata->ep_out, packet,
+                              sizeof(request_header) + length, NULL, NULL,
+                              /*timeout=*/0);
+    libusb_fill_bulk_transfer(
+        drvdata->transfers[2 * num_slots + 1], dev->handle, drvdata->ep_in,
+        &drvdata->in_packets[num_slots * LIBHOTH_USB_MAILBOX_MTU],
+        sizeof(struct mailbox_response), NULL, NULL, /*timeout=*/0);
+    num_slots++;
+    offset += length;
+  }
+
+  int status = mailbox_run_batch(dev, drvdata->transfers, 2 * num_slots);
+  if (status != LIBUSB_SUCCESS) {
+    return status;
+  }
+  for (int i = 0; i < num_slots; i++) {
+    const struct libusb_transfer *out = drvdata->transfers[2 * i];
+    const struct libusb_transfer *in = drvdata->transfers[2 * i + 1];
+    if (out->actual_length != out->length ||
+        in->actual_length != sizeof(struct mailbox_response)) {
+      return LIBUSB_ERROR_IO;
     }
-    if (transferred != sizeof(request_header) + length) {
+    struct mailbox_response response;
+    memcpy(&response, in->buffer, sizeof(response));
+    if (response.status != MAILBOX_SUCCESS) {
       return LIBUSB_ERROR_IO;
     }
+  }
+  return LIBHOTH_OK;
+}
 
-    status =
-        libusb_bulk_transfer(dev->handle, drvdata->ep_in, (void *)&response,
-                             sizeof(response), &transferred, /*timeout=*/0);
-    if (status != LIBUSB_SUCCESS) {
-      return status;
+// Reads `size` bytes of the mailbox starting at `offset` into `response`,
+// with all the read slices queued at once.
+static int mailbox_read(struct libhoth_usb_device *dev, uint32_t offset,
+                        uint8_t *response, size_t size, int timeout_ms) {
+  struct libhoth_usb_mailbox *drvdata = &dev->driver_data.mailbox;
+  const size_t max_payload_size =
+      drvdata->max_packet_size_in - sizeof(struct mailbox_response);
+
+  int num_slots = 0;
+  for (size_t done = 0; done < size; num_slots++) {
+    if (num_slots >= drvdata->num_slots) {
+      return LIBUSB_ERROR_INVALID_PARAM;
     }
-    if (transferred != sizeof(response)) {
+    uint8_t length =
+        (size - done) < max_payload_size ? size - done : max_payload_size;
+    struct mailbox_request request = {
+        .type = MAILBOX_REQ_READ,
+        .offset = offset + done,
+        .length = length,
+    };
+    uint8_t *packet = &drvdata->out_packets[num_slots * LIBHOTH_USB_MAILBOX_MTU];
+    memcpy(packet, &request, sizeof(request));
+    libusb_fill_bulk_transfer(drvdata->transfers[2 * num_slots], dev->handle,
+                              drvdata->ep_out, packet, sizeof(request), NULL,
+                              NULL, timeout_ms);
+    libusb_fill_bulk_transfer(
+        drvdata->transfers[2 * num_slots + 1], dev->handle, drvdata->ep_in,
+        &drvdata->in_packets[num_slots * LIBHOTH_USB_MAILBOX_MTU],
+        sizeof(struct mailbox_response) + length, NULL, NULL, timeout_ms);
+    done += length;
+  }
+
+  int status = mailbox_run_batch(dev, drvdata->transfers, 2 * num_slots);
+  if (status != LIBUSB_SUCCESS) {
+    return status;
+  }
+  for (int i = 0; i < num_slots; i++) {
+    const struct libusb_transfer *out = drvdata->transfers[2 * i];
+    const struct libusb_transfer *in = drvdata->transfers[2 * i + 1];
+    if (out->actual_length != out->length ||
+        in->actual_length != in->length) {
       return LIBUSB_ERROR_IO;
     }
-    if (response.status != MAILBOX_SUCCESS) {
+    struct mailbox_response response_header;
+    memcpy(&response_header, in->buffer, sizeof(response_header));
+    if (response_header.status != MAILBOX_SUCCESS) {
       return LIBUSB_ERROR_IO;
     }
-    offset += length;
+    size_t length = in->length - sizeof(response_header);
+    memcpy(response, in->buffer + sizeof(response_header), length);
+    response += length;
   }
   return LIBHOTH_OK;
 }
@@ -155,7 +334,6 @@ int libhoth_usb_mailbox_send_request(struct libhoth_usb_device *dev,
 int libhoth_usb_mailbox_receive_response(struct libhoth_usb_device *dev,
                                          void *response, size_t response_size,
                                          size_t *actual_size, int timeout_ms) {
-  uint8_t packet[LIBHOTH_USB_MAILBOX_MTU];
   if (dev == NULL || response == NULL) {
     return LIBUSB_ERROR_INVALID_PARAM;
   }
@@ -168,60 +346,32 @@ int libhoth_usb_mailbox_receive_response(struct libhoth_usb_device *dev,
     return LIBUSB_ERROR_INVALID_PARAM;
   }
 
-  uint32_t expected_size = response_size;
+  // The first slice carries the header, which says how much is left; the
+  // rest is then read in one burst.
+  size_t first_size = MIN(response_size, max_payload_size);
+  if (first_size < sizeof(struct hoth_host_response)) {
+    first_size = sizeof(struct hoth_host_response);
+  }
+  int status =
+      mailbox_read(dev, /*offset=*/0, response, first_size, timeout_ms);
+  if (status != LIBHOTH_OK) {
+    return status;
+  }
 
-  uint32_t offset = 0;
-  while (offset < expected_size) {
-    int transferred;
-    uint8_t length = (response_size - offset) < max_payload_size
-                         ? response_size - offset
-                         : max_payload_size;
-    struct mailbox_request request = {
-        .type = MAILBOX_REQ_READ,
-        .offset = offset,
-        .length = length,
-    };
-    int status = libusb_bulk_transfer(dev->handle, drvdata->ep_out,
-                                      (void *)&request, sizeof(request),
-                                      &transferred, /*timeout=*/timeout_ms);
-    if (status != LIBUSB_SUCCESS) {
-      return status;
-    }
-    if (transferred != sizeof(request)) {
-      return LIBUSB_ERROR_IO;
-    }
+  struct hoth_host_response response_header;
+  memcpy(&response_header, response, sizeof(response_header));
+  if (response_header.struct_version != 3) {
+    return LIBHOTH_ERR_UNSUPPORTED_VERSION;
+  }
+  size_t expected_size =
+      MIN(response_size, sizeof(response_header) + response_header.data_len);
 
-    status = libusb_bulk_transfer(dev->handle, drvdata->ep_in, packet,
-                                  sizeof(struct mailbox_response) + length,
-                                  &transferred, /*timeout=*/timeout_ms);
-    if (status != LIBUSB_SUCCESS) {
+  if (expected_size > first_size) {
+    status = mailbox_read(dev, first_size, (uint8_t *)response + first_size,
+                          expected_size - first_size, timeout_ms);
+    if (status != LIBHOTH_OK) {
       return status;
     }
-    if (transferred < sizeof(struct mailbox_response)) {
-      return LIBUSB_ERROR_IO;
-    }
-    struct mailbox_response response_header;
-    memcpy(&response_header, &packet[0], sizeof(response_header));
-    if (response_header.status != MAILBOX_SUCCESS) {
-      return LIBUSB_ERROR_IO;
-    }
-    memcpy((uint8_t *)response + offset, &packet[sizeof(response_header)],
-           length);
-
-    if (offset == 0 && length >= sizeof(struct hoth_host_response)) {
-      struct hoth_host_response response_header;
-      memcpy(&response_header, response, sizeof(response_header));
-      if (response_header.struct_version != 3) {
-        return LIBHOTH_ERR_UNSUPPORTED_VERSION;
-      }
-      if (expected_size > sizeof(response_header) + response_header.data_len) {
-        expected_size = sizeof(response_header) + response_header.data_len;
-      }
-    }
-    offset += length;
-    if (transferred < max_payload_size) {
-      break;
-    }
   }
   *actual_size = expected_size;
 
@@ -232,5 +382,6 @@ int libhoth_usb_mailbox_close(struct libhoth_usb_device *dev) {
   if (dev == NULL) {
     return LIBUSB_ERROR_INVALID_PARAM;
   }
+  mailbox_free_transfers(&dev->driver_data.mailbox);
   return LIBHOTH_OK;
 }